@@ -0,0 +1,47 @@
+"""Build rules for libsettings."""
+
+def settings_embed(
+        name,
+        config,
+        symbol,
+        srcs = [],
+        updates = [],
+        visibility = None):
+    """Resolves a settings file at build time and embeds it in a cc_library.
+
+    The library provides "<name>.h" declaring the accessor function
+    "const settings::Image& <symbol>();". No parsing happens at runtime.
+
+    Args:
+      name: name of the cc_library.
+      config: the settings file.
+      symbol: the accessor function, optionally namespace qualified.
+      srcs: files included by the settings file.
+      updates: settings updates applied after loading (see commandLine()).
+      visibility: visibility of the cc_library.
+    """
+    native.genrule(
+        name = name + "_gen",
+        srcs = [config] + srcs,
+        outs = [
+            name + ".cc",
+            name + ".h",
+        ],
+        cmd = " ".join([
+            "$(location {})".format(Label("//:settingsembed")),
+            "--symbol=" + symbol,
+            "--source=$(location {}.cc)".format(name),
+            "--header=$(location {}.h)".format(name),
+            "$(location {})".format(config),
+        ] + ["'{}'".format(update) for update in updates]),
+        tools = [Label("//:settingsembed")],
+        visibility = ["//visibility:private"],
+    )
+
+    native.cc_library(
+        name = name,
+        srcs = [name + ".cc"],
+        hdrs = [name + ".h"],
+        visibility = visibility,
+        deps = [Label("//:settings")],
+    )
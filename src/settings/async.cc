@@ -0,0 +1,135 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/async.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+namespace settings {
+
+AsyncSettings::AsyncSettings(const std::string& _config_file,
+                             const std::vector<std::string>& _updates,
+                             Callback _callback, bool _debug)
+    : done_(false),
+      thread_(&AsyncSettings::load, this, _config_file, _updates,
+              std::move(_callback), _debug) {}
+
+AsyncSettings::~AsyncSettings() {
+  thread_.join();
+}
+
+bool AsyncSettings::ready(const std::string& _key) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return ready_.count(_key) > 0;
+}
+
+const nlohmann::json& AsyncSettings::get(const std::string& _key) const {
+  std::unique_lock<std::mutex> lock(lock_);
+  cond_.wait(lock, [&] { return done_ || ready_.count(_key) > 0; });
+  auto it = ready_.find(_key);
+  if (it != ready_.end()) {
+    return *it->second;
+  }
+  if (error_ != nullptr) {
+    fprintf(stderr, "Settings error: %s\n", error_->what());
+  } else {
+    fprintf(stderr, "Settings error: no top-level setting \"%s\"\n",
+            _key.c_str());
+  }
+  exit(-1);
+}
+
+bool AsyncSettings::done() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return done_;
+}
+
+const nlohmann::json& AsyncSettings::wait() const {
+  std::unique_lock<std::mutex> lock(lock_);
+  cond_.wait(lock, [this] { return done_; });
+  if (error_ != nullptr) {
+    fprintf(stderr, "Settings error: %s\n", error_->what());
+    exit(-1);
+  }
+  return settings_;
+}
+
+void AsyncSettings::load(const std::string& _config_file,
+                         const std::vector<std::string>& _updates,
+                         Callback _callback, bool _debug) {
+  // Resolved subtrees are found before publishing them because the top-level
+  // object may change while readers access the resolved subtrees.
+  std::unique_ptr<Error> error;
+  try {
+    loadIncrementally(_config_file, _updates, &settings_, nullptr, nullptr,
+                      [this](const std::string& _key) {
+                        const nlohmann::json* subtree = &settings_.at(_key);
+                        {
+                          std::lock_guard<std::mutex> lock(lock_);
+                          ready_[_key] = subtree;
+                        }
+                        cond_.notify_all();
+                      },
+                      _debug);
+  } catch (Error& e) {
+    error = std::make_unique<Error>(e);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    done_ = true;
+    error_ = std::move(error);
+  }
+  cond_.notify_all();
+
+  if (_callback) {
+    _callback(settings_, error_.get());
+  }
+}
+
+std::unique_ptr<AsyncSettings> initFileAsync(
+    const std::string& _config_file, AsyncSettings::Callback _callback) {
+  return std::make_unique<AsyncSettings>(
+      _config_file, std::vector<std::string>(), std::move(_callback));
+}
+
+std::unique_ptr<AsyncSettings> commandLineAsync(
+    s32 _argc, const char* const* _argv, AsyncSettings::Callback _callback) {
+  std::string config_file;
+  std::vector<std::string> updates;
+  bool debug;
+  parseCommandLine(_argc, _argv, &config_file, &updates, &debug);
+  return std::make_unique<AsyncSettings>(config_file, updates,
+                                         std::move(_callback), debug);
+}
+
+}  // namespace settings
@@ -0,0 +1,113 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SETTINGS_ASYNC_H_
+#define SETTINGS_ASYNC_H_
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "prim/prim.h"
+#include "settings/settings.h"
+
+namespace settings {
+
+// This loads settings on a background thread. Top-level subtrees can be read
+// as soon as they are resolved, while the rest of the settings is loading.
+class AsyncSettings {
+ public:
+  // this is called on the loading thread when the load completes. The error is
+  //  nullptr upon success.
+  typedef std::function<void(const nlohmann::json& _settings,
+                             const Error* _error)>
+      Callback;
+
+  // this starts loading the settings the same way as settings::load()
+  //  if debugging, the load is traced (see settings::loadIncrementally())
+  AsyncSettings(const std::string& _config_file,
+                const std::vector<std::string>& _updates,
+                Callback _callback = nullptr, bool _debug = false);
+
+  // this waits for the load to complete
+  ~AsyncSettings();
+  AsyncSettings(const AsyncSettings&) = delete;
+  AsyncSettings& operator=(const AsyncSettings&) = delete;
+
+  // this returns true if the top-level subtree is resolved
+  bool ready(const std::string& _key) const;
+
+  // this waits for the top-level subtree to be resolved and returns it
+  //  error print and exit(-1) if the load fails before the subtree is
+  //  resolved, or if the settings don't have the key
+  const nlohmann::json& get(const std::string& _key) const;
+
+  // this returns true if the load has completed (successfully or not)
+  bool done() const;
+
+  // this waits for the load to complete and returns the settings
+  //  error print and exit(-1) if the load failed
+  const nlohmann::json& wait() const;
+
+ private:
+  void load(const std::string& _config_file,
+            const std::vector<std::string>& _updates, Callback _callback,
+            bool _debug);
+
+  mutable std::mutex lock_;
+  mutable std::condition_variable cond_;
+  nlohmann::json settings_;
+  // the resolved subtrees, which are never modified once resolved
+  std::unordered_map<std::string, const nlohmann::json*> ready_;
+  bool done_;
+  std::unique_ptr<Error> error_;
+  std::thread thread_;
+};
+
+// this is the asynchronous version of initFile()
+std::unique_ptr<AsyncSettings> initFileAsync(
+    const std::string& _config_file,
+    AsyncSettings::Callback _callback = nullptr);
+
+// this is the asynchronous version of commandLine(). The command line is
+//  parsed before returning (e.g., "-h" is handled right away).
+std::unique_ptr<AsyncSettings> commandLineAsync(
+    s32 _argc, const char* const* _argv,
+    AsyncSettings::Callback _callback = nullptr);
+
+}  // namespace settings
+
+#endif  // SETTINGS_ASYNC_H_
@@ -0,0 +1,202 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/async.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+#include "settings/settings.h"
+
+static void writeTestFiles() {
+  FILE* afp = fopen("TEST_asettings.json", "w");
+  assert(afp != NULL);
+  fprintf(afp, "%s",
+          "{\"a\": \"$$(TEST_bsettings.json)$$\", \"b\": 1,"
+          " \"c\": \"$&(/a/x)&$\", \"d\": 2}");
+  fclose(afp);
+
+  FILE* bfp = fopen("TEST_bsettings.json", "w");
+  assert(bfp != NULL);
+  fprintf(bfp, "%s", "{\"x\": [1, 2, 3]}");
+  fclose(bfp);
+}
+
+static void removeTestFiles() {
+  assert(remove("TEST_asettings.json") == 0);
+  assert(remove("TEST_bsettings.json") == 0);
+}
+
+TEST(Async, loadIncrementally) {
+  writeTestFiles();
+  std::vector<std::string> updates = {"/d=int=5", "/e=ref=/d"};
+
+  nlohmann::json expected;
+  settings::Origins expected_origins;
+  settings::load("TEST_asettings.json", updates, &expected,
+                 &expected_origins);
+
+  nlohmann::json actual;
+  settings::Origins actual_origins;
+  std::vector<std::string> order;
+  std::vector<nlohmann::json> values;
+  settings::loadIncrementally(
+      "TEST_asettings.json", updates, &actual, &actual_origins, nullptr,
+      [&](const std::string& _key) {
+        order.push_back(_key);
+        values.push_back(actual.at(_key));
+      });
+  ASSERT_EQ(actual, expected);
+  ASSERT_EQ(actual_origins, expected_origins);
+
+  // Subtrees neither containing nor targeted by references are ready first.
+  ASSERT_EQ(order, std::vector<std::string>({"b", "a", "c", "d", "e"}));
+  for (u64 idx = 0; idx < order.size(); idx++) {
+    ASSERT_EQ(values.at(idx), expected.at(order.at(idx)));
+  }
+
+  // Missing targets created by references are ready with the references.
+  order.clear();
+  settings::loadIncrementally(
+      "TEST_asettings.json", {"/e=ref=/b2"}, &actual, nullptr, nullptr,
+      [&](const std::string& _key) { order.push_back(_key); });
+  ASSERT_EQ(order, std::vector<std::string>({"b", "d", "a", "b2", "c", "e"}));
+
+  // Updating the root makes nothing ready before updates are applied.
+  order.clear();
+  settings::loadIncrementally(
+      "TEST_asettings.json", {"=file=TEST_bsettings.json"}, &actual, nullptr,
+      nullptr, [&](const std::string& _key) { order.push_back(_key); });
+  ASSERT_EQ(order, std::vector<std::string>({"x"}));
+
+  removeTestFiles();
+}
+
+TEST(Async, loadIncrementallyEarly) {
+  FILE* fp = fopen("TEST_asettings.json", "w");
+  assert(fp != NULL);
+  fprintf(fp, "%s",
+          "{\"a\": {\"v\": 1}, \"z\": \"$$(TEST_bsettings.json)$$\"}");
+  fclose(fp);
+  nlohmann::json big;
+  for (u64 idx = 0; idx < 100000; idx++) {
+    big["big"].push_back({{"idx", idx}});
+  }
+  big["r"] = "$&(/a/v)&$";
+  settings::writeToFile(big, "TEST_bsettings.json");
+
+  // A subtree is ready before a large inclusion in a later subtree is loaded,
+  //  and references found in the inclusion may read it.
+  nlohmann::json actual;
+  bool included = true;
+  std::vector<std::string> order;
+  settings::loadIncrementally(
+      "TEST_asettings.json", {}, &actual, nullptr, nullptr,
+      [&](const std::string& _key) {
+        order.push_back(_key);
+        if (_key == "a") {
+          included = !actual.at("z").is_string();
+        }
+      });
+  ASSERT_FALSE(included);
+  ASSERT_EQ(order, std::vector<std::string>({"a", "z"}));
+  ASSERT_EQ(actual["z"]["r"].get<u64>(), 1u);
+  ASSERT_EQ(actual["z"]["big"].size(), 100000u);
+
+  // References found later can't create values in ready subtrees.
+  big["r"] = "$&(/a/w)&$";
+  settings::writeToFile(big, "TEST_bsettings.json");
+  ASSERT_THROW(
+      settings::loadIncrementally("TEST_asettings.json", {}, &actual, nullptr,
+                                  nullptr, [](const std::string&) {}),
+      settings::Error);
+
+  removeTestFiles();
+}
+
+TEST(Async, initFileAsync) {
+  writeTestFiles();
+
+  std::atomic<bool> called(false);
+  std::unique_ptr<settings::AsyncSettings> async = settings::initFileAsync(
+      "TEST_asettings.json",
+      [&](const nlohmann::json& _settings, const settings::Error* _error) {
+        ASSERT_EQ(_error, nullptr);
+        ASSERT_EQ(_settings["c"][2].get<u64>(), 3u);
+        called = true;
+      });
+  ASSERT_EQ(async->get("b").get<u64>(), 1u);
+  ASSERT_EQ(async->get("a")["x"][0].get<u64>(), 1u);
+  ASSERT_EQ(async->get("c"), async->get("a")["x"]);
+  const nlohmann::json& settings = async->wait();
+  ASSERT_TRUE(async->done());
+  ASSERT_TRUE(async->ready("d"));
+  ASSERT_FALSE(async->ready("e"));
+  ASSERT_EQ(settings.size(), 4u);
+  async.reset();
+  ASSERT_TRUE(called);
+
+  removeTestFiles();
+}
+
+TEST(Async, commandLineAsync) {
+  writeTestFiles();
+
+  const char* argv[] = {"exe", "-d", "TEST_asettings.json", "/d=uint=7",
+                        "/a/x/1=ref=/d"};
+  std::unique_ptr<settings::AsyncSettings> async =
+      settings::commandLineAsync(5, argv);
+  ASSERT_EQ(async->get("c")[1].get<u64>(), 7u);
+  ASSERT_EQ(async->get("d").get<u64>(), 7u);
+
+  nlohmann::json expected;
+  settings::commandLine(5, argv, &expected);
+  ASSERT_EQ(async->wait(), expected);
+
+  removeTestFiles();
+}
+
+TEST(Async, failure) {
+  std::atomic<bool> failed(false);
+  settings::AsyncSettings async(
+      "TEST_nope.json", {},
+      [&](const nlohmann::json&, const settings::Error* _error) {
+        ASSERT_NE(_error, nullptr);
+        failed = true;
+      });
+  while (!async.done()) {
+  }
+  ASSERT_FALSE(async.ready("a"));
+  ASSERT_DEATH(async.get("a"), "couldn't read file TEST_nope.json");
+  ASSERT_DEATH(async.wait(), "couldn't read file TEST_nope.json");
+}
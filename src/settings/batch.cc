@@ -0,0 +1,131 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/batch.h"
+
+#include <chrono>  // NOLINT
+#include <cinttypes>
+#include <cstdio>
+#include <exception>
+#include <utility>
+
+#include "fio/InFile.h"
+#include "settings/pool.h"
+#include "settings/settings.h"
+#include "strop/strop.h"
+
+namespace settings {
+
+// Loads a single entry of a batch.
+static void loadEntry(const BatchEntry& _entry, bool _keep,
+                      IncludeCache* _cache, BatchResult* _result);
+
+/*** public functions below here ***/
+
+void readManifest(const std::string& _manifest_file,
+                  std::vector<BatchEntry>* _entries) {
+  std::string text;
+  fio::InFile::Status sts = fio::InFile::readFile(_manifest_file, &text);
+  if (sts != fio::InFile::Status::OK) {
+    fprintf(stderr, "Settings error: couldn't read manifest %s\n",
+            _manifest_file.c_str());
+    exit(-1);
+  }
+
+  std::vector<std::string> lines = strop::split(text, '\n');
+  for (u64 idx = 0; idx < lines.size(); idx++) {
+    const std::string& line = lines[idx];
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+      continue;
+    }
+    try {
+      nlohmann::json desc = nlohmann::json::parse(line);
+      BatchEntry entry;
+      entry.config = desc.at("config").get<std::string>();
+      if (desc.contains("overrides")) {
+        entry.overrides =
+            desc.at("overrides").get<std::vector<std::string>>();
+      }
+      if (desc.contains("output")) {
+        entry.output = desc.at("output").get<std::string>();
+      }
+      _entries->push_back(entry);
+    } catch (nlohmann::json::exception& e) {
+      fprintf(stderr, "Settings error: invalid manifest line %s:%" PRIu64
+              "\n%s\n", _manifest_file.c_str(), idx + 1, e.what());
+      exit(-1);
+    }
+  }
+}
+
+void loadBatch(const std::vector<BatchEntry>& _entries, u32 _threads,
+               bool _keep, std::vector<BatchResult>* _results) {
+  _results->clear();
+  _results->resize(_entries.size());
+  IncludeCache cache;
+  ThreadPool pool(_threads);
+  for (u64 idx = 0; idx < _entries.size(); idx++) {
+    const BatchEntry* entry = &_entries[idx];
+    BatchResult* result = &(*_results)[idx];
+    pool.run([entry, _keep, &cache, result] {
+      loadEntry(*entry, _keep, &cache, result);
+    });
+  }
+  pool.wait();
+}
+
+/*** static functions below here ***/
+
+static void loadEntry(const BatchEntry& _entry, bool _keep,
+                      IncludeCache* _cache, BatchResult* _result) {
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  _result->ok = true;
+  try {
+    nlohmann::json settings;
+    LoadOptions options;
+    options.cache = _cache;
+    load(_entry.config, _entry.overrides, &settings, nullptr, options);
+    if (!_entry.output.empty()) {
+      save(settings, _entry.output);
+    }
+    if (_keep) {
+      _result->settings = std::move(settings);
+    }
+  } catch (std::exception& e) {
+    _result->ok = false;
+    _result->error = e.what();
+  }
+  _result->seconds = std::chrono::duration<f64>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+}
+
+}  // namespace settings
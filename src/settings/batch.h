@@ -0,0 +1,75 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SETTINGS_BATCH_H_
+#define SETTINGS_BATCH_H_
+
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "prim/prim.h"
+
+namespace settings {
+
+// This describes one load of a batch.
+struct BatchEntry {
+  std::string config;                  // settings file
+  std::vector<std::string> overrides;  // settings updates (see commandLine())
+  std::string output;                  // if given, resolved settings go here
+};
+
+// This is the status of one load of a batch.
+struct BatchResult {
+  bool ok;
+  std::string error;        // set upon failure
+  nlohmann::json settings;  // resolved settings, if kept
+  f64 seconds;              // time to load (and write)
+};
+
+// this reads a JSON Lines manifest. Each non-empty line is an object with a
+//  "config" string and optionally an "overrides" array of strings and an
+//  "output" string.
+//  error print and exit(-1) upon failure
+void readManifest(const std::string& _manifest_file,
+                  std::vector<BatchEntry>* _entries);
+
+// this loads all entries concurrently using _threads threads (0 means one per
+//  hardware thread). Included files are read and parsed once for the whole
+//  batch and released when it completes.
+//  outputs are written the same way as writeToFile()
+//  if _keep is true, the resolved settings are kept in the results.
+//  failures are reported per entry
+void loadBatch(const std::vector<BatchEntry>& _entries, u32 _threads,
+               bool _keep, std::vector<BatchResult>* _results);
+
+}  // namespace settings
+
+#endif  // SETTINGS_BATCH_H_
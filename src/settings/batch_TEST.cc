@@ -0,0 +1,179 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/batch.h"
+
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+#include "settings/settings.h"
+
+TEST(Batch, loadBatch) {
+  const char* afilename = "TEST_asettings.json";
+  FILE* afp = fopen(afilename, "w");
+  assert(afp != NULL);
+  fprintf(afp, "%s",
+          "{\"sub\": \"$$(TEST_bsettings.json)$$\", \"a\": 1,"
+          " \"r\": \"$&(/sub/x)&$\"}");
+  fclose(afp);
+
+  const char* bfilename = "TEST_bsettings.json";
+  FILE* bfp = fopen(bfilename, "w");
+  assert(bfp != NULL);
+  fprintf(bfp, "%s", "{\"x\": [1, 2, 3]}");
+  fclose(bfp);
+
+  const char* mfilename = "TEST_manifest.jsonl";
+  FILE* mfp = fopen(mfilename, "w");
+  assert(mfp != NULL);
+  fprintf(mfp, "%s",
+          "{\"config\": \"TEST_asettings.json\"}\n"
+          "\n"
+          "{\"config\": \"TEST_asettings.json\", \"overrides\": [\"/a=int=7\","
+          " \"/sub/x/1=ref=/a\"], \"output\": \"TEST_out.json\"}\n"
+          "{\"config\": \"TEST_nope.json\"}\n"
+          "{\"config\": \"TEST_bsettings.json\", \"overrides\": [\"/x=int=z\"]}"
+          "\n");
+  fclose(mfp);
+
+  std::vector<settings::BatchEntry> entries;
+  settings::readManifest(mfilename, &entries);
+  ASSERT_EQ(entries.size(), 4u);
+  ASSERT_EQ(entries.at(1).overrides.size(), 2u);
+  ASSERT_EQ(entries.at(1).output, "TEST_out.json");
+
+  for (u32 threads : {1u, 4u}) {
+    std::vector<settings::BatchResult> results;
+    settings::loadBatch(entries, threads, true, &results);
+    ASSERT_EQ(results.size(), 4u);
+
+    ASSERT_TRUE(results.at(0).ok);
+    ASSERT_EQ(results.at(0).settings["sub"]["x"][2].get<u64>(), 3u);
+    ASSERT_EQ(results.at(0).settings["r"], results.at(0).settings["sub"]["x"]);
+    ASSERT_EQ(results.at(0).settings["a"].get<u64>(), 1u);
+
+    ASSERT_TRUE(results.at(1).ok);
+    ASSERT_EQ(results.at(1).settings["a"].get<s64>(), 7);
+    ASSERT_EQ(results.at(1).settings["sub"]["x"][1].get<s64>(), 7);
+    nlohmann::json out;
+    settings::initFile("TEST_out.json", &out);
+    ASSERT_EQ(out, results.at(1).settings);
+
+    ASSERT_FALSE(results.at(2).ok);
+    ASSERT_NE(results.at(2).error.find("TEST_nope.json"), std::string::npos);
+
+    ASSERT_FALSE(results.at(3).ok);
+    ASSERT_NE(results.at(3).error.find("invalid int"), std::string::npos);
+  }
+
+  assert(remove(afilename) == 0);
+  assert(remove(bfilename) == 0);
+  assert(remove(mfilename) == 0);
+  assert(remove("TEST_out.json") == 0);
+}
+
+TEST(Batch, includeCache) {
+  const char* afilename = "TEST_asettings.json";
+  FILE* afp = fopen(afilename, "w");
+  assert(afp != NULL);
+  fprintf(afp, "%s",
+          "{\"b1\": \"$$(TEST_bsettings.json)$$\","
+          " \"b2\": \"$$(TEST_bsettings.json)$$\"}");
+  fclose(afp);
+
+  const char* bfilename = "TEST_bsettings.json";
+  FILE* bfp = fopen(bfilename, "w");
+  assert(bfp != NULL);
+  fprintf(bfp, "%s", "{\"x\": [1, 2, 3]}");
+  fclose(bfp);
+
+  settings::IncludeCache cache(true);
+  settings::LoadOptions options;
+  options.cache = &cache;
+  nlohmann::json settings1;
+  settings::Origins origins1;
+  settings::load(afilename, {"/b1/x/0=uint=9"}, &settings1, &origins1,
+                 options);
+  ASSERT_EQ(cache.size(), 1u);  // only the included file
+  ASSERT_EQ(settings1["b1"]["x"][0].get<u64>(), 9u);
+  ASSERT_EQ(settings1["b2"]["x"][0].get<u64>(), 1u);
+  ASSERT_EQ(origins1.at("/b1"), "./TEST_bsettings.json");
+
+  // The cached files aren't affected by updates.
+  assert(remove(bfilename) == 0);
+  nlohmann::json settings2;
+  settings::Origins origins2;
+  settings::load(afilename, {}, &settings2, &origins2, options);
+  ASSERT_EQ(settings2["b1"]["x"][0].get<u64>(), 1u);
+  ASSERT_EQ(origins2.at("/b2"), "./TEST_bsettings.json");
+
+  // Different paths to the same file share an entry.
+  char* cwd = getcwd(nullptr, 0);
+  assert(cwd != nullptr);
+  std::string dir = cwd;
+  free(cwd);
+  dir = dir.substr(dir.find_last_of('/') + 1);
+  afp = fopen(afilename, "w");
+  assert(afp != NULL);
+  fprintf(afp,
+          "{\"b1\": \"$$(./TEST_bsettings.json)$$\","
+          " \"b2\": \"$$(../%s/TEST_bsettings.json)$$\"}",
+          dir.c_str());
+  fclose(afp);
+  settings::load(afilename, {}, &settings2, nullptr, options);
+  ASSERT_EQ(cache.size(), 1u);
+  ASSERT_EQ(settings2["b2"]["x"][0].get<u64>(), 1u);
+
+  // Lazy loads have their own entries.
+  bfp = fopen(bfilename, "w");
+  assert(bfp != NULL);
+  fprintf(bfp, "%s", "{\"x\": \"$%(range(0,2))%$\"}");
+  fclose(bfp);
+  options.lazy_generators = true;
+  settings::load(afilename, {}, &settings2, nullptr, options);
+  ASSERT_EQ(cache.size(), 2u);
+  ASSERT_EQ(settings2["b1"]["x"], "$%(range(0,2))%$");
+  assert(remove(bfilename) == 0);
+
+  // Errors are thrown.
+  ASSERT_THROW(settings::load("TEST_nope.json", {}, &settings2),
+               settings::Error);
+  ASSERT_THROW(settings::load(afilename, {"/b1=bool=maybe"}, &settings2),
+               settings::Error);
+
+  assert(remove(afilename) == 0);
+}
@@ -0,0 +1,366 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/compress.h"
+
+#include <zlib.h>
+
+#ifdef SETTINGS_ZSTD
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <streambuf>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "fio/OutFile.h"
+#include "settings/pool.h"
+#include "settings/settings.h"
+
+namespace settings {
+
+// This is the amount of decompressed data buffered by streams.
+static const u64 STREAM_BUFFER_BYTES = 128 * 1024;
+
+// This is the minimum amount of text compressed by each gzip thread.
+static const u64 MIN_CHUNK_BYTES = 1024 * 1024;
+
+// This returns true if the string ends with the suffix.
+static bool endsWith(const std::string& _str, const std::string& _suffix);
+
+// This compresses one chunk of text as a gzip member.
+static void gzipChunk(const char* _text, u64 _size, s32 _level,
+                      std::string* _out);
+
+// This decompresses a gzip file (including multiple members) as it is read.
+class GzipBuffer : public std::streambuf {
+ public:
+  explicit GzipBuffer(const std::string& _file)
+      : file_(_file), buffer_(STREAM_BUFFER_BYTES) {
+    gz_ = gzopen(_file.c_str(), "rb");
+    if (gz_ == nullptr) {
+      throw Error("couldn't read file " + _file);
+    }
+    gzbuffer(gz_, STREAM_BUFFER_BYTES);
+  }
+
+  ~GzipBuffer() override {
+    gzclose(gz_);
+  }
+
+ protected:
+  int_type underflow() override {
+    s32 bytes = gzread(gz_, buffer_.data(), buffer_.size());
+    if (bytes < 0) {
+      s32 errnum;
+      throw Error("couldn't decompress file " + file_ + ": " +
+                  gzerror(gz_, &errnum));
+    }
+    if (bytes == 0) {
+      return traits_type::eof();
+    }
+    setg(buffer_.data(), buffer_.data(), buffer_.data() + bytes);
+    return traits_type::to_int_type(buffer_[0]);
+  }
+
+ private:
+  std::string file_;
+  gzFile gz_;
+  std::vector<char> buffer_;
+};
+
+#ifdef SETTINGS_ZSTD
+// This decompresses a zstd file (including multiple frames) as it is read.
+class ZstdBuffer : public std::streambuf {
+ public:
+  explicit ZstdBuffer(const std::string& _file)
+      : file_(_file),
+        in_(ZSTD_DStreamInSize()),
+        out_(ZSTD_DStreamOutSize()),
+        input_{in_.data(), 0, 0},
+        pending_(0) {
+    fp_ = fopen(_file.c_str(), "rb");
+    if (fp_ == nullptr) {
+      throw Error("couldn't read file " + _file);
+    }
+    stream_ = ZSTD_createDStream();
+  }
+
+  ~ZstdBuffer() override {
+    ZSTD_freeDStream(stream_);
+    fclose(fp_);
+  }
+
+ protected:
+  int_type underflow() override {
+    while (true) {
+      // Reads more compressed data when all of it has been consumed.
+      if (input_.pos == input_.size) {
+        input_.size = fread(in_.data(), 1, in_.size(), fp_);
+        input_.pos = 0;
+        if (input_.size == 0) {
+          if (ferror(fp_) != 0 || pending_ != 0) {
+            throw Error("couldn't decompress file " + file_ +
+                        ": truncated or unreadable");
+          }
+          return traits_type::eof();
+        }
+      }
+
+      // Decompresses until some output is produced.
+      ZSTD_outBuffer output = {out_.data(), out_.size(), 0};
+      pending_ = ZSTD_decompressStream(stream_, &output, &input_);
+      if (ZSTD_isError(pending_)) {
+        throw Error("couldn't decompress file " + file_ + ": " +
+                    ZSTD_getErrorName(pending_));
+      }
+      if (output.pos > 0) {
+        setg(out_.data(), out_.data(), out_.data() + output.pos);
+        return traits_type::to_int_type(out_[0]);
+      }
+    }
+  }
+
+ private:
+  std::string file_;
+  FILE* fp_;
+  ZSTD_DStream* stream_;
+  std::vector<char> in_;
+  std::vector<char> out_;
+  ZSTD_inBuffer input_;
+  size_t pending_;
+};
+#endif  // SETTINGS_ZSTD
+
+// This is an input stream that owns its stream buffer.
+class DecompressedStream : public std::istream {
+ public:
+  explicit DecompressedStream(std::unique_ptr<std::streambuf> _buffer)
+      : std::istream(_buffer.get()), buffer_(std::move(_buffer)) {}
+
+ private:
+  std::unique_ptr<std::streambuf> buffer_;
+};
+
+/*** public functions below here ***/
+
+bool compressionSupported(Compression _compression) {
+#ifdef SETTINGS_ZSTD
+  const bool zstd = true;
+#else
+  const bool zstd = false;
+#endif
+  return zstd || _compression != Compression::ZSTD;
+}
+
+Compression extensionCompression(const std::string& _file) {
+  if (endsWith(_file, ".gz")) {
+    return Compression::GZIP;
+  } else if (endsWith(_file, ".zst")) {
+    return Compression::ZSTD;
+  } else {
+    return Compression::NONE;
+  }
+}
+
+Compression fileCompression(const std::string& _file) {
+  Compression compression = extensionCompression(_file);
+  if (compression != Compression::NONE) {
+    return compression;
+  }
+
+  // Reads the magic bytes.
+  FILE* fp = fopen(_file.c_str(), "rb");
+  if (fp == nullptr) {
+    throw Error("couldn't read file " + _file);
+  }
+  u8 magic[4] = {0, 0, 0, 0};
+  u64 bytes = fread(magic, 1, sizeof(magic), fp);
+  fclose(fp);
+  if (bytes >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+    return Compression::GZIP;
+  } else if (bytes == 4 && magic[0] == 0x28 && magic[1] == 0xb5 &&
+             magic[2] == 0x2f && magic[3] == 0xfd) {
+    return Compression::ZSTD;
+  } else {
+    return Compression::NONE;
+  }
+}
+
+std::unique_ptr<std::istream> openDecompressed(const std::string& _file,
+                                               Compression _compression) {
+  std::unique_ptr<std::streambuf> buffer;
+  switch (_compression) {
+    case Compression::GZIP:
+      buffer = std::make_unique<GzipBuffer>(_file);
+      break;
+    case Compression::ZSTD:
+#ifdef SETTINGS_ZSTD
+      buffer = std::make_unique<ZstdBuffer>(_file);
+      break;
+#else
+      throw Error("zstd isn't supported, couldn't read file " + _file);
+#endif
+    default:
+      throw Error("file " + _file + " isn't compressed");
+  }
+  return std::make_unique<DecompressedStream>(std::move(buffer));
+}
+
+std::string compress(const std::string& _text, Compression _compression,
+                     s32 _level, u32 _threads) {
+  if (_threads == 0) {
+    _threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  switch (_compression) {
+    case Compression::NONE:
+      return _text;
+
+    case Compression::GZIP: {
+      // Compresses chunks concurrently as independent gzip members.
+      u64 chunk = std::max(MIN_CHUNK_BYTES, (_text.size() + _threads - 1) /
+                                                std::max(1u, _threads));
+      u64 chunks = std::max<u64>(1, (_text.size() + chunk - 1) / chunk);
+      std::vector<std::string> members(chunks);
+      if (chunks == 1) {
+        gzipChunk(_text.data(), _text.size(), _level, &members[0]);
+      } else {
+        ThreadPool pool(std::min<u64>(_threads, chunks));
+        for (u64 idx = 0; idx < chunks; idx++) {
+          u64 size = std::min(chunk, _text.size() - idx * chunk);
+          const char* text = _text.data() + idx * chunk;
+          std::string* member = &members[idx];
+          pool.run([text, size, _level, member] {
+            gzipChunk(text, size, _level, member);
+          });
+        }
+        pool.wait();
+      }
+      std::string out;
+      for (const std::string& member : members) {
+        if (member.empty()) {
+          throw Error("gzip compression failed");
+        }
+        out += member;
+      }
+      return out;
+    }
+
+    case Compression::ZSTD: {
+#ifdef SETTINGS_ZSTD
+      ZSTD_CCtx* ctx = ZSTD_createCCtx();
+      ZSTD_CCtx_setParameter(ctx, ZSTD_c_compressionLevel,
+                             _level == 0 ? ZSTD_CLEVEL_DEFAULT : _level);
+      if (_threads > 1) {
+        // This fails harmlessly if zstd was built without threads.
+        ZSTD_CCtx_setParameter(ctx, ZSTD_c_nbWorkers, _threads);
+      }
+      std::string out(ZSTD_compressBound(_text.size()), '\0');
+      size_t size = ZSTD_compress2(ctx, &out[0], out.size(), _text.data(),
+                                   _text.size());
+      ZSTD_freeCCtx(ctx);
+      if (ZSTD_isError(size)) {
+        throw Error(std::string("zstd compression failed: ") +
+                    ZSTD_getErrorName(size));
+      }
+      out.resize(size);
+      return out;
+#else
+      throw Error("zstd isn't supported");
+#endif
+    }
+
+    default:
+      throw Error("invalid compression");
+  }
+}
+
+void writeCompressed(const std::string& _file, const std::string& _text,
+                     s32 _level, u32 _threads) {
+  Compression compression = extensionCompression(_file);
+  fio::OutFile::Status sts;
+  if (compression == Compression::NONE) {
+    sts = fio::OutFile::writeFile(_file, _text);
+  } else {
+    sts = fio::OutFile::writeFile(
+        _file, compress(_text, compression, _level, _threads));
+  }
+  if (sts != fio::OutFile::Status::OK) {
+    throw Error("couldn't write to file " + _file);
+  }
+}
+
+/*** static functions below here ***/
+
+static bool endsWith(const std::string& _str, const std::string& _suffix) {
+  return _str.size() >= _suffix.size() &&
+         _str.compare(_str.size() - _suffix.size(), _suffix.size(), _suffix) ==
+             0;
+}
+
+static void gzipChunk(const char* _text, u64 _size, s32 _level,
+                      std::string* _out) {
+  // A failure leaves the output empty.
+  z_stream strm;
+  memset(&strm, 0, sizeof(strm));
+  if (deflateInit2(&strm, _level == 0 ? Z_DEFAULT_COMPRESSION : _level,
+                   Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    return;
+  }
+
+  // zlib takes at most 4 GiB at a time.
+  const u64 max_step = 1ull << 30;
+  u64 bound = deflateBound(&strm, _size);
+  _out->resize(bound);
+  u64 consumed = 0;
+  s32 ret = Z_OK;
+  while (ret == Z_OK) {
+    if (strm.avail_in == 0 && consumed < _size) {
+      u64 step = std::min(max_step, _size - consumed);
+      strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(_text)) +
+                     consumed;
+      strm.avail_in = step;
+      consumed += step;
+    }
+    if (strm.avail_out == 0) {
+      strm.next_out = reinterpret_cast<Bytef*>(&(*_out)[0]) + strm.total_out;
+      strm.avail_out = std::min(max_step, bound - strm.total_out);
+    }
+    ret = deflate(&strm, consumed == _size ? Z_FINISH : Z_NO_FLUSH);
+  }
+  _out->resize(ret == Z_STREAM_END ? strm.total_out : 0);
+  deflateEnd(&strm);
+}
+
+}  // namespace settings
@@ -0,0 +1,79 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SETTINGS_COMPRESS_H_
+#define SETTINGS_COMPRESS_H_
+
+#include <istream>
+#include <memory>
+#include <string>
+
+#include "prim/prim.h"
+
+namespace settings {
+
+// This is the compression of a settings file. Zstandard is only supported
+// when built with SETTINGS_ZSTD defined.
+enum class Compression { NONE, GZIP, ZSTD };
+
+// this returns true if the compression is supported by this build
+bool compressionSupported(Compression _compression);
+
+// this returns the compression implied by the file extension (".gz" or
+//  ".zst")
+Compression extensionCompression(const std::string& _file);
+
+// this returns the compression of an existing file by its extension or, if it
+//  has neither compressed extension, by its magic bytes
+//  throws settings::Error if the file can't be read
+Compression fileCompression(const std::string& _file);
+
+// this opens a stream that decompresses the file while it is read. Errors
+//  while reading throw settings::Error.
+//  throws settings::Error if the file can't be opened
+std::unique_ptr<std::istream> openDecompressed(const std::string& _file,
+                                               Compression _compression);
+
+// this compresses the text. Level 0 is the default level of the compression.
+//  _threads threads are used (0 means one per hardware thread). Multithreaded
+//  gzip output consists of multiple gzip members.
+//  throws settings::Error upon failure
+std::string compress(const std::string& _text, Compression _compression,
+                     s32 _level, u32 _threads);
+
+// this writes the text to a file, compressed as implied by its extension
+//  (see compress())
+//  throws settings::Error upon failure
+void writeCompressed(const std::string& _file, const std::string& _text,
+                     s32 _level, u32 _threads);
+
+}  // namespace settings
+
+#endif  // SETTINGS_COMPRESS_H_
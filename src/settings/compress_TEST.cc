@@ -0,0 +1,115 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/compress.h"
+
+#include <string>
+
+#include "fio/OutFile.h"
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+#include "settings/settings.h"
+
+static nlohmann::json bigSettings() {
+  nlohmann::json settings;
+  for (u64 idx = 0; idx < 40000; idx++) {
+    settings["key" + std::to_string(idx)] = {idx, "value", idx * 0.5};
+  }
+  return settings;
+}
+
+TEST(Compress, roundTrip) {
+  nlohmann::json settings = bigSettings();
+  std::string text = settings::toString(settings);
+  ASSERT_GT(text.size(), 2000000u);
+
+  for (const char* ext : {".gz", ".zst"}) {
+    std::string file = std::string("TEST_settings.json") + ext;
+    settings::Compression compression = settings::extensionCompression(file);
+    if (!settings::compressionSupported(compression)) {
+      continue;
+    }
+    for (u32 threads : {1u, 4u}) {
+      settings::writeToFile(settings, file, 3, threads);
+      ASSERT_EQ(settings::fileCompression(file), compression);
+
+      // Multithreaded gzip output has multiple members.
+      std::string compressed =
+          settings::compress(text, compression, 3, threads);
+      ASSERT_LT(compressed.size(), text.size() / 4);
+
+      nlohmann::json loaded;
+      settings::initFile(file, &loaded);
+      ASSERT_EQ(loaded, settings);
+    }
+    assert(remove(file.c_str()) == 0);
+  }
+}
+
+TEST(Compress, includesAndUpdates) {
+  // The included file is compressed but has no compressed extension.
+  std::string text = "{\"x\": [1, 2, 3]}";
+  ASSERT_EQ(fio::OutFile::writeFile(
+                "TEST_bsettings.json",
+                settings::compress(text, settings::Compression::GZIP, 0, 1)),
+            fio::OutFile::Status::OK);
+  ASSERT_EQ(settings::fileCompression("TEST_bsettings.json"),
+            settings::Compression::GZIP);
+
+  nlohmann::json root = {{"b", "$$(TEST_bsettings.json)$$"},
+                         {"r", "$&(/b/x/1)&$"}};
+  settings::writeToFile(root, "TEST_asettings.json.gz");
+
+  const char* argv[] = {"exe", "TEST_asettings.json.gz",
+                        "/c=file=TEST_bsettings.json"};
+  nlohmann::json settings;
+  settings::commandLine(3, argv, &settings);
+  ASSERT_EQ(settings["b"]["x"][2].get<u64>(), 3u);
+  ASSERT_EQ(settings["r"].get<u64>(), 2u);
+  ASSERT_EQ(settings["c"], settings["b"]);
+
+  assert(remove("TEST_asettings.json.gz") == 0);
+  assert(remove("TEST_bsettings.json") == 0);
+}
+
+TEST(Compress, errors) {
+  std::string text = settings::toString(bigSettings());
+  std::string compressed =
+      settings::compress(text, settings::Compression::GZIP, 0, 1);
+  ASSERT_EQ(fio::OutFile::writeFile("TEST_settings.json.gz",
+                                    compressed.substr(0, 10000)),
+            fio::OutFile::Status::OK);
+  nlohmann::json settings;
+  ASSERT_THROW(settings::load("TEST_settings.json.gz", {}, &settings),
+               settings::Error);
+  ASSERT_DEATH(settings::initFile("TEST_settings.json.gz", &settings),
+               "TEST_settings.json.gz");
+  assert(remove("TEST_settings.json.gz") == 0);
+}
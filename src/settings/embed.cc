@@ -0,0 +1,136 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/embed.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+#include "settings/image.h"
+
+namespace settings {
+
+// This splits a namespace qualified symbol into its names.
+static std::vector<std::string> symbolNames(const std::string& _symbol) {
+  std::vector<std::string> names;
+  size_t start = 0;
+  while (true) {
+    size_t end = _symbol.find("::", start);
+    names.push_back(_symbol.substr(start, end - start));
+    if (end == std::string::npos) {
+      break;
+    }
+    start = end + 2;
+  }
+  for (const std::string& name : names) {
+    bool valid = !name.empty() && !isdigit(name[0]);
+    for (char c : name) {
+      valid = valid && (isalnum(c) || c == '_');
+    }
+    if (!valid) {
+      fprintf(stderr, "Settings error: invalid symbol \"%s\"\n",
+              _symbol.c_str());
+      exit(-1);
+    }
+  }
+  return names;
+}
+
+void embed(const nlohmann::json& _settings, const std::string& _symbol,
+           std::string* _source, std::string* _header) {
+  std::vector<std::string> names = symbolNames(_symbol);
+  const std::string& function = names.back();
+  names.pop_back();
+  std::string guard = "SETTINGS_EMBEDDED_";
+  for (char c : _symbol) {
+    guard += (c == ':') ? '_' : static_cast<char>(toupper(c));
+  }
+  guard += "_H_";
+
+  // Generates the header.
+  std::stringstream hdr;
+  hdr << "// Generated by settingsembed. DO NOT EDIT.\n"
+      << "#ifndef " << guard << "\n"
+      << "#define " << guard << "\n"
+      << "\n"
+      << "#include \"settings/image.h\"\n"
+      << "\n";
+  for (const std::string& name : names) {
+    hdr << "namespace " << name << " {\n";
+  }
+  hdr << (names.empty() ? "" : "\n") << "const settings::Image& " << function
+      << "();\n";
+  for (auto it = names.crbegin(); it != names.crend(); ++it) {
+    hdr << (it == names.crbegin() ? "\n" : "") << "}  // namespace " << *it
+        << "\n";
+  }
+  hdr << "\n"
+      << "#endif  // " << guard << "\n";
+  *_header = hdr.str();
+
+  // Generates the source with the image as a byte array.
+  Image image(_settings);
+  const u8* data = reinterpret_cast<const u8*>(image.data());
+  std::stringstream src;
+  src << "// Generated by settingsembed. DO NOT EDIT.\n"
+      << "#include \"settings/image.h\"\n"
+      << "\n";
+  for (const std::string& name : names) {
+    src << "namespace " << name << " {\n";
+  }
+  src << (names.empty() ? "" : "\n") << "namespace {\n"
+      << "\n"
+      << "alignas(8) constexpr unsigned char DATA[" << image.size()
+      << "] = {\n";
+  char hex[8];
+  for (u64 idx = 0; idx < image.size(); idx++) {
+    snprintf(hex, sizeof(hex), "0x%02x,", data[idx]);
+    src << ((idx % 12 == 0) ? "    " : " ") << hex
+        << ((idx % 12 == 11 || idx + 1 == image.size()) ? "\n" : "");
+  }
+  src << "};\n"
+      << "\n"
+      << "}  // namespace\n"
+      << "\n"
+      << "const settings::Image& " << function << "() {\n"
+      << "  static const settings::Image image(DATA, sizeof(DATA));\n"
+      << "  return image;\n"
+      << "}\n";
+  for (auto it = names.crbegin(); it != names.crend(); ++it) {
+    src << (it == names.crbegin() ? "\n" : "") << "}  // namespace " << *it
+        << "\n";
+  }
+  *_source = src.str();
+}
+
+}  // namespace settings
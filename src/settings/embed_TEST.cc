@@ -0,0 +1,80 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/embed.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+#include "prim/prim.h"
+#include "settings/image.h"
+
+TEST(Embed, embed) {
+  nlohmann::json settings = {{"a", {1, 2, 3}}, {"b", {{"c", "hello"}}}};
+  std::string source;
+  std::string header;
+  settings::embed(settings, "app::cfg::settings", &source, &header);
+
+  ASSERT_NE(header.find("#ifndef SETTINGS_EMBEDDED_APP__CFG__SETTINGS_H_"),
+            std::string::npos);
+  ASSERT_NE(header.find("namespace app {\nnamespace cfg {\n\n"
+                        "const settings::Image& settings();\n\n"
+                        "}  // namespace cfg\n}  // namespace app\n"),
+            std::string::npos);
+  ASSERT_NE(source.find("static const settings::Image image(DATA, "
+                        "sizeof(DATA));"),
+            std::string::npos);
+
+  // The embedded bytes are the image.
+  size_t start = source.find("= {\n") + 4;
+  size_t end = source.find("};\n", start);
+  std::vector<u8> bytes;
+  for (size_t pos = source.find("0x", start); pos < end;
+       pos = source.find("0x", pos + 4)) {
+    bytes.push_back(std::stoul(source.substr(pos, 4), nullptr, 16));
+  }
+  settings::Image image(settings);
+  ASSERT_EQ(bytes.size(), image.size());
+  std::vector<u64> aligned((bytes.size() + 7) / 8);
+  memcpy(aligned.data(), bytes.data(), bytes.size());
+  settings::Image embedded(aligned.data(), bytes.size());
+  ASSERT_EQ(embedded.root().toJson(), settings);
+
+  // Symbols without namespaces work, invalid symbols don't.
+  settings::embed(settings, "config", &source, &header);
+  ASSERT_NE(header.find("\nconst settings::Image& config();\n"),
+            std::string::npos);
+  ASSERT_DEATH(settings::embed(settings, "app::1x", &source, &header),
+               "invalid symbol");
+  ASSERT_DEATH(settings::embed(settings, "app:x", &source, &header),
+               "invalid symbol");
+}
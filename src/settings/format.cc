@@ -0,0 +1,177 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/format.h"
+
+#include <cstring>
+#include <cassert>
+
+#include "settings/settings.h"
+
+namespace settings {
+
+// This is the CBOR self-describe tag (55799) that starts encoded files.
+static const char CBOR_MAGIC[] = "\xd9\xd9\xf7";
+static const u64 CBOR_MAGIC_BYTES = 3;
+
+// This returns true if the string ends with the suffix.
+static bool endsWith(const std::string& _str, const std::string& _suffix);
+
+/*** public functions below here ***/
+
+const char* formatName(Format _format) {
+  switch (_format) {
+    case Format::JSON:
+      return "JSON";
+    case Format::CBOR:
+      return "CBOR";
+    case Format::MSGPACK:
+      return "MessagePack";
+    case Format::BSON:
+      return "BSON";
+    default:
+      assert(false);
+      return nullptr;
+  }
+}
+
+Format extensionFormat(const std::string& _file) {
+  std::string file = _file;
+  for (const char* compressed : {".gz", ".zst"}) {
+    if (endsWith(file, compressed)) {
+      file.resize(file.size() - strlen(compressed));
+      break;
+    }
+  }
+  if (endsWith(file, ".cbor")) {
+    return Format::CBOR;
+  } else if (endsWith(file, ".msgpack") || endsWith(file, ".mpk")) {
+    return Format::MSGPACK;
+  } else if (endsWith(file, ".bson")) {
+    return Format::BSON;
+  } else {
+    return Format::JSON;
+  }
+}
+
+Format dataFormat(const std::string& _data) {
+  if (_data.empty()) {
+    return Format::JSON;
+  }
+  if (_data.compare(0, CBOR_MAGIC_BYTES, CBOR_MAGIC) == 0) {
+    return Format::CBOR;
+  }
+
+  // A BSON document starts with its little endian size and ends with a zero.
+  if (_data.size() >= 5 && _data.back() == '\0') {
+    u64 size = 0;
+    for (u32 idx = 0; idx < 4; idx++) {
+      size |= static_cast<u64>(static_cast<u8>(_data[idx])) << (8 * idx);
+    }
+    if (size == _data.size()) {
+      return Format::BSON;
+    }
+  }
+
+  // CBOR maps and MessagePack maps and arrays never start JSON text. CBOR
+  //  arrays look like MessagePack maps, so they need the self-describe tag.
+  u8 lead = static_cast<u8>(_data[0]);
+  if ((lead >= 0xa0 && lead <= 0xbb) || lead == 0xbf) {
+    return Format::CBOR;
+  } else if ((lead >= 0x80 && lead <= 0x9f) || (lead >= 0xdc && lead <= 0xdf)) {
+    return Format::MSGPACK;
+  } else {
+    return Format::JSON;
+  }
+}
+
+std::string encode(const nlohmann::json& _settings, Format _format) {
+  std::string data;
+  try {
+    switch (_format) {
+      case Format::CBOR:
+        data.assign(CBOR_MAGIC, CBOR_MAGIC_BYTES);
+        nlohmann::json::to_cbor(_settings, data);
+        break;
+      case Format::MSGPACK:
+        nlohmann::json::to_msgpack(_settings, data);
+        break;
+      case Format::BSON:
+        nlohmann::json::to_bson(_settings, data);
+        break;
+      default:
+        throw Error("can't encode settings as " +
+                    std::string(formatName(_format)));
+    }
+  } catch (nlohmann::json::exception& e) {
+    throw Error("failed to encode " + std::string(formatName(_format)) +
+                ":\n" + e.what());
+  }
+  return data;
+}
+
+void decode(const std::string& _data, Format _format,
+            nlohmann::json* _settings) {
+  try {
+    switch (_format) {
+      case Format::CBOR: {
+        // Binary subtypes are stored as CBOR tags.
+        u64 start = _data.compare(0, CBOR_MAGIC_BYTES, CBOR_MAGIC) == 0
+                        ? CBOR_MAGIC_BYTES
+                        : 0;
+        *_settings = nlohmann::json::from_cbor(
+            _data.begin() + start, _data.end(), true, true,
+            nlohmann::json::cbor_tag_handler_t::store);
+        break;
+      }
+      case Format::MSGPACK:
+        *_settings = nlohmann::json::from_msgpack(_data);
+        break;
+      case Format::BSON:
+        *_settings = nlohmann::json::from_bson(_data);
+        break;
+      default:
+        throw Error("can't decode settings as " +
+                    std::string(formatName(_format)));
+    }
+  } catch (nlohmann::json::exception& e) {
+    throw Error(e.what());
+  }
+}
+
+/*** static functions below here ***/
+
+static bool endsWith(const std::string& _str, const std::string& _suffix) {
+  return _str.size() >= _suffix.size() &&
+         _str.compare(_str.size() - _suffix.size(), _suffix.size(), _suffix) ==
+             0;
+}
+
+}  // namespace settings
@@ -0,0 +1,70 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SETTINGS_FORMAT_H_
+#define SETTINGS_FORMAT_H_
+
+#include <string>
+
+#include "nlohmann/json.hpp"
+
+namespace settings {
+
+// This is the encoding of a settings file. Binary files hold the same values
+// as JSON files, including inclusion and reference strings, and hold typed
+// arrays inline (see settings/sidecar.h). BSON files must hold an object.
+enum class Format { JSON, CBOR, MSGPACK, BSON };
+
+// this returns the name of the format (e.g., "CBOR")
+const char* formatName(Format _format);
+
+// this returns the format implied by the file extension (".cbor", ".msgpack",
+//  ".mpk", or ".bson") ignoring a compressed extension (".gz" or ".zst"),
+//  otherwise JSON
+Format extensionFormat(const std::string& _file);
+
+// this returns the format of the data by its magic bytes. CBOR is detected by
+//  its self-describe tag (always written by encode()) or a leading map,
+//  BSON by its leading size, and MessagePack by a leading map or array.
+//  Anything else is JSON.
+Format dataFormat(const std::string& _data);
+
+// this encodes the settings in a binary format
+//  throws settings::Error upon failure
+std::string encode(const nlohmann::json& _settings, Format _format);
+
+// this decodes settings from a binary format
+//  throws settings::Error upon failure
+void decode(const std::string& _data, Format _format,
+            nlohmann::json* _settings);
+
+}  // namespace settings
+
+#endif  // SETTINGS_FORMAT_H_
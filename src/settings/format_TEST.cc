@@ -0,0 +1,149 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/format.h"
+
+#include <string>
+#include <vector>
+
+#include "fio/OutFile.h"
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+#include "settings/settings.h"
+#include "settings/sidecar.h"
+
+static nlohmann::json someSettings() {
+  std::vector<f64> values = {1.5, -2.0, 3.25};
+  nlohmann::json settings = {
+      {"name", "thing"},
+      {"count", 7},
+      {"offset", -3},
+      {"ratio", 0.25},
+      {"on", true},
+      {"none", nullptr},
+      {"list", {1, "two", {{"three", 3}}}},
+      {"typed", settings::makeTypedArray(values.data(), values.size())}};
+  return settings;
+}
+
+TEST(Format, detect) {
+  ASSERT_EQ(settings::extensionFormat("a.json"), settings::Format::JSON);
+  ASSERT_EQ(settings::extensionFormat("a.cbor"), settings::Format::CBOR);
+  ASSERT_EQ(settings::extensionFormat("a.msgpack"), settings::Format::MSGPACK);
+  ASSERT_EQ(settings::extensionFormat("a.mpk.gz"), settings::Format::MSGPACK);
+  ASSERT_EQ(settings::extensionFormat("a.bson.zst"), settings::Format::BSON);
+  ASSERT_EQ(settings::extensionFormat("cbor"), settings::Format::JSON);
+
+  nlohmann::json settings = someSettings();
+  for (settings::Format format :
+       {settings::Format::CBOR, settings::Format::MSGPACK,
+        settings::Format::BSON}) {
+    std::string data = settings::encode(settings, format);
+    ASSERT_EQ(settings::dataFormat(data), format);
+    nlohmann::json decoded;
+    settings::decode(data, format, &decoded);
+    ASSERT_EQ(decoded, settings) << settings::formatName(format);
+  }
+  ASSERT_EQ(settings::dataFormat(settings::toString(settings)),
+            settings::Format::JSON);
+  ASSERT_EQ(settings::dataFormat(""), settings::Format::JSON);
+
+  // CBOR without the self-describe tag.
+  ASSERT_EQ(settings::dataFormat(std::string(1, '\xa1')),
+            settings::Format::CBOR);
+}
+
+TEST(Format, roundTrip) {
+  nlohmann::json settings = someSettings();
+  for (const char* file :
+       {"TEST_settings.cbor", "TEST_settings.msgpack", "TEST_settings.bson",
+        "TEST_settings.cbor.gz"}) {
+    settings::writeToFile(settings, file);
+    nlohmann::json loaded;
+    settings::initFile(file, &loaded);
+    ASSERT_EQ(loaded, settings) << file;
+    ASSERT_TRUE(settings::isTypedArray(loaded["typed"]));
+    assert(remove(file) == 0);
+  }
+}
+
+TEST(Format, includesAndReferences) {
+  // The binary files have no binary extension.
+  nlohmann::json included = {{"x", {1, 2, 3}}, {"y", "$&(/b/x/2)&$"}};
+  ASSERT_EQ(fio::OutFile::writeFile(
+                "TEST_bsettings.json",
+                settings::encode(included, settings::Format::MSGPACK)),
+            fio::OutFile::Status::OK);
+  ASSERT_EQ(fio::OutFile::writeFile(
+                "TEST_csettings.dat",
+                settings::encode(included, settings::Format::BSON)),
+            fio::OutFile::Status::OK);
+
+  // Markers are kept when written.
+  nlohmann::json root = {{"b", "$$(TEST_bsettings.json)$$"},
+                         {"r", "$&(/b/x/1)&$"}};
+  settings::writeToFile(root, "TEST_asettings.cbor");
+  nlohmann::json raw;
+  settings::decode(
+      settings::encode(root, settings::Format::CBOR), settings::Format::CBOR,
+      &raw);
+  ASSERT_EQ(raw, root);
+
+  const char* argv[] = {"exe", "TEST_asettings.cbor",
+                        "/c=file=TEST_csettings.dat"};
+  nlohmann::json settings;
+  settings::commandLine(3, argv, &settings);
+  ASSERT_EQ(settings["b"]["x"][2].get<u64>(), 3u);
+  ASSERT_EQ(settings["b"]["y"].get<u64>(), 3u);
+  ASSERT_EQ(settings["r"].get<u64>(), 2u);
+  ASSERT_EQ(settings["c"]["x"], settings["b"]["x"]);
+
+  assert(remove("TEST_asettings.cbor") == 0);
+  assert(remove("TEST_bsettings.json") == 0);
+  assert(remove("TEST_csettings.dat") == 0);
+}
+
+TEST(Format, errors) {
+  // BSON only holds objects.
+  ASSERT_THROW(settings::encode(nlohmann::json::array({1, 2}),
+                                settings::Format::BSON),
+               settings::Error);
+
+  std::string data =
+      settings::encode(someSettings(), settings::Format::CBOR);
+  ASSERT_EQ(
+      fio::OutFile::writeFile("TEST_settings.cbor", data.substr(0, 20)),
+      fio::OutFile::Status::OK);
+  nlohmann::json settings;
+  ASSERT_THROW(settings::load("TEST_settings.cbor", {}, &settings),
+               settings::Error);
+  ASSERT_DEATH(settings::initFile("TEST_settings.cbor", &settings), "CBOR");
+  assert(remove("TEST_settings.cbor") == 0);
+}
@@ -0,0 +1,236 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/generator.h"
+
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "settings/settings.h"
+#include "strop/strop.h"
+
+namespace settings {
+
+// This parses a generator argument as a JSON value.
+static nlohmann::json argument(const std::string& _arg,
+                               const std::string& _expr);
+
+// This returns the number as a signed integer.
+static s64 toInt(const nlohmann::json& _number, const std::string& _expr);
+
+// This returns the element of an integer range using JSON parser semantics
+// (i.e., non-negative integers are unsigned).
+static nlohmann::json intElement(s64 _value);
+
+Sequence::Sequence(const nlohmann::json& _value)
+    : kind_(Kind::ARRAY),
+      size_(0),
+      array_(nullptr),
+      int_start_(0),
+      int_step_(0),
+      float_start_(0.0),
+      float_step_(0.0) {
+  if (_value.is_array()) {
+    array_ = &_value;
+    size_ = _value.size();
+  } else if (_value.is_string()) {
+    parse(_value.get_ref<const std::string&>());
+  } else {
+    throw Error("a sequence requires an array or a generator expression");
+  }
+}
+
+u64 Sequence::size() const {
+  return size_;
+}
+
+nlohmann::json Sequence::operator[](u64 _index) const {
+  assert(_index < size_);
+  switch (kind_) {
+    case Kind::ARRAY:
+      return (*array_)[_index];
+    case Kind::INT_RANGE:
+      return intElement(static_cast<s64>(
+          static_cast<u64>(int_start_) + _index * static_cast<u64>(int_step_)));
+    case Kind::FLOAT_RANGE:
+      return float_start_ + static_cast<f64>(_index) * float_step_;
+    case Kind::REPEAT:
+      return value_;
+  }
+  assert(false);
+  return nullptr;
+}
+
+nlohmann::json Sequence::toJson() const {
+  if (kind_ == Kind::ARRAY) {
+    return *array_;
+  }
+  if (size_ > MAX_GENERATED_ELEMENTS) {
+    throw Error("generator expression has " + std::to_string(size_) +
+                " elements, more than the maximum of " +
+                std::to_string(MAX_GENERATED_ELEMENTS));
+  }
+  if (kind_ == Kind::REPEAT) {
+    return nlohmann::json(size_, value_);
+  }
+  nlohmann::json array = nlohmann::json::array();
+  nlohmann::json::array_t& elements = array.get_ref<nlohmann::json::array_t&>();
+  elements.reserve(size_);
+  for (u64 idx = 0; idx < size_; idx++) {
+    elements.push_back((*this)[idx]);
+  }
+  return array;
+}
+
+void Sequence::parse(const std::string& _expr) {
+  // Removes the markers.
+  if (!isGenerator(_expr)) {
+    throw Error("invalid generator expression: " + _expr);
+  }
+  std::string body = _expr.substr(3, _expr.size() - 6);
+
+  // Splits the function name from its arguments.
+  size_t open = body.find_first_of('(');
+  size_t close = body.find_last_not_of(" \t");
+  if (open == std::string::npos || close == std::string::npos ||
+      body[close] != ')') {
+    throw Error("invalid generator expression: " + _expr);
+  }
+  std::string args = body.substr(open + 1, close - open - 1);
+  size_t first = body.find_first_not_of(" \t");
+  size_t last = body.find_last_not_of(" \t", open - 1);
+  std::string name = (open == 0 || last == std::string::npos || last < first)
+                          ? ""
+                          : body.substr(first, last - first + 1);
+
+  if (name == "range") {
+    std::vector<std::string> parts = strop::split(args, ',');
+    if (parts.size() != 2 && parts.size() != 3) {
+      throw Error("range requires 2 or 3 arguments: " + _expr);
+    }
+    nlohmann::json start = argument(parts[0], _expr);
+    nlohmann::json stop = argument(parts[1], _expr);
+    nlohmann::json step =
+        parts.size() == 3 ? argument(parts[2], _expr) : nlohmann::json(1);
+    if (!start.is_number() || !stop.is_number() || !step.is_number()) {
+      throw Error("range requires numbers: " + _expr);
+    }
+
+    if (start.is_number_integer() && stop.is_number_integer() &&
+        step.is_number_integer()) {
+      // Computes the size using unsigned arithmetic to avoid overflow.
+      kind_ = Kind::INT_RANGE;
+      int_start_ = toInt(start, _expr);
+      s64 int_stop = toInt(stop, _expr);
+      int_step_ = toInt(step, _expr);
+      if (int_step_ == 0) {
+        throw Error("range requires a nonzero step: " + _expr);
+      }
+      u64 span, magnitude;
+      if (int_step_ > 0) {
+        span = static_cast<u64>(int_stop) - static_cast<u64>(int_start_);
+        magnitude = static_cast<u64>(int_step_);
+        size_ = int_stop > int_start_ ? (span - 1) / magnitude + 1 : 0;
+      } else {
+        span = static_cast<u64>(int_start_) - static_cast<u64>(int_stop);
+        magnitude = 0 - static_cast<u64>(int_step_);
+        size_ = int_start_ > int_stop ? (span - 1) / magnitude + 1 : 0;
+      }
+    } else {
+      kind_ = Kind::FLOAT_RANGE;
+      float_start_ = start.get<f64>();
+      f64 float_stop = stop.get<f64>();
+      float_step_ = step.get<f64>();
+      f64 count = std::ceil((float_stop - float_start_) / float_step_);
+      if (float_step_ == 0.0 || !std::isfinite(count)) {
+        throw Error("range requires a nonzero step: " + _expr);
+      }
+      if (count >= 18446744073709551616.0) {  // 2^64
+        throw Error("range is too long: " + _expr);
+      }
+      size_ = count > 0.0 ? static_cast<u64>(count) : 0;
+    }
+  } else if (name == "repeat") {
+    // The value may contain commas, the count can't.
+    size_t comma = args.find_last_of(',');
+    if (comma == std::string::npos) {
+      throw Error("repeat requires 2 arguments: " + _expr);
+    }
+    kind_ = Kind::REPEAT;
+    value_ = argument(args.substr(0, comma), _expr);
+    nlohmann::json count = argument(args.substr(comma + 1), _expr);
+    if (!count.is_number_unsigned()) {
+      throw Error("repeat requires a non-negative count: " + _expr);
+    }
+    size_ = count.get<u64>();
+  } else {
+    throw Error("unknown generator \"" + name + "\": " + _expr);
+  }
+}
+
+bool isGenerator(const nlohmann::json& _value) {
+  if (!_value.is_string()) {
+    return false;
+  }
+  const std::string& str = _value.get_ref<const std::string&>();
+  return (str.size() > 6) && (str.compare(0, 3, "$%(") == 0) &&
+         (str.compare(str.size() - 3, 3, ")%$") == 0);
+}
+
+static nlohmann::json argument(const std::string& _arg,
+                               const std::string& _expr) {
+  nlohmann::json value = nlohmann::json::parse(_arg, nullptr, false);
+  if (value.is_discarded()) {
+    throw Error("invalid generator argument \"" + _arg + "\": " + _expr);
+  }
+  return value;
+}
+
+static s64 toInt(const nlohmann::json& _number, const std::string& _expr) {
+  if (_number.is_number_unsigned() &&
+      _number.get<u64>() >
+          static_cast<u64>(std::numeric_limits<s64>::max())) {
+    throw Error("range argument out of range: " + _expr);
+  }
+  return _number.get<s64>();
+}
+
+static nlohmann::json intElement(s64 _value) {
+  if (_value >= 0) {
+    return static_cast<u64>(_value);
+  } else {
+    return _value;
+  }
+}
+
+}  // namespace settings
@@ -0,0 +1,91 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SETTINGS_GENERATOR_H_
+#define SETTINGS_GENERATOR_H_
+
+#include <string>
+
+#include "nlohmann/json.hpp"
+#include "prim/prim.h"
+
+namespace settings {
+
+// Large regular arrays can be written compactly as generator expressions:
+//   "$%(range(start, stop))%$"        start, start+1, ..., excluding stop
+//   "$%(range(start, stop, step))%$"  start, start+step, ..., excluding stop
+//   "$%(repeat(value, count))%$"      count copies of a JSON value
+// Ranges of integers yield integers, otherwise they yield floats. Loading
+// expands generator expressions into arrays unless generators are lazy (see
+// settings::load()).
+
+// the maximum number of elements of an expanded generator expression (lazy
+// generators may be longer)
+const u64 MAX_GENERATED_ELEMENTS = 1ull << 28;
+
+// This is a read-only sequence of the elements of a generator expression or of
+// an array. Generated elements are computed on access and are only
+// materialized by toJson().
+class Sequence {
+ public:
+  // this wraps a generator expression string or an array. An array isn't
+  //  copied and must outlive this object.
+  //  throws settings::Error if the value is neither
+  explicit Sequence(const nlohmann::json& _value);
+
+  u64 size() const;
+  nlohmann::json operator[](u64 _index) const;
+
+  // this returns the elements as an array
+  //  throws settings::Error if a generator expression has more than
+  //  MAX_GENERATED_ELEMENTS elements
+  nlohmann::json toJson() const;
+
+ private:
+  enum class Kind : u8 { ARRAY, INT_RANGE, FLOAT_RANGE, REPEAT };
+
+  void parse(const std::string& _expr);
+
+  Kind kind_;
+  u64 size_;
+  const nlohmann::json* array_;
+  s64 int_start_;
+  s64 int_step_;
+  f64 float_start_;
+  f64 float_step_;
+  nlohmann::json value_;
+};
+
+// this returns true if the value is a "$%(...)%$" generator expression string
+bool isGenerator(const nlohmann::json& _value);
+
+}  // namespace settings
+
+#endif  // SETTINGS_GENERATOR_H_
@@ -0,0 +1,141 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/generator.h"
+
+#include <cassert>
+#include <cstdio>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+#include "settings/settings.h"
+
+TEST(Generator, range) {
+  settings::Sequence a("$%(range(0, 4))%$");
+  ASSERT_EQ(a.size(), 4u);
+  ASSERT_EQ(a.toJson(), nlohmann::json::parse("[0,1,2,3]"));
+
+  settings::Sequence b("$%(range(10,0,-3))%$");
+  ASSERT_EQ(b.toJson(), nlohmann::json::parse("[10,7,4,1]"));
+
+  settings::Sequence c("$%(range(-2,2,3))%$");
+  ASSERT_EQ(c.toJson(), nlohmann::json::parse("[-2,1]"));
+
+  settings::Sequence d("$%(range(0,1,0.25))%$");
+  ASSERT_EQ(d.toJson(), nlohmann::json::parse("[0.0,0.25,0.5,0.75]"));
+
+  ASSERT_EQ(settings::Sequence("$%(range(5,5))%$").size(), 0u);
+  ASSERT_EQ(settings::Sequence("$%(range(5,0))%$").size(), 0u);
+
+  // Huge sequences aren't materialized by access.
+  settings::Sequence e("$%(range(0,9000000000000000000,3))%$");
+  ASSERT_EQ(e.size(), 3000000000000000000u);
+  ASSERT_EQ(e[1000000000000000000u].get<u64>(), 3000000000000000000u);
+  ASSERT_THROW(e.toJson(), settings::Error);
+  ASSERT_THROW(settings::Sequence("$%(repeat(1,1000000000000))%$").toJson(),
+               settings::Error);
+  ASSERT_THROW(settings::Sequence("$%(range(0,1e300,1e-300))%$"),
+               settings::Error);
+}
+
+TEST(Generator, repeat) {
+  settings::Sequence a("$%(repeat({\"a\": [1, 2]}, 3))%$");
+  ASSERT_EQ(a.size(), 3u);
+  ASSERT_EQ(a[2], nlohmann::json::parse("{\"a\": [1, 2]}"));
+  ASSERT_EQ(a.toJson(), nlohmann::json::parse(
+                            "[{\"a\":[1,2]},{\"a\":[1,2]},{\"a\":[1,2]}]"));
+  ASSERT_EQ(settings::Sequence("$%(repeat(\"x\",0))%$").size(), 0u);
+}
+
+TEST(Generator, array) {
+  nlohmann::json array = nlohmann::json::parse("[true, 2, \"three\"]");
+  settings::Sequence a(array);
+  ASSERT_EQ(a.size(), 3u);
+  ASSERT_EQ(a[2].get<std::string>(), "three");
+  ASSERT_EQ(a.toJson(), array);
+}
+
+TEST(Generator, errors) {
+  ASSERT_FALSE(settings::isGenerator("range(0,4)"));
+  ASSERT_FALSE(settings::isGenerator(nlohmann::json(4)));
+  ASSERT_TRUE(settings::isGenerator("$%(range(0,4))%$"));
+  for (const char* expr :
+       {"$%(range(0))%$", "$%(range(0,4,0))%$", "$%(range(a,4))%$",
+        "$%(range(0,1,2,3))%$", "$%(repeat(1))%$", "$%(repeat(1,-1))%$",
+        "$%(repeat(1,2.5))%$", "$%(stride(0,4))%$", "$%(range 0,4)%$",
+        "range(0,4)"}) {
+    ASSERT_THROW(settings::Sequence(nlohmann::json(expr)), settings::Error)
+        << expr;
+  }
+  ASSERT_THROW(settings::Sequence(nlohmann::json(1)), settings::Error);
+}
+
+TEST(Generator, load) {
+  const char* filename = "TEST_settings.json";
+  FILE* fp = fopen(filename, "w");
+  assert(fp != NULL);
+  fprintf(fp, "%s",
+          "{\"ports\": \"$%(range(0,64))%$\",\n"
+          " \"weights\": [\"$%(repeat(0.5,4))%$\", 1],\n"
+          " \"first\": \"$&(/weights/0/3)&$\"}");
+  fclose(fp);
+
+  nlohmann::json settings;
+  settings::load(filename, {"/lanes=uint=$%(range(8,0,-2))%$"}, &settings);
+  ASSERT_EQ(settings["ports"].size(), 64u);
+  ASSERT_EQ(settings["ports"][63].get<u64>(), 63u);
+  ASSERT_EQ(settings["weights"][0], nlohmann::json({0.5, 0.5, 0.5, 0.5}));
+  ASSERT_EQ(settings["first"].get<f64>(), 0.5);
+  ASSERT_EQ(settings["lanes"], nlohmann::json::parse("[8,6,4,2]"));
+
+  // Lazy generators are accessed through sequences.
+  nlohmann::json lazy;
+  settings::LoadOptions options;
+  options.lazy_generators = true;
+  settings::load(filename, {"/lanes=uint=$%(range(8,0,-2))%$",
+                            "/first=float=2.5"},
+                 &lazy, nullptr, options);
+  ASSERT_EQ(lazy["ports"].get<std::string>(), "$%(range(0,64))%$");
+  ASSERT_EQ(settings::Sequence(lazy["ports"]).toJson(), settings["ports"]);
+  ASSERT_EQ(settings::Sequence(lazy["lanes"]).toJson(), settings["lanes"]);
+
+  ASSERT_THROW(
+      settings::load(filename, {"/lanes=uint=$%(range(-1,2))%$"}, &settings),
+      settings::Error);
+  ASSERT_THROW(
+      settings::load(filename, {"/lanes=string=$%(range(0,2))%$"}, &settings),
+      settings::Error);
+  ASSERT_THROW(
+      settings::load(filename, {"/lanes=file=$%(range(0,2))%$"}, &settings),
+      settings::Error);
+
+  assert(remove(filename) == 0);
+}
@@ -0,0 +1,379 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/hash.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace settings {
+
+// These are the type tags mixed into the node hashes.
+enum class Tag : u64 {
+  kNull = 0x6e756c6c00000001ull,
+  kBool = 0x626f6f6c00000002ull,
+  kInt = 0x696e740000000003ull,
+  kUint = 0x75696e7400000004ull,
+  kFloat = 0x666c6f6100000005ull,
+  kString = 0x7374720000000006ull,
+  kArray = 0x6172720000000007ull,
+  kObject = 0x6f626a0000000008ull,
+  kBinary = 0x62696e0000000009ull,
+  kDiscarded = 0x646973630000000aull
+};
+
+static const u64 C1 = 0x87c37b91114253d5ull;
+static const u64 C2 = 0x4cf5ad432745937full;
+
+static inline u64 rotl64(u64 _x, s32 _r) {
+  return (_x << _r) | (_x >> (64 - _r));
+}
+
+static inline u64 fmix64(u64 _k) {
+  _k ^= _k >> 33;
+  _k *= 0xff51afd7ed558ccdull;
+  _k ^= _k >> 33;
+  _k *= 0xc4ceb9fe1a85ec53ull;
+  _k ^= _k >> 33;
+  return _k;
+}
+
+static inline u64 load64(const u8* _ptr) {
+  // Explicitly little endian so that the hash is platform independent.
+  u64 v = 0;
+  for (s32 b = 7; b >= 0; b--) {
+    v = (v << 8) | _ptr[b];
+  }
+  return v;
+}
+
+// This is the MurmurHash3 x64 128 state. Blocks are 2 words (16 bytes).
+class Stream {
+ public:
+  explicit Stream(u64 _seed) : h1_(_seed), h2_(_seed), len_(0) {}
+
+  inline void block(u64 _k1, u64 _k2) {
+    _k1 *= C1;
+    _k1 = rotl64(_k1, 31);
+    _k1 *= C2;
+    h1_ ^= _k1;
+    h1_ = rotl64(h1_, 27);
+    h1_ += h2_;
+    h1_ = h1_ * 5 + 0x52dce729;
+
+    _k2 *= C2;
+    _k2 = rotl64(_k2, 33);
+    _k2 *= C1;
+    h2_ ^= _k2;
+    h2_ = rotl64(h2_, 31);
+    h2_ += h1_;
+    h2_ = h2_ * 5 + 0x38495ab5;
+
+    len_ += 16;
+  }
+
+  inline void tail(const u8* _tail, u64 _size) {
+    assert(_size < 16);
+    u64 k1 = 0;
+    u64 k2 = 0;
+    for (u64 idx = _size; idx > 8; idx--) {
+      k2 = (k2 << 8) | _tail[idx - 1];
+    }
+    for (u64 idx = std::min<u64>(_size, 8); idx > 0; idx--) {
+      k1 = (k1 << 8) | _tail[idx - 1];
+    }
+    if (_size > 8) {
+      k2 *= C2;
+      k2 = rotl64(k2, 33);
+      k2 *= C1;
+      h2_ ^= k2;
+    }
+    if (_size > 0) {
+      k1 *= C1;
+      k1 = rotl64(k1, 31);
+      k1 *= C2;
+      h1_ ^= k1;
+    }
+    len_ += _size;
+  }
+
+  inline Hash128 finish() {
+    u64 h1 = h1_ ^ len_;
+    u64 h2 = h2_ ^ len_;
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+    return {h1, h2};
+  }
+
+ private:
+  u64 h1_;
+  u64 h2_;
+  u64 len_;
+};
+
+// Hashes a primitive value (anything that isn't an array or object).
+static Hash128 hashLeaf(const nlohmann::json& _node);
+
+// Hashes a container given a function that yields the child hashes.
+template <typename F>
+static Hash128 hashContainer(const nlohmann::json& _node, F _child_hash);
+
+/*** public functions below here ***/
+
+bool Hash128::operator==(const Hash128& _other) const {
+  return high == _other.high && low == _other.low;
+}
+
+bool Hash128::operator!=(const Hash128& _other) const {
+  return !(*this == _other);
+}
+
+std::string Hash128::toString() const {
+  char buf[33];
+  snprintf(buf, sizeof(buf), "%016llx%016llx",
+           static_cast<unsigned long long>(high),  // NOLINT
+           static_cast<unsigned long long>(low));  // NOLINT
+  return std::string(buf);
+}
+
+Hash128 hash(const nlohmann::json& _settings) {
+  if (_settings.is_array() || _settings.is_object()) {
+    return hashContainer(_settings, [](const nlohmann::json& _child) {
+      return hash(_child);
+    });
+  } else {
+    return hashLeaf(_settings);
+  }
+}
+
+Hash128 hash(const void* _data, u64 _size, u64 _seed) {
+  const u8* data = reinterpret_cast<const u8*>(_data);
+  Stream stream(_seed);
+  u64 blocks = _size / 16;
+  for (u64 blk = 0; blk < blocks; blk++) {
+    stream.block(load64(data + blk * 16), load64(data + blk * 16 + 8));
+  }
+  stream.tail(data + blocks * 16, _size % 16);
+  return stream.finish();
+}
+
+HashCache::HashCache() {}
+
+HashCache::~HashCache() {}
+
+Hash128 HashCache::hash(const nlohmann::json& _settings) {
+  return hashNode(_settings);
+}
+
+void HashCache::invalidate(const nlohmann::json& _settings,
+                           const std::string& _path) {
+  nlohmann::json::json_pointer ptr;
+  try {
+    ptr = nlohmann::json::json_pointer(_path);
+  } catch (nlohmann::json::parse_error& e) {
+    fprintf(stderr, "Settings error: invalid hash path \"%s\"\n%s\n",
+            _path.c_str(), e.what());
+    exit(-1);
+  }
+
+  // Walks from the root to the path, forgetting each ancestor. Array elements
+  // move when their array is resized, so everything below the deepest array
+  // ancestor is forgotten too.
+  const nlohmann::json* node = &_settings;
+  std::vector<std::string> tokens;
+  for (nlohmann::json::json_pointer p = ptr; !p.empty(); p.pop_back()) {
+    tokens.push_back(p.back());
+  }
+  for (auto it = tokens.crbegin(); node != nullptr; ++it) {
+    cache_.erase(node);
+    if (it == tokens.crend()) {
+      eraseSubtree(*node);
+      break;
+    }
+    const nlohmann::json* next = nullptr;
+    if (node->is_object()) {
+      auto child = node->find(*it);
+      if (child != node->end()) {
+        next = &*child;
+      }
+    } else if (node->is_array()) {
+      if (it + 1 == tokens.crend()) {
+        // The update was to an element of this array.
+        eraseSubtree(*node);
+        break;
+      }
+      char* end;
+      u64 idx = strtoull(it->c_str(), &end, 10);
+      if (*end == '\0' && idx < node->size()) {
+        next = &(*node)[idx];
+      }
+    }
+    node = next;
+  }
+}
+
+void HashCache::clear() {
+  cache_.clear();
+}
+
+u64 HashCache::size() const {
+  return cache_.size();
+}
+
+Hash128 HashCache::hashNode(const nlohmann::json& _node) {
+  if (!_node.is_array() && !_node.is_object()) {
+    return hashLeaf(_node);
+  }
+  auto it = cache_.find(&_node);
+  if (it != cache_.end()) {
+    return it->second;
+  }
+  Hash128 h = hashContainer(_node, [this](const nlohmann::json& _child) {
+    return hashNode(_child);
+  });
+  cache_[&_node] = h;
+  return h;
+}
+
+void HashCache::eraseSubtree(const nlohmann::json& _node) {
+  if (_node.is_array() || _node.is_object()) {
+    cache_.erase(&_node);
+    for (const nlohmann::json& child : _node) {
+      eraseSubtree(child);
+    }
+  }
+}
+
+/*** static functions below here ***/
+
+static Hash128 hashLeaf(const nlohmann::json& _node) {
+  Stream stream(0);
+  switch (_node.type()) {
+    case nlohmann::json::value_t::null:
+      stream.block(static_cast<u64>(Tag::kNull), 0);
+      break;
+
+    case nlohmann::json::value_t::boolean:
+      stream.block(static_cast<u64>(Tag::kBool), _node.get<bool>() ? 1 : 0);
+      break;
+
+    case nlohmann::json::value_t::number_integer:
+      stream.block(static_cast<u64>(Tag::kInt),
+                   static_cast<u64>(_node.get<s64>()));
+      break;
+
+    case nlohmann::json::value_t::number_unsigned: {
+      // Unsigned values that fit in a signed integer hash like signed ones.
+      u64 val = _node.get<u64>();
+      if (val <= static_cast<u64>(std::numeric_limits<s64>::max())) {
+        stream.block(static_cast<u64>(Tag::kInt), val);
+      } else {
+        stream.block(static_cast<u64>(Tag::kUint), val);
+      }
+      break;
+    }
+
+    case nlohmann::json::value_t::number_float: {
+      // Integral floats hash like the equivalent integer.
+      f64 val = _node.get<f64>();
+      if (std::isnan(val)) {
+        stream.block(static_cast<u64>(Tag::kFloat), 0x7ff8000000000000ull);
+      } else if (std::trunc(val) == val && val >= -9223372036854775808.0 &&
+                 val < 9223372036854775808.0) {
+        stream.block(static_cast<u64>(Tag::kInt),
+                     static_cast<u64>(static_cast<s64>(val)));
+      } else if (std::trunc(val) == val && val >= 0.0 &&
+                 val < 18446744073709551616.0) {
+        stream.block(static_cast<u64>(Tag::kUint), static_cast<u64>(val));
+      } else {
+        u64 bits;
+        memcpy(&bits, &val, sizeof(bits));
+        stream.block(static_cast<u64>(Tag::kFloat), bits);
+      }
+      break;
+    }
+
+    case nlohmann::json::value_t::string: {
+      const std::string& str = _node.get_ref<const std::string&>();
+      Hash128 h = hash(str.data(), str.size());
+      stream.block(static_cast<u64>(Tag::kString), str.size());
+      stream.block(h.high, h.low);
+      break;
+    }
+
+    case nlohmann::json::value_t::binary: {
+      const nlohmann::json::binary_t& bin = _node.get_binary();
+      Hash128 h = hash(bin.data(), bin.size());
+      stream.block(static_cast<u64>(Tag::kBinary),
+                   bin.has_subtype() ? bin.subtype() + 1 : 0);
+      stream.block(h.high, h.low);
+      break;
+    }
+
+    default:
+      stream.block(static_cast<u64>(Tag::kDiscarded), 0);
+      break;
+  }
+  return stream.finish();
+}
+
+template <typename F>
+static Hash128 hashContainer(const nlohmann::json& _node, F _child_hash) {
+  Stream stream(0);
+  if (_node.is_object()) {
+    // nlohmann::json objects are ordered by key, which is canonical.
+    stream.block(static_cast<u64>(Tag::kObject), _node.size());
+    for (auto it = _node.cbegin(); it != _node.cend(); ++it) {
+      const std::string& key = it.key();
+      Hash128 kh = hash(key.data(), key.size());
+      Hash128 vh = _child_hash(it.value());
+      stream.block(kh.high, kh.low);
+      stream.block(vh.high, vh.low);
+    }
+  } else {
+    stream.block(static_cast<u64>(Tag::kArray), _node.size());
+    for (const nlohmann::json& child : _node) {
+      Hash128 ch = _child_hash(child);
+      stream.block(ch.high, ch.low);
+    }
+  }
+  return stream.finish();
+}
+
+}  // namespace settings
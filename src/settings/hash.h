@@ -0,0 +1,94 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SETTINGS_HASH_H_
+#define SETTINGS_HASH_H_
+
+#include <string>
+#include <unordered_map>
+
+#include "nlohmann/json.hpp"
+#include "prim/prim.h"
+
+namespace settings {
+
+// this is a 128-bit hash value
+struct Hash128 {
+  u64 high;
+  u64 low;
+
+  bool operator==(const Hash128& _other) const;
+  bool operator!=(const Hash128& _other) const;
+
+  // this returns the hash as a 32 character hex string
+  std::string toString() const;
+};
+
+// this computes a stable structural hash of the settings
+//  object keys are hashed in canonical (sorted) order
+//  numbers are hashed by value (i.e., 3, -0, 3u, and 3.0 hash like 3, 0, 3, 3)
+//  the result doesn't depend on formatting, platform, or process
+Hash128 hash(const nlohmann::json& _settings);
+
+// this computes a stable hash of a sequence of bytes (MurmurHash3 x64 128)
+Hash128 hash(const void* _data, u64 _size, u64 _seed = 0);
+
+// this caches the hashes of subtrees so that rehashing after a small update
+//  only recomputes the hashes along the updated path
+// the cache is keyed by node address, therefore the user must call
+//  invalidate() after each update and clear() after replacing the whole tree
+class HashCache {
+ public:
+  HashCache();
+  ~HashCache();
+
+  // this computes the hash of the settings, reusing cached subtree hashes
+  Hash128 hash(const nlohmann::json& _settings);
+
+  // this invalidates the cached hashes affected by an update at the path
+  //  (RFC 6901). The path may refer to a value that was removed.
+  void invalidate(const nlohmann::json& _settings, const std::string& _path);
+
+  // this removes all cached hashes
+  void clear();
+
+  // this returns the number of cached subtree hashes
+  u64 size() const;
+
+ private:
+  Hash128 hashNode(const nlohmann::json& _node);
+  void eraseSubtree(const nlohmann::json& _node);
+
+  std::unordered_map<const nlohmann::json*, Hash128> cache_;
+};
+
+}  // namespace settings
+
+#endif  // SETTINGS_HASH_H_
@@ -0,0 +1,127 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/hash.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+#include "settings/settings.h"
+
+TEST(Hash, bytes) {
+  // These are the reference MurmurHash3 x64 128 values.
+  settings::Hash128 h = settings::hash("", 0);
+  ASSERT_EQ(h.toString(), "00000000000000000000000000000000");
+  h = settings::hash("hello", 5);
+  ASSERT_EQ(h.toString(), "cbd8a7b341bd9b025b1e906a48ae1d19");
+  h = settings::hash("The quick brown fox jumps over the lazy dog", 43);
+  ASSERT_EQ(h.toString(), "e34bbc7bbc071b6c7a433ca9c49a9347");
+}
+
+TEST(Hash, canonical) {
+  nlohmann::json a;
+  settings::initString("{\"b\": [1, 2.0, \"x\"], \"a\": {\"z\": null}}", &a);
+  nlohmann::json b;
+  settings::initString(
+      "{\n  \"a\": {\"z\": null},\n  \"b\": [1.0, 2, \"x\"]\n}", &b);
+  ASSERT_EQ(settings::hash(a), settings::hash(b));
+
+  nlohmann::json c = b;
+  c["b"][2] = "y";
+  ASSERT_NE(settings::hash(a), settings::hash(c));
+
+  // Numbers are normalized by value.
+  ASSERT_EQ(settings::hash(nlohmann::json(3)),
+            settings::hash(nlohmann::json(3u)));
+  ASSERT_EQ(settings::hash(nlohmann::json(-4)),
+            settings::hash(nlohmann::json(-4.0)));
+  ASSERT_EQ(settings::hash(nlohmann::json(0.0)),
+            settings::hash(nlohmann::json(-0.0)));
+  ASSERT_NE(settings::hash(nlohmann::json(3)),
+            settings::hash(nlohmann::json(3.5)));
+  ASSERT_NE(settings::hash(nlohmann::json(1)),
+            settings::hash(nlohmann::json(true)));
+  ASSERT_NE(settings::hash(nlohmann::json("1")),
+            settings::hash(nlohmann::json(1)));
+
+  // Structure matters.
+  ASSERT_NE(settings::hash(nlohmann::json::parse("[[1], 2]")),
+            settings::hash(nlohmann::json::parse("[1, [2]]")));
+  ASSERT_NE(settings::hash(nlohmann::json::parse("{\"a\": \"b\"}")),
+            settings::hash(nlohmann::json::parse("[\"a\", \"b\"]")));
+}
+
+TEST(Hash, stable) {
+  nlohmann::json settings;
+  settings::initString("{\"name\": \"Nic\", \"kids\": [3, 0], \"w\": 2.5}",
+                       &settings);
+  ASSERT_EQ(settings::hash(settings).toString(),
+            "0c0460078ab6f939c8c0abd7831eb218");
+}
+
+TEST(Hash, cache) {
+  nlohmann::json settings;
+  settings::initString(
+      "{\"a\": {\"b\": [{\"c\": 1}, {\"d\": [2, 3]}], \"e\": {\"f\": 4}},"
+      " \"g\": [5, 6, {\"h\": 7}]}",
+      &settings);
+
+  settings::HashCache cache;
+  ASSERT_EQ(cache.hash(settings), settings::hash(settings));
+  u64 size = cache.size();
+  ASSERT_EQ(size, 9u);
+  ASSERT_EQ(cache.hash(settings), settings::hash(settings));
+  ASSERT_EQ(cache.size(), size);
+
+  // Modifies an object value.
+  settings["a"]["e"]["f"] = 40;
+  cache.invalidate(settings, "/a/e/f");
+  ASSERT_EQ(cache.size(), size - 3);
+  ASSERT_EQ(cache.hash(settings), settings::hash(settings));
+
+  // Adds to an array.
+  settings["a"]["b"].push_back(nlohmann::json::parse("{\"i\": [8]}"));
+  cache.invalidate(settings, "/a/b/2");
+  ASSERT_EQ(cache.hash(settings), settings::hash(settings));
+
+  // Replaces a subtree.
+  settings["g"] = nlohmann::json::parse("{\"x\": [1, 2, 3]}");
+  cache.invalidate(settings, "/g");
+  ASSERT_EQ(cache.hash(settings), settings::hash(settings));
+
+  // Removes a value.
+  settings["a"].erase("e");
+  cache.invalidate(settings, "/a/e");
+  ASSERT_EQ(cache.hash(settings), settings::hash(settings));
+
+  cache.clear();
+  ASSERT_EQ(cache.size(), 0u);
+}
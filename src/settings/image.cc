@@ -0,0 +1,608 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/image.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+#include "settings/hash.h"
+#include "settings/settings.h"
+
+namespace settings {
+
+// The image starts with this header (4 words):
+//  magic, image size, root offset, number of nodes
+// Each node starts with a header word holding its kind in the low 8 bits and
+// its length (string bytes or container elements) in the upper 56 bits:
+//  null, false, true: header only
+//  int, uint, float: header, value
+//  string: header, bytes padded to a word boundary
+//  array: header, element offsets
+//  object: header, (key string offset, value offset) pairs sorted by key
+//  binary: header, subtype (bit 8 set if present), bytes padded
+static const u64 MAGIC = 0x3130474d49544553ull;  // "SETIMG01"
+static const u64 HEADER_BYTES = 32;
+
+enum class Kind : u8 {
+  kNull = 0,
+  kFalse = 1,
+  kTrue = 2,
+  kInt = 3,
+  kUint = 4,
+  kFloat = 5,
+  kString = 6,
+  kArray = 7,
+  kObject = 8,
+  kBinary = 9
+};
+
+static inline u64 load64(const u8* _ptr) {
+  u64 v = 0;
+  for (s32 b = 7; b >= 0; b--) {
+    v = (v << 8) | _ptr[b];
+  }
+  return v;
+}
+
+static inline void store64(u64 _val, u8* _ptr) {
+  for (u32 b = 0; b < 8; b++) {
+    _ptr[b] = static_cast<u8>(_val >> (b * 8));
+  }
+}
+
+static inline u64 makeHeader(Kind _kind, u64 _length) {
+  return static_cast<u64>(_kind) | (_length << 8);
+}
+
+// Splits a JSON pointer into its unescaped reference tokens.
+static std::vector<std::string> pointerTokens(const std::string& _pointer);
+
+// Builds an image in post order, interning each encoded node.
+class Builder {
+ public:
+  explicit Builder(std::vector<u8>* _storage) : storage_(_storage), nodes_(0) {
+    storage_->resize(HEADER_BYTES, 0);
+  }
+
+  u64 add(const nlohmann::json& _node) {
+    nodes_++;
+    std::vector<u8> enc;
+    switch (_node.type()) {
+      case nlohmann::json::value_t::null:
+        word(&enc, makeHeader(Kind::kNull, 0));
+        break;
+
+      case nlohmann::json::value_t::boolean:
+        word(&enc, makeHeader(_node.get<bool>() ? Kind::kTrue : Kind::kFalse,
+                              0));
+        break;
+
+      case nlohmann::json::value_t::number_integer:
+        word(&enc, makeHeader(Kind::kInt, 0));
+        word(&enc, static_cast<u64>(_node.get<s64>()));
+        break;
+
+      case nlohmann::json::value_t::number_unsigned:
+        word(&enc, makeHeader(Kind::kUint, 0));
+        word(&enc, _node.get<u64>());
+        break;
+
+      case nlohmann::json::value_t::number_float: {
+        f64 val = _node.get<f64>();
+        u64 bits;
+        memcpy(&bits, &val, sizeof(bits));
+        word(&enc, makeHeader(Kind::kFloat, 0));
+        word(&enc, bits);
+        break;
+      }
+
+      case nlohmann::json::value_t::string:
+        return addString(_node.get_ref<const std::string&>());
+
+      case nlohmann::json::value_t::binary: {
+        const nlohmann::json::binary_t& bin = _node.get_binary();
+        word(&enc, makeHeader(Kind::kBinary, bin.size()));
+        word(&enc, bin.has_subtype() ? (0x100 | bin.subtype()) : 0);
+        bytes(&enc, bin.data(), bin.size());
+        break;
+      }
+
+      case nlohmann::json::value_t::array: {
+        std::vector<u64> refs;
+        refs.reserve(_node.size());
+        for (const nlohmann::json& child : _node) {
+          refs.push_back(add(child));
+        }
+        word(&enc, makeHeader(Kind::kArray, refs.size()));
+        for (u64 ref : refs) {
+          word(&enc, ref);
+        }
+        break;
+      }
+
+      case nlohmann::json::value_t::object: {
+        std::vector<u64> refs;
+        refs.reserve(_node.size() * 2);
+        for (auto it = _node.cbegin(); it != _node.cend(); ++it) {
+          refs.push_back(addString(it.key()));
+          refs.push_back(add(it.value()));
+        }
+        word(&enc, makeHeader(Kind::kObject, _node.size()));
+        for (u64 ref : refs) {
+          word(&enc, ref);
+        }
+        break;
+      }
+
+      default:
+        fprintf(stderr, "Settings error: can't store discarded values\n");
+        exit(-1);
+    }
+    return intern(enc);
+  }
+
+  u64 nodes() const {
+    return nodes_;
+  }
+
+  u64 uniqueNodes() const {
+    return interned_.size();
+  }
+
+ private:
+  struct Hasher {
+    size_t operator()(const Hash128& _h) const {
+      return static_cast<size_t>(_h.low);
+    }
+  };
+
+  u64 addString(const std::string& _str) {
+    std::vector<u8> enc;
+    word(&enc, makeHeader(Kind::kString, _str.size()));
+    bytes(&enc, _str.data(), _str.size());
+    return intern(enc);
+  }
+
+  static void word(std::vector<u8>* _enc, u64 _val) {
+    u64 pos = _enc->size();
+    _enc->resize(pos + 8);
+    store64(_val, _enc->data() + pos);
+  }
+
+  static void bytes(std::vector<u8>* _enc, const void* _data, u64 _size) {
+    u64 pos = _enc->size();
+    _enc->resize(pos + ((_size + 7) / 8) * 8, 0);
+    if (_size > 0) {
+      memcpy(_enc->data() + pos, _data, _size);
+    }
+  }
+
+  u64 intern(const std::vector<u8>& _enc) {
+    Hash128 h = hash(_enc.data(), _enc.size());
+    auto it = interned_.find(h);
+    if (it != interned_.end() &&
+        storage_->size() - it->second >= _enc.size() &&
+        memcmp(storage_->data() + it->second, _enc.data(), _enc.size()) ==
+            0) {
+      return it->second;
+    }
+    u64 offset = storage_->size();
+    storage_->insert(storage_->end(), _enc.begin(), _enc.end());
+    if (it == interned_.end()) {
+      interned_[h] = offset;
+    }
+    return offset;
+  }
+
+  std::vector<u8>* storage_;
+  std::unordered_map<Hash128, u64, Hasher> interned_;
+  u64 nodes_;
+};
+
+/*** public functions below here ***/
+
+Image::Image(const nlohmann::json& _settings) {
+  Builder builder(&storage_);
+  u64 root = builder.add(_settings);
+  store64(MAGIC, storage_.data());
+  store64(storage_.size(), storage_.data() + 8);
+  store64(root, storage_.data() + 16);
+  store64(builder.uniqueNodes(), storage_.data() + 24);
+  storage_.shrink_to_fit();
+  data_ = storage_.data();
+  size_ = storage_.size();
+
+  stats_.nodes = builder.nodes();
+  stats_.unique_nodes = builder.uniqueNodes();
+  stats_.json_bytes = heapBytes(_settings) + sizeof(nlohmann::json);
+  stats_.image_bytes = size_;
+}
+
+Image::Image(const void* _data, u64 _size)
+    : data_(reinterpret_cast<const u8*>(_data)), size_(_size), stats_() {
+  if (_size < HEADER_BYTES || load64(data_) != MAGIC ||
+      load64(data_ + 8) != _size || load64(data_ + 16) >= _size ||
+      (reinterpret_cast<uintptr_t>(_data) % 8) != 0) {
+    fprintf(stderr, "Settings error: invalid settings image\n");
+    exit(-1);
+  }
+}
+
+Image::~Image() {}
+
+const void* Image::data() const {
+  return data_;
+}
+
+u64 Image::size() const {
+  return size_;
+}
+
+ImageNode Image::root() const {
+  return ImageNode(data_, load64(data_ + 16));
+}
+
+const Image::Stats& Image::stats() const {
+  return stats_;
+}
+
+std::string Image::report() const {
+  char buf[256];
+  f64 ratio = stats_.image_bytes > 0 ? static_cast<f64>(stats_.json_bytes) /
+                                           static_cast<f64>(stats_.image_bytes)
+                                     : 0.0;
+  snprintf(buf, sizeof(buf),
+           "nodes: %llu (%llu unique)\n"
+           "json bytes: %llu\n"
+           "image bytes: %llu\n"
+           "saved bytes: %lld (%.2fx)\n",
+           static_cast<unsigned long long>(stats_.nodes),         // NOLINT
+           static_cast<unsigned long long>(stats_.unique_nodes),  // NOLINT
+           static_cast<unsigned long long>(stats_.json_bytes),    // NOLINT
+           static_cast<unsigned long long>(stats_.image_bytes),   // NOLINT
+           static_cast<long long>(stats_.json_bytes) -            // NOLINT
+               static_cast<long long>(stats_.image_bytes),        // NOLINT
+           ratio);
+  return std::string(buf);
+}
+
+nlohmann::json::value_t ImageNode::type() const {
+  switch (static_cast<Kind>(header() & 0xff)) {
+    case Kind::kNull:
+      return nlohmann::json::value_t::null;
+    case Kind::kFalse:
+    case Kind::kTrue:
+      return nlohmann::json::value_t::boolean;
+    case Kind::kInt:
+      return nlohmann::json::value_t::number_integer;
+    case Kind::kUint:
+      return nlohmann::json::value_t::number_unsigned;
+    case Kind::kFloat:
+      return nlohmann::json::value_t::number_float;
+    case Kind::kString:
+      return nlohmann::json::value_t::string;
+    case Kind::kArray:
+      return nlohmann::json::value_t::array;
+    case Kind::kObject:
+      return nlohmann::json::value_t::object;
+    case Kind::kBinary:
+      return nlohmann::json::value_t::binary;
+    default:
+      fprintf(stderr, "Settings error: corrupt settings image\n");
+      exit(-1);
+  }
+}
+
+bool ImageNode::isNull() const {
+  return type() == nlohmann::json::value_t::null;
+}
+
+bool ImageNode::isBool() const {
+  return type() == nlohmann::json::value_t::boolean;
+}
+
+bool ImageNode::isNumber() const {
+  Kind kind = static_cast<Kind>(header() & 0xff);
+  return kind == Kind::kInt || kind == Kind::kUint || kind == Kind::kFloat;
+}
+
+bool ImageNode::isString() const {
+  return type() == nlohmann::json::value_t::string;
+}
+
+bool ImageNode::isArray() const {
+  return type() == nlohmann::json::value_t::array;
+}
+
+bool ImageNode::isObject() const {
+  return type() == nlohmann::json::value_t::object;
+}
+
+bool ImageNode::isBinary() const {
+  return type() == nlohmann::json::value_t::binary;
+}
+
+u64 ImageNode::size() const {
+  switch (type()) {
+    case nlohmann::json::value_t::null:
+      return 0;
+    case nlohmann::json::value_t::array:
+    case nlohmann::json::value_t::object:
+      return header() >> 8;
+    default:
+      return 1;
+  }
+}
+
+bool ImageNode::contains(const std::string& _key) const {
+  if (!isObject()) {
+    return false;
+  }
+  // Binary search over the sorted keys.
+  u64 lo = 0;
+  u64 hi = header() >> 8;
+  while (lo < hi) {
+    u64 mid = lo + (hi - lo) / 2;
+    s32 cmp = key(mid).compare(_key);
+    if (cmp == 0) {
+      return true;
+    } else if (cmp < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return false;
+}
+
+ImageNode ImageNode::operator[](const std::string& _key) const {
+  if (isObject()) {
+    u64 lo = 0;
+    u64 hi = header() >> 8;
+    while (lo < hi) {
+      u64 mid = lo + (hi - lo) / 2;
+      s32 cmp = key(mid).compare(_key);
+      if (cmp == 0) {
+        return child(word(2 + mid * 2));
+      } else if (cmp < 0) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+  }
+  fprintf(stderr, "Settings error: key \"%s\" doesn't exist\n", _key.c_str());
+  exit(-1);
+}
+
+ImageNode ImageNode::operator[](u64 _index) const {
+  if (_index >= size() || !(isArray() || isObject())) {
+    fprintf(stderr, "Settings error: index %llu is out of range\n",
+            static_cast<unsigned long long>(_index));  // NOLINT
+    exit(-1);
+  }
+  if (isArray()) {
+    return child(word(1 + _index));
+  } else {
+    return child(word(2 + _index * 2));
+  }
+}
+
+std::string_view ImageNode::key(u64 _index) const {
+  if (!isObject() || _index >= size()) {
+    fprintf(stderr, "Settings error: key index %llu is out of range\n",
+            static_cast<unsigned long long>(_index));  // NOLINT
+    exit(-1);
+  }
+  return child(word(1 + _index * 2)).getString();
+}
+
+ImageNode ImageNode::at(const std::string& _pointer) const {
+  ImageNode node = *this;
+  for (const std::string& token : pointerTokens(_pointer)) {
+    if (node.isObject()) {
+      node = node[token];
+    } else if (node.isArray()) {
+      char* end;
+      u64 idx = strtoull(token.c_str(), &end, 10);
+      if (token.empty() || *end != '\0') {
+        fprintf(stderr, "Settings error: invalid array index \"%s\"\n",
+                token.c_str());
+        exit(-1);
+      }
+      node = node[idx];
+    } else {
+      fprintf(stderr, "Settings error: pointer \"%s\" doesn't exist\n",
+              _pointer.c_str());
+      exit(-1);
+    }
+  }
+  return node;
+}
+
+bool ImageNode::getBool() const {
+  if (!isBool()) {
+    fprintf(stderr, "Settings error: value isn't a bool\n");
+    exit(-1);
+  }
+  return static_cast<Kind>(header() & 0xff) == Kind::kTrue;
+}
+
+s64 ImageNode::getInt() const {
+  switch (static_cast<Kind>(header() & 0xff)) {
+    case Kind::kInt:
+    case Kind::kUint:
+      return static_cast<s64>(word(1));
+    case Kind::kFloat:
+      return static_cast<s64>(getFloat());
+    default:
+      fprintf(stderr, "Settings error: value isn't a number\n");
+      exit(-1);
+  }
+}
+
+u64 ImageNode::getUint() const {
+  return static_cast<u64>(getInt());
+}
+
+f64 ImageNode::getFloat() const {
+  switch (static_cast<Kind>(header() & 0xff)) {
+    case Kind::kInt:
+      return static_cast<f64>(static_cast<s64>(word(1)));
+    case Kind::kUint:
+      return static_cast<f64>(word(1));
+    case Kind::kFloat: {
+      u64 bits = word(1);
+      f64 val;
+      memcpy(&val, &bits, sizeof(val));
+      return val;
+    }
+    default:
+      fprintf(stderr, "Settings error: value isn't a number\n");
+      exit(-1);
+  }
+}
+
+std::string_view ImageNode::getString() const {
+  if (!isString()) {
+    fprintf(stderr, "Settings error: value isn't a string\n");
+    exit(-1);
+  }
+  return std::string_view(
+      reinterpret_cast<const char*>(base_ + offset_ + 8), header() >> 8);
+}
+
+std::string_view ImageNode::getBinary() const {
+  if (!isBinary()) {
+    fprintf(stderr, "Settings error: value isn't binary\n");
+    exit(-1);
+  }
+  return std::string_view(
+      reinterpret_cast<const char*>(base_ + offset_ + 16), header() >> 8);
+}
+
+s32 ImageNode::getSubtype() const {
+  if (!isBinary()) {
+    fprintf(stderr, "Settings error: value isn't binary\n");
+    exit(-1);
+  }
+  u64 subtype = word(1);
+  return (subtype & 0x100) ? static_cast<s32>(subtype & 0xff) : -1;
+}
+
+nlohmann::json ImageNode::toJson() const {
+  switch (static_cast<Kind>(header() & 0xff)) {
+    case Kind::kNull:
+      return nlohmann::json();
+    case Kind::kFalse:
+      return false;
+    case Kind::kTrue:
+      return true;
+    case Kind::kInt:
+      return static_cast<s64>(word(1));
+    case Kind::kUint:
+      return word(1);
+    case Kind::kFloat:
+      return getFloat();
+    case Kind::kString:
+      return std::string(getString());
+    case Kind::kArray: {
+      nlohmann::json arr = nlohmann::json::array();
+      u64 count = header() >> 8;
+      for (u64 idx = 0; idx < count; idx++) {
+        arr.push_back(child(word(1 + idx)).toJson());
+      }
+      return arr;
+    }
+    case Kind::kObject: {
+      nlohmann::json obj = nlohmann::json::object();
+      u64 count = header() >> 8;
+      for (u64 idx = 0; idx < count; idx++) {
+        obj[std::string(key(idx))] = child(word(2 + idx * 2)).toJson();
+      }
+      return obj;
+    }
+    case Kind::kBinary: {
+      const u8* begin = base_ + offset_ + 16;
+      std::vector<u8> bytes(begin, begin + (header() >> 8));
+      u64 subtype = word(1);
+      if (subtype & 0x100) {
+        return nlohmann::json::binary(std::move(bytes), subtype & 0xff);
+      } else {
+        return nlohmann::json::binary(std::move(bytes));
+      }
+    }
+    default:
+      fprintf(stderr, "Settings error: corrupt settings image\n");
+      exit(-1);
+  }
+}
+
+u64 ImageNode::offset() const {
+  return offset_;
+}
+
+ImageNode::ImageNode(const u8* _base, u64 _offset)
+    : base_(_base), offset_(_offset) {}
+
+u64 ImageNode::header() const {
+  return load64(base_ + offset_);
+}
+
+u64 ImageNode::word(u64 _index) const {
+  return load64(base_ + offset_ + _index * 8);
+}
+
+ImageNode ImageNode::child(u64 _ref) const {
+  return ImageNode(base_, _ref);
+}
+
+/*** static functions below here ***/
+
+static std::vector<std::string> pointerTokens(const std::string& _pointer) {
+  nlohmann::json::json_pointer ptr;
+  try {
+    ptr = nlohmann::json::json_pointer(_pointer);
+  } catch (nlohmann::json::parse_error& e) {
+    fprintf(stderr, "Settings error: invalid pointer \"%s\"\n%s\n",
+            _pointer.c_str(), e.what());
+    exit(-1);
+  }
+  std::vector<std::string> tokens;
+  for (; !ptr.empty(); ptr.pop_back()) {
+    tokens.push_back(ptr.back());
+  }
+  return std::vector<std::string>(tokens.rbegin(), tokens.rend());
+}
+
+}  // namespace settings
@@ -0,0 +1,152 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SETTINGS_IMAGE_H_
+#define SETTINGS_IMAGE_H_
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "prim/prim.h"
+
+namespace settings {
+
+class ImageNode;
+
+// This is a compact and immutable representation of resolved settings.
+// Identical subtrees (including object keys) are stored only once.
+// All values are little endian and all links are byte offsets from the start
+// of the image, so an image can be memory mapped, shared, or embedded as is.
+class Image {
+ public:
+  // These are statistics collected while building an image.
+  struct Stats {
+    u64 nodes;         // JSON nodes in the settings
+    u64 unique_nodes;  // nodes stored in the image
+    u64 json_bytes;    // estimated heap bytes of the nlohmann::json tree
+    u64 image_bytes;   // bytes of the image
+  };
+
+  // this builds an image from the settings, deduplicating identical subtrees
+  explicit Image(const nlohmann::json& _settings);
+
+  // this wraps an existing image (e.g., memory mapped). The data isn't copied
+  //  and must outlive this object.
+  //  error print and exit(-1) if the data isn't a valid image
+  Image(const void* _data, u64 _size);
+
+  ~Image();
+  Image(const Image&) = delete;
+  Image& operator=(const Image&) = delete;
+
+  // this returns the image bytes
+  const void* data() const;
+  u64 size() const;
+
+  // this returns the root of the settings
+  ImageNode root() const;
+
+  // this returns the build statistics (zeros for wrapped images)
+  const Stats& stats() const;
+
+  // this returns a human readable summary of the build statistics
+  std::string report() const;
+
+ private:
+  std::vector<u8> storage_;
+  const u8* data_;
+  u64 size_;
+  Stats stats_;
+};
+
+// This is a read-only cursor into an Image. It is cheap to copy and is valid
+// as long as the Image is.
+class ImageNode {
+ public:
+  // this returns the type using the nlohmann::json type names
+  nlohmann::json::value_t type() const;
+  bool isNull() const;
+  bool isBool() const;
+  bool isNumber() const;
+  bool isString() const;
+  bool isArray() const;
+  bool isObject() const;
+  bool isBinary() const;
+
+  // this returns the number of elements using nlohmann::json semantics
+  u64 size() const;
+
+  // object access. Accessing a missing key error prints and exit(-1).
+  bool contains(const std::string& _key) const;
+  ImageNode operator[](const std::string& _key) const;
+
+  // array access, or object member access in key order
+  ImageNode operator[](u64 _index) const;
+  std::string_view key(u64 _index) const;
+
+  // this accesses a descendant by JSON pointer (RFC 6901)
+  ImageNode at(const std::string& _pointer) const;
+
+  // value access. Type mismatches error print and exit(-1).
+  bool getBool() const;
+  s64 getInt() const;
+  u64 getUint() const;
+  f64 getFloat() const;
+  std::string_view getString() const;
+
+  // binary access. The subtype is -1 if the binary value has none.
+  //  type mismatches error print and exit(-1).
+  std::string_view getBinary() const;
+  s32 getSubtype() const;
+
+  // this converts the subtree back into nlohmann::json
+  nlohmann::json toJson() const;
+
+  // this returns the offset of the node within the image. Identical subtrees
+  //  have identical offsets.
+  u64 offset() const;
+
+ private:
+  friend class Image;
+  ImageNode(const u8* _base, u64 _offset);
+
+  u64 header() const;
+  u64 word(u64 _index) const;
+  ImageNode child(u64 _ref) const;
+
+  const u8* base_;
+  u64 offset_;
+};
+
+}  // namespace settings
+
+#endif  // SETTINGS_IMAGE_H_
@@ -0,0 +1,159 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/image.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+#include "settings/settings.h"
+
+const char* IMAGE_JSON =
+    "{\n"
+    "  \"name\": \"Nic\",\n"
+    "  \"age\": 30,\n"
+    "  \"height\": 1.85,\n"
+    "  \"debt\": -12,\n"
+    "  \"big\": 18446744073709551615,\n"
+    "  \"alive\": true,\n"
+    "  \"dead\": false,\n"
+    "  \"nothing\": null,\n"
+    "  \"empty\": {},\n"
+    "  \"none\": [],\n"
+    "  \"a/b\": \"slash\",\n"
+    "  \"kids\": [{\"name\": \"Gertrude\", \"age\": 3},\n"
+    "           {\"name\": \"Mildrid\", \"age\": 0}]\n"
+    "}\n";
+
+TEST(Image, roundtrip) {
+  nlohmann::json settings;
+  settings::initString(IMAGE_JSON, &settings);
+  settings::Image image(settings);
+  ASSERT_EQ(image.root().toJson(), settings);
+  ASSERT_EQ(settings::toString(image.root().toJson()),
+            settings::toString(settings));
+  ASSERT_EQ(image.size() % 8, 0u);
+  ASSERT_EQ(image.stats().nodes, 19u);
+}
+
+TEST(Image, access) {
+  nlohmann::json settings;
+  settings::initString(IMAGE_JSON, &settings);
+  settings::Image image(settings);
+  settings::ImageNode root = image.root();
+
+  ASSERT_TRUE(root.isObject());
+  ASSERT_EQ(root.size(), settings.size());
+  ASSERT_TRUE(root.contains("name"));
+  ASSERT_FALSE(root.contains("nope"));
+  ASSERT_EQ(root["name"].getString(), "Nic");
+  ASSERT_EQ(root["age"].getUint(), 30u);
+  ASSERT_EQ(root["age"].getFloat(), 30.0);
+  ASSERT_EQ(root["height"].getFloat(), 1.85);
+  ASSERT_EQ(root["debt"].getInt(), -12);
+  ASSERT_EQ(root["big"].getUint(), 18446744073709551615ull);
+  ASSERT_TRUE(root["alive"].getBool());
+  ASSERT_FALSE(root["dead"].getBool());
+  ASSERT_TRUE(root["nothing"].isNull());
+  ASSERT_EQ(root["nothing"].size(), 0u);
+  ASSERT_TRUE(root["empty"].isObject());
+  ASSERT_EQ(root["empty"].size(), 0u);
+  ASSERT_TRUE(root["none"].isArray());
+  ASSERT_EQ(root["none"].size(), 0u);
+  ASSERT_EQ(root["kids"][1]["name"].getString(), "Mildrid");
+  ASSERT_EQ(root.at("/kids/0/age").getUint(), 3u);
+  ASSERT_EQ(root.at("/a~1b").getString(), "slash");
+  ASSERT_EQ(root.at("").offset(), root.offset());
+
+  // Object members are in key order.
+  for (u64 idx = 1; idx < root.size(); idx++) {
+    ASSERT_LT(root.key(idx - 1), root.key(idx));
+  }
+  ASSERT_EQ(root.key(0), "a/b");
+  ASSERT_EQ(root[0].getString(), "slash");
+}
+
+TEST(Image, dedup) {
+  // Builds settings with many identical subtrees.
+  nlohmann::json router;
+  settings::initString(
+      "{\"ports\": [0, 1, 2, 3, 4, 5, 6, 7], \"latency\": 50,"
+      " \"buffers\": {\"size\": 1024, \"vcs\": 4}}",
+      &router);
+  nlohmann::json settings;
+  for (u32 r = 0; r < 64; r++) {
+    settings["routers"].push_back(router);
+  }
+  settings["copy"] = router;
+  settings["copy"]["latency"] = 51;
+
+  settings::Image image(settings);
+  ASSERT_EQ(image.root().toJson(), settings);
+
+  // All routers share a single subtree.
+  settings::ImageNode routers = image.root()["routers"];
+  for (u32 r = 1; r < 64; r++) {
+    ASSERT_EQ(routers[r].offset(), routers[0].offset());
+  }
+  ASSERT_NE(image.root()["copy"].offset(), routers[0].offset());
+  ASSERT_EQ(image.root()["copy"]["buffers"].offset(),
+            routers[0]["buffers"].offset());
+
+  const settings::Image::Stats& stats = image.stats();
+  ASSERT_GT(stats.nodes, 64u * 14u);
+  ASSERT_LT(stats.unique_nodes, 30u);
+  ASSERT_GT(stats.json_bytes, 10 * stats.image_bytes);
+  ASSERT_FALSE(image.report().empty());
+}
+
+TEST(Image, wrap) {
+  nlohmann::json settings;
+  settings::initString(IMAGE_JSON, &settings);
+  settings::Image image(settings);
+
+  std::vector<u64> copy(image.size() / 8);
+  memcpy(copy.data(), image.data(), image.size());
+  settings::Image wrapped(copy.data(), image.size());
+  ASSERT_EQ(wrapped.root().toJson(), settings);
+  ASSERT_EQ(wrapped.stats().nodes, 0u);
+}
+
+TEST(Image, heapBytes) {
+  nlohmann::json small;
+  settings::initString("{\"a\": 1}", &small);
+  nlohmann::json large;
+  settings::initString(IMAGE_JSON, &large);
+  ASSERT_GT(settings::heapBytes(small), 0u);
+  ASSERT_GT(settings::heapBytes(large), settings::heapBytes(small));
+  ASSERT_EQ(settings::heapBytes(nlohmann::json(5)), 0u);
+}
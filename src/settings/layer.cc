@@ -0,0 +1,223 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/layer.h"
+
+#include <string>
+#include <utility>
+
+#include "settings/settings.h"
+
+namespace settings {
+
+// Returns the normalized form of a JSON pointer.
+//  throws settings::Error if the pointer is invalid
+static std::string normalize(const std::string& _pointer);
+
+// Returns the parent of a normalized pointer. The root has no parent.
+static std::string parentPointer(const std::string& _pointer);
+
+/*** public functions below here ***/
+
+Layer::Layer(const nlohmann::json& _base) : base_(&_base), parent_(nullptr) {}
+
+Layer::Layer(const Layer* _parent) : base_(nullptr), parent_(_parent) {}
+
+const Layer* Layer::parent() const {
+  return parent_;
+}
+
+u64 Layer::size() const {
+  return overrides_.size();
+}
+
+void Layer::set(const std::string& _pointer, nlohmann::json _value) {
+  std::string pointer = normalize(_pointer);
+
+  // Resolves "-" tokens, which append to the array below them, to indices.
+  for (u64 pos = pointer.find("/-"); pos != std::string::npos;
+       pos = pointer.find("/-", pos + 1)) {
+    if (pos + 2 < pointer.size() && pointer[pos + 2] != '/') {
+      continue;
+    }
+    nlohmann::json array;
+    if (!resolve(pointer.substr(0, pos), &array) || array.is_null()) {
+      pointer.replace(pos + 1, 1, "0");
+    } else if (array.is_array()) {
+      pointer.replace(pos + 1, 1, std::to_string(array.size()));
+    }
+  }
+
+  // Modifies an existing override that holds the pointer.
+  for (std::string prefix = pointer;; prefix = parentPointer(prefix)) {
+    auto it = overrides_.find(prefix);
+    if (it != overrides_.end()) {
+      if (prefix.size() == pointer.size()) {
+        it->second = std::move(_value);
+      } else {
+        try {
+          it->second[nlohmann::json::json_pointer(
+              pointer.substr(prefix.size()))] = std::move(_value);
+        } catch (nlohmann::json::exception& e) {
+          throw Error("override \"" + pointer + "\" caused a failure:\n" +
+                      e.what());
+        }
+      }
+      return;
+    }
+    if (prefix.empty()) {
+      break;
+    }
+  }
+
+  // Replaces the overrides within the subtree, which sort between "<pointer>/"
+  // and "<pointer>0" ('0' follows '/').
+  overrides_.erase(overrides_.lower_bound(pointer + '/'),
+                   overrides_.lower_bound(pointer + '0'));
+  overrides_[pointer] = std::move(_value);
+}
+
+void Layer::update(const std::vector<std::string>& _updates) {
+  for (const std::string& update : _updates) {
+    std::string pointer;
+    nlohmann::json value;
+    parseUpdate(update, &pointer, &value);
+    set(pointer, std::move(value));
+  }
+}
+
+bool Layer::contains(const std::string& _pointer) const {
+  std::string pointer = normalize(_pointer);
+  for (const Layer* layer = this; layer != nullptr; layer = layer->parent_) {
+    // Overrides that hold the pointer decide.
+    for (std::string prefix = pointer;; prefix = parentPointer(prefix)) {
+      auto it = layer->overrides_.find(prefix);
+      if (it != layer->overrides_.end()) {
+        return it->second.contains(
+            nlohmann::json::json_pointer(pointer.substr(prefix.size())));
+      }
+      if (prefix.empty()) {
+        break;
+      }
+    }
+
+    // Overrides within the subtree create it.
+    auto it = layer->overrides_.lower_bound(pointer + '/');
+    if (it != layer->overrides_.end() &&
+        it->first.compare(0, pointer.size() + 1, pointer + '/') == 0) {
+      return true;
+    }
+
+    if (layer->base_ != nullptr) {
+      return layer->base_->contains(nlohmann::json::json_pointer(pointer));
+    }
+  }
+  return false;
+}
+
+nlohmann::json Layer::get(const std::string& _pointer) const {
+  nlohmann::json value;
+  if (!resolve(normalize(_pointer), &value)) {
+    throw Error("pointer \"" + _pointer + "\" doesn't exist");
+  }
+  return value;
+}
+
+nlohmann::json Layer::flatten() const {
+  return get("");
+}
+
+/*** private functions below here ***/
+
+bool Layer::resolve(const std::string& _pointer, nlohmann::json* _value) const {
+  // An override that holds the pointer hides the layers below.
+  for (std::string prefix = _pointer;; prefix = parentPointer(prefix)) {
+    auto it = overrides_.find(prefix);
+    if (it != overrides_.end()) {
+      nlohmann::json::json_pointer rel(_pointer.substr(prefix.size()));
+      if (!it->second.contains(rel)) {
+        return false;
+      }
+      *_value = it->second.at(rel);
+      return true;
+    }
+    if (prefix.empty()) {
+      break;
+    }
+  }
+
+  // Resolves the layers below.
+  bool found;
+  if (parent_ != nullptr) {
+    found = parent_->resolve(_pointer, _value);
+  } else {
+    nlohmann::json::json_pointer ptr(_pointer);
+    found = base_->contains(ptr);
+    if (found) {
+      *_value = base_->at(ptr);
+    }
+  }
+
+  // Applies the overrides within the subtree.
+  std::string children = _pointer + '/';
+  for (auto it = overrides_.lower_bound(children);
+       it != overrides_.end() &&
+       it->first.compare(0, children.size(), children) == 0;
+       ++it) {
+    if (!found) {
+      *_value = nlohmann::json();
+      found = true;
+    }
+    try {
+      (*_value)[nlohmann::json::json_pointer(
+          it->first.substr(_pointer.size()))] = it->second;
+    } catch (nlohmann::json::exception& e) {
+      throw Error("override \"" + it->first + "\" caused a failure:\n" +
+                  e.what());
+    }
+  }
+  return found;
+}
+
+/*** static functions below here ***/
+
+static std::string normalize(const std::string& _pointer) {
+  try {
+    return nlohmann::json::json_pointer(_pointer).to_string();
+  } catch (nlohmann::json::exception& e) {
+    throw Error("invalid pointer \"" + _pointer + "\":\n" + e.what());
+  }
+}
+
+static std::string parentPointer(const std::string& _pointer) {
+  return _pointer.substr(0, _pointer.find_last_of('/'));
+}
+
+}  // namespace settings
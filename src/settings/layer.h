@@ -0,0 +1,103 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SETTINGS_LAYER_H_
+#define SETTINGS_LAYER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "prim/prim.h"
+
+namespace settings {
+
+// This is a view of settings with override precedence. The bottom layer wraps
+// immutable base settings and each layer above it holds a sparse set of
+// overrides keyed by JSON pointer. Lookups resolve from the top layer down and
+// creating a layer costs O(overrides), not O(settings).
+//
+// Overrides within a layer never overlap: overriding a value inside an
+// overridden subtree modifies that override, and overriding a subtree drops
+// the overrides inside it. Layers aren't thread safe to modify, but any
+// number of threads may read layers that aren't being modified.
+class Layer {
+ public:
+  // this creates the bottom layer. The settings aren't copied and must not be
+  //  modified while this object exists.
+  explicit Layer(const nlohmann::json& _base);
+
+  // this creates an empty layer on top of the parent. The parent must not be
+  //  modified while this object exists.
+  explicit Layer(const Layer* _parent);
+
+  // this returns the parent layer, nullptr for the bottom layer
+  const Layer* parent() const;
+
+  // this returns the number of overrides in this layer
+  u64 size() const;
+
+  // this overrides the value at the pointer. A "-" token appends to the array
+  //  it indexes, which costs resolving that array. The parent isn't checked
+  //  against the layers below, so an override it can't hold fails when
+  //  resolved.
+  //  throws settings::Error if the pointer is invalid
+  void set(const std::string& _pointer, nlohmann::json _value);
+
+  // this applies settings updates (see commandLine()) as overrides
+  //  throws settings::Error upon failure (see settings::parseUpdate())
+  void update(const std::vector<std::string>& _updates);
+
+  // this returns true if a value exists at the pointer
+  //  throws settings::Error if the pointer is invalid
+  bool contains(const std::string& _pointer) const;
+
+  // this returns the value at the pointer with all overrides applied. The
+  //  cost is proportional to the size of the value.
+  //  throws settings::Error if the pointer is invalid or doesn't exist, or if
+  //  an override can't be applied
+  nlohmann::json get(const std::string& _pointer) const;
+
+  // this returns the settings with all overrides applied
+  //  throws settings::Error if an override can't be applied
+  nlohmann::json flatten() const;
+
+ private:
+  bool resolve(const std::string& _pointer, nlohmann::json* _value) const;
+
+  const nlohmann::json* base_;
+  const Layer* parent_;
+  std::map<std::string, nlohmann::json> overrides_;  // keyed by pointer
+};
+
+}  // namespace settings
+
+#endif  // SETTINGS_LAYER_H_
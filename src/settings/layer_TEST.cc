@@ -0,0 +1,132 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/layer.h"
+
+#include <cassert>
+#include <cstdio>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+#include "settings/settings.h"
+
+TEST(Layer, precedence) {
+  nlohmann::json base = nlohmann::json::parse(
+      "{\"a\": {\"b\": 1, \"c\": [1, 2, 3]}, \"d\": \"base\"}");
+  settings::Layer site(base);
+  ASSERT_EQ(site.flatten(), base);
+
+  settings::Layer experiment(&site);
+  experiment.set("/a/b", 2);
+  experiment.set("/e/f", true);
+  ASSERT_EQ(experiment.size(), 2u);
+
+  settings::Layer run(&experiment);
+  run.set("/a/c/1", 20);
+  run.set("/d", "run");
+
+  // Lookups resolve from the top down.
+  ASSERT_EQ(run.get("/a/b").get<u64>(), 2u);
+  ASSERT_EQ(run.get("/a/c"), nlohmann::json::parse("[1, 20, 3]"));
+  ASSERT_EQ(run.get("/d").get<std::string>(), "run");
+  ASSERT_EQ(run.get("/e"), nlohmann::json::parse("{\"f\": true}"));
+  ASSERT_EQ(experiment.get("/d").get<std::string>(), "base");
+  ASSERT_TRUE(run.contains("/e/f"));
+  ASSERT_TRUE(run.contains("/a/c/2"));
+  ASSERT_FALSE(run.contains("/a/c/3"));
+  ASSERT_FALSE(run.contains("/x"));
+  ASSERT_THROW(run.get("/x"), settings::Error);
+  ASSERT_EQ(run.flatten(), nlohmann::json::parse(
+                               "{\"a\": {\"b\": 2, \"c\": [1, 20, 3]},"
+                               " \"d\": \"run\", \"e\": {\"f\": true}}"));
+
+  // The base and lower layers are unchanged.
+  ASSERT_EQ(site.flatten(), base);
+  ASSERT_EQ(base["a"]["b"].get<u64>(), 1u);
+
+  // Overriding a subtree hides everything below it.
+  run.set("/a", nlohmann::json::parse("{\"z\": 0}"));
+  ASSERT_EQ(run.size(), 2u);
+  ASSERT_EQ(run.get("/a"), nlohmann::json::parse("{\"z\": 0}"));
+  ASSERT_FALSE(run.contains("/a/b"));
+
+  // Overriding inside an override modifies it.
+  run.set("/a/y", 1);
+  ASSERT_EQ(run.size(), 2u);
+  ASSERT_EQ(run.get("/a"), nlohmann::json::parse("{\"y\": 1, \"z\": 0}"));
+
+  // Conflicting overrides fail when resolved.
+  settings::Layer bad(&site);
+  bad.set("/d/x", 1);
+  ASSERT_THROW(bad.flatten(), settings::Error);
+  ASSERT_THROW(bad.set("bad", 1), settings::Error);
+}
+
+TEST(Layer, update) {
+  const char* filename = "TEST_settings.json";
+  FILE* fp = fopen(filename, "w");
+  assert(fp != NULL);
+  fprintf(fp, "%s", "{\"x\": 5}");
+  fclose(fp);
+
+  nlohmann::json base = nlohmann::json::parse(
+      "{\"a\": 1, \"b\": [0, 0], \"c\": {}}");
+  settings::Layer layer(base);
+  settings::Layer run(&layer);
+  run.update({"/a=uint=2", "/b=float=[1.5,2.5]",
+              std::string("/c/d=file=") + filename,
+              "/e=uint=$%(range(0,4))%$"});
+  ASSERT_EQ(run.flatten(), nlohmann::json::parse(
+                               "{\"a\": 2, \"b\": [1.5, 2.5],"
+                               " \"c\": {\"d\": {\"x\": 5}},"
+                               " \"e\": [0, 1, 2, 3]}"));
+  ASSERT_THROW(run.update({"/a=ref=/b"}), settings::Error);
+
+  // Appends resolve against the layers below.
+  settings::Layer append(&run);
+  append.update({"/b/-=int=5", "/b/-=int=6", "/f/-/g=int=7", "/c/-=int=8"});
+  ASSERT_EQ(append.get("/b"), nlohmann::json::parse("[1.5, 2.5, 5, 6]"));
+  ASSERT_EQ(append.get("/f"), nlohmann::json::parse("[{\"g\": 7}]"));
+  ASSERT_EQ(append.get("/c/-").get<s64>(), 8);
+  ASSERT_EQ(run.get("/b"), nlohmann::json::parse("[1.5, 2.5]"));
+  ASSERT_THROW(run.update({"/a=int=x"}), settings::Error);
+
+  std::string pointer;
+  nlohmann::json value;
+  settings::parseUpdate("/a/0=int=-3", &pointer, &value);
+  ASSERT_EQ(pointer, "/a/0");
+  ASSERT_EQ(value.get<s64>(), -3);
+  settings::parseUpdate("/a/-=int=4", &pointer, &value);
+  ASSERT_EQ(pointer, "/a/-");
+  ASSERT_EQ(value.get<s64>(), 4);
+
+  assert(remove(filename) == 0);
+}
@@ -0,0 +1,381 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/profile.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+
+#include "settings/hash.h"
+
+namespace settings {
+
+// The nlohmann::json value_t enumeration has this many values.
+static const u32 NUM_TYPES = 10;
+
+namespace {
+
+struct HashHasher {
+  size_t operator()(const Hash128& _h) const {
+    return static_cast<size_t>(_h.low);
+  }
+};
+
+struct Group {
+  const nlohmann::json* first;
+  u64 copies;
+  u64 bytes;
+  Hash128 parent;
+  bool has_parent;
+};
+
+struct Result {
+  Hash128 hash;
+  u64 bytes;
+  u64 nodes;
+};
+
+struct Entry {
+  u64 bytes;
+  u64 nodes;
+  const nlohmann::json* node;
+
+  bool operator>(const Entry& _other) const {
+    return bytes > _other.bytes;
+  }
+};
+
+// Returns the name of a nlohmann::json type.
+static std::string typeName(nlohmann::json::value_t _type) {
+  switch (_type) {
+    case nlohmann::json::value_t::number_integer:
+      return "integer";
+    case nlohmann::json::value_t::number_unsigned:
+      return "unsigned";
+    case nlohmann::json::value_t::number_float:
+      return "float";
+    default:
+      return nlohmann::json(_type).type_name();
+  }
+}
+
+// This holds the state of a profile traversal. Nodes are identified by address
+// during the traversal and their paths are only resolved at the end.
+class Profiler {
+ public:
+  Profiler(u32 _top, Profile* _profile)
+      : top_(_top), profile_(_profile), dedup_savings_(0) {
+    for (u32 t = 0; t < NUM_TYPES; t++) {
+      type_nodes_[t] = 0;
+      type_bytes_[t] = 0;
+    }
+  }
+
+  void addOrigin(const nlohmann::json* _node, const std::string& _source) {
+    auto it = source_index_.find(_source);
+    u64 index;
+    if (it == source_index_.end()) {
+      index = sources_.size();
+      source_index_[_source] = index;
+      sources_.push_back({_source, 0, 0, 0});
+    } else {
+      index = it->second;
+    }
+    sources_.at(index).subtrees++;
+    origins_[_node] = index;
+  }
+
+  Result visit(const nlohmann::json& _node, u64 _source, bool _is_root) {
+    auto origin = origins_.find(&_node);
+    if (origin != origins_.end()) {
+      _source = origin->second;
+    }
+
+    u64 own = heapBytes(_node, false);
+    Result res = {{0, 0}, own, 1};
+    if (_node.is_object() || _node.is_array()) {
+      // Merkle style hash over the key and child hashes.
+      std::vector<u64> words;
+      words.reserve(2 + _node.size() * 4);
+      words.push_back(static_cast<u64>(_node.type()));
+      words.push_back(_node.size());
+      std::vector<std::pair<const nlohmann::json*, Hash128>> children;
+      children.reserve(_node.size());
+      for (auto it = _node.cbegin(); it != _node.cend(); ++it) {
+        if (_node.is_object()) {
+          const std::string& key = it.key();
+          Hash128 kh = hash(key.data(), key.size());
+          words.push_back(kh.high);
+          words.push_back(kh.low);
+        }
+        Result child = visit(*it, _source, false);
+        words.push_back(child.hash.high);
+        words.push_back(child.hash.low);
+        res.bytes += child.bytes;
+        res.nodes += child.nodes;
+        children.push_back({&*it, child.hash});
+      }
+      res.hash = hash(words.data(), words.size() * sizeof(u64));
+
+      // Marks the parent of the groups first seen here.
+      for (const auto& child : children) {
+        auto group = groups_.find(child.second);
+        if (group != groups_.end() && group->second.first == child.first) {
+          group->second.parent = res.hash;
+          group->second.has_parent = true;
+        }
+      }
+    } else {
+      res.hash = settings::hash(_node);
+    }
+
+    // Tracks duplicates of everything that holds heap memory.
+    if (res.bytes > 0) {
+      auto group = groups_.find(res.hash);
+      if (group == groups_.end()) {
+        groups_[res.hash] = {&_node, 1, res.bytes, {0, 0}, false};
+      } else {
+        group->second.copies++;
+        dedup_savings_ += own;
+      }
+    }
+
+    // Tracks the largest subtrees.
+    if (!_is_root && top_ > 0) {
+      largest_.push({res.bytes, res.nodes, &_node});
+      if (largest_.size() > top_) {
+        largest_.pop();
+      }
+    }
+
+    u32 type = static_cast<u32>(_node.type());
+    type_nodes_[type]++;
+    type_bytes_[type] += own;
+    sources_.at(_source).bytes += own;
+    sources_.at(_source).nodes++;
+    return res;
+  }
+
+  void finish(const nlohmann::json& _root, const Result& _result) {
+    profile_->bytes = _result.bytes;
+    profile_->nodes = _result.nodes;
+    profile_->dedup_savings = dedup_savings_;
+
+    for (u32 t = 0; t < NUM_TYPES; t++) {
+      if (type_nodes_[t] > 0) {
+        std::string name = typeName(static_cast<nlohmann::json::value_t>(t));
+        profile_->type_nodes[name] = type_nodes_[t];
+        profile_->type_bytes[name] = type_bytes_[t];
+      }
+    }
+
+    // Chooses the duplicates to report.
+    std::vector<const Group*> dups;
+    for (const auto& group : groups_) {
+      const Group& g = group.second;
+      if (g.copies < 2) {
+        continue;
+      }
+      if (g.has_parent) {
+        auto parent = groups_.find(g.parent);
+        if (parent != groups_.end() && parent->second.copies == g.copies) {
+          continue;
+        }
+      }
+      dups.push_back(&g);
+    }
+    std::sort(dups.begin(), dups.end(), [](const Group* _a, const Group* _b) {
+      return (_a->copies - 1) * _a->bytes > (_b->copies - 1) * _b->bytes;
+    });
+    if (dups.size() > top_) {
+      dups.resize(top_);
+    }
+
+    // Resolves the paths of the reported nodes.
+    std::unordered_map<const nlohmann::json*, std::string> paths;
+    std::vector<Entry> largest;
+    while (!largest_.empty()) {
+      largest.push_back(largest_.top());
+      paths[largest_.top().node] = "";
+      largest_.pop();
+    }
+    std::reverse(largest.begin(), largest.end());
+    for (const Group* g : dups) {
+      paths[g->first] = "";
+    }
+    std::string path;
+    u64 remaining = paths.size();
+    resolvePaths(_root, &path, &paths, &remaining);
+
+    for (const Entry& entry : largest) {
+      profile_->largest.push_back(
+          {paths.at(entry.node), entry.bytes, entry.nodes});
+    }
+    for (const Group* g : dups) {
+      profile_->duplicates.push_back({paths.at(g->first), g->copies, g->bytes,
+                                      (g->copies - 1) * g->bytes});
+    }
+
+    profile_->sources = sources_;
+    std::stable_sort(profile_->sources.begin(), profile_->sources.end(),
+                     [](const Profile::Source& _a, const Profile::Source& _b) {
+                       return _a.bytes > _b.bytes;
+                     });
+  }
+
+ private:
+  void resolvePaths(
+      const nlohmann::json& _node, std::string* _path,
+      std::unordered_map<const nlohmann::json*, std::string>* _paths,
+      u64* _remaining) {
+    auto it = _paths->find(&_node);
+    if (it != _paths->end()) {
+      it->second = *_path;
+      (*_remaining)--;
+    }
+    if (*_remaining == 0 || !(_node.is_object() || _node.is_array())) {
+      return;
+    }
+    u64 idx = 0;
+    for (auto child = _node.cbegin(); child != _node.cend(); ++child, idx++) {
+      u64 size = _path->size();
+      _path->push_back('/');
+      if (_node.is_object()) {
+        for (char c : child.key()) {
+          if (c == '~') {
+            _path->append("~0");
+          } else if (c == '/') {
+            _path->append("~1");
+          } else {
+            _path->push_back(c);
+          }
+        }
+      } else {
+        _path->append(std::to_string(idx));
+      }
+      resolvePaths(*child, _path, _paths, _remaining);
+      _path->resize(size);
+      if (*_remaining == 0) {
+        return;
+      }
+    }
+  }
+
+  u32 top_;
+  Profile* profile_;
+  u64 dedup_savings_;
+  u64 type_nodes_[NUM_TYPES];
+  u64 type_bytes_[NUM_TYPES];
+  std::vector<Profile::Source> sources_;
+  std::map<std::string, u64> source_index_;
+  std::unordered_map<const nlohmann::json*, u64> origins_;
+  std::unordered_map<Hash128, Group, HashHasher> groups_;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> largest_;
+};
+
+}  // namespace
+
+/*** public functions below here ***/
+
+std::string Profile::report() const {
+  std::string out;
+  char buf[512];
+  snprintf(buf, sizeof(buf),
+           "total: %" PRIu64 " bytes, %" PRIu64 " nodes\n"
+           "deduplication would save: %" PRIu64 " bytes\n",
+           bytes, nodes, dedup_savings);
+  out += buf;
+
+  out += "\nnodes by type:\n";
+  for (const auto& type : type_nodes) {
+    snprintf(buf, sizeof(buf), "  %-10s %14" PRIu64 " nodes %16" PRIu64
+             " bytes\n", type.first.c_str(), type.second,
+             type_bytes.at(type.first));
+    out += buf;
+  }
+
+  out += "\nlargest subtrees:\n";
+  for (const Subtree& subtree : largest) {
+    snprintf(buf, sizeof(buf), "  %16" PRIu64 " bytes %14" PRIu64 " nodes  ",
+             subtree.bytes, subtree.nodes);
+    out += buf + subtree.path + '\n';
+  }
+
+  out += "\nsources:\n";
+  for (const Source& source : sources) {
+    snprintf(buf, sizeof(buf),
+             "  %16" PRIu64 " bytes %14" PRIu64 " nodes %8" PRIu64
+             " subtrees  ",
+             source.bytes, source.nodes, source.subtrees);
+    out += buf + (source.source.empty() ? "(root)" : source.source) + '\n';
+  }
+
+  out += "\nduplicates:\n";
+  for (const Duplicate& dup : duplicates) {
+    snprintf(buf, sizeof(buf),
+             "  %16" PRIu64 " bytes saved %8" PRIu64 " copies %14" PRIu64
+             " bytes each  ",
+             dup.savings, dup.copies, dup.bytes);
+    out += buf + dup.path + '\n';
+  }
+  return out;
+}
+
+void profile(const nlohmann::json& _settings, const Origins* _origins, u32 _top,
+             Profile* _profile) {
+  *_profile = Profile();
+  Profiler profiler(_top, _profile);
+
+  // The root is always the first source.
+  profiler.addOrigin(&_settings, "");
+  if (_origins != nullptr) {
+    for (const auto& origin : *_origins) {
+      if (origin.first.empty()) {
+        continue;
+      }
+      nlohmann::json::json_pointer ptr(origin.first);
+      try {
+        profiler.addOrigin(&_settings.at(ptr), origin.second);
+      } catch (nlohmann::json::exception& e) {
+        // Skips origins that no longer exist.
+      }
+    }
+  }
+
+  Result res = profiler.visit(_settings, 0, true);
+  profiler.finish(_settings, res);
+}
+
+}  // namespace settings
@@ -0,0 +1,92 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SETTINGS_PROFILE_H_
+#define SETTINGS_PROFILE_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "prim/prim.h"
+#include "settings/settings.h"
+
+namespace settings {
+
+// This is a memory profile of resolved settings. All bytes are estimated heap
+// bytes (see settings::heapBytes()).
+struct Profile {
+  struct Subtree {
+    std::string path;  // JSON pointer (RFC 6901)
+    u64 bytes;         // including descendants
+    u64 nodes;         // including itself
+  };
+
+  struct Source {
+    std::string source;  // include file or reference, "" for the root
+    u64 subtrees;        // subtrees produced by the source
+    u64 bytes;           // excluding subtrees of nested sources
+    u64 nodes;           // excluding subtrees of nested sources
+  };
+
+  struct Duplicate {
+    std::string path;  // first occurrence
+    u64 copies;        // occurrences
+    u64 bytes;         // bytes of one copy
+    u64 savings;       // bytes saved by sharing a single copy
+  };
+
+  u64 bytes;
+  u64 nodes;
+  u64 dedup_savings;  // bytes saved by sharing all duplicate subtrees
+
+  // keyed by nlohmann::json type names
+  std::map<std::string, u64> type_nodes;
+  std::map<std::string, u64> type_bytes;
+
+  std::vector<Subtree> largest;        // descending by bytes, excluding root
+  std::vector<Source> sources;         // descending by bytes
+  std::vector<Duplicate> duplicates;   // descending by savings
+
+  // this returns a human readable report
+  std::string report() const;
+};
+
+// this profiles the memory consumption of the settings
+//  the origins are optional (see settings::initFile())
+//  the number of largest subtrees and duplicates are limited to _top.
+//  duplicates that are implied by a duplicate parent aren't listed.
+void profile(const nlohmann::json& _settings, const Origins* _origins, u32 _top,
+             Profile* _profile);
+
+}  // namespace settings
+
+#endif  // SETTINGS_PROFILE_H_
@@ -0,0 +1,137 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/profile.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+#include "settings/settings.h"
+
+TEST(Profile, origins) {
+  const char* afilename = "TEST_asettings.json";
+  FILE* afp = fopen(afilename, "w");
+  assert(afp != NULL);
+  fprintf(afp, "%s",
+          "{\"sub\": \"$$(TEST_bsettings.json)$$\", \"a\": 1,"
+          " \"r\": \"$&(/sub/x)&$\", \"s\": \"$$(TEST_bsettings.json)$$\"}");
+  fclose(afp);
+
+  const char* bfilename = "TEST_bsettings.json";
+  FILE* bfp = fopen(bfilename, "w");
+  assert(bfp != NULL);
+  fprintf(bfp, "%s",
+          "{\"x\": [1, 2, 3], \"y\": \"$$(TEST_csettings.json)$$\"}");
+  fclose(bfp);
+
+  const char* cfilename = "TEST_csettings.json";
+  FILE* cfp = fopen(cfilename, "w");
+  assert(cfp != NULL);
+  fprintf(cfp, "%s", "\"a string that is too long to be stored inline\"");
+  fclose(cfp);
+
+  nlohmann::json settings;
+  settings::Origins origins;
+  settings::initFile(afilename, &settings, &origins);
+
+  ASSERT_EQ(origins.size(), 5u);
+  ASSERT_EQ(origins.at("/sub"), "./TEST_bsettings.json");
+  ASSERT_EQ(origins.at("/sub/y"), "./TEST_csettings.json");
+  ASSERT_EQ(origins.at("/s"), "./TEST_bsettings.json");
+  ASSERT_EQ(origins.at("/s/y"), "./TEST_csettings.json");
+  ASSERT_EQ(origins.at("/r"), "$&(/sub/x)&$");
+
+  // Updates replace origins.
+  const int argc = 4;
+  const char* argv[argc] = {"./path/to/some/binary", afilename,
+                            "/s=int=5", "/a=file=TEST_bsettings.json"};
+  origins.clear();
+  settings::commandLine(argc, argv, &settings, &origins);
+  ASSERT_EQ(origins.size(), 5u);
+  ASSERT_EQ(origins.count("/s"), 0u);
+  ASSERT_EQ(origins.count("/s/y"), 0u);
+  ASSERT_EQ(origins.at("/a"), "TEST_bsettings.json");
+  ASSERT_EQ(origins.at("/a/y"), "./TEST_csettings.json");
+
+  assert(remove(afilename) == 0);
+  assert(remove(bfilename) == 0);
+  assert(remove(cfilename) == 0);
+}
+
+TEST(Profile, profile) {
+  nlohmann::json router;
+  settings::initString(
+      "{\"ports\": [0, 1, 2, 3, 4, 5, 6, 7], \"name\": \"a router with a long"
+      " name\", \"buffers\": {\"size\": 1024, \"vcs\": 4}}",
+      &router);
+  nlohmann::json settings;
+  settings::Origins origins;
+  for (u32 r = 0; r < 16; r++) {
+    settings["routers"].push_back(router);
+    origins["/routers/" + std::to_string(r)] = "router.json";
+  }
+  settings["unique"] = "another string that is too long to be inline";
+
+  settings::Profile profile;
+  settings::profile(settings, &origins, 5, &profile);
+
+  ASSERT_EQ(profile.bytes, settings::heapBytes(settings));
+  ASSERT_EQ(profile.nodes, 1u + 1u + 16u * 14u + 1u);
+  ASSERT_EQ(profile.type_nodes.at("object"), 1u + 16u * 2u);
+  ASSERT_EQ(profile.type_nodes.at("array"), 1u + 16u);
+  ASSERT_EQ(profile.type_nodes.at("unsigned"), 16u * 10u);
+  ASSERT_EQ(profile.type_nodes.at("string"), 16u + 1u);
+
+  ASSERT_EQ(profile.largest.size(), 5u);
+  ASSERT_EQ(profile.largest.at(0).path, "/routers");
+  ASSERT_EQ(profile.largest.at(0).nodes, 1u + 16u * 14u);
+  for (u32 idx = 1; idx < profile.largest.size(); idx++) {
+    ASSERT_GE(profile.largest.at(idx - 1).bytes, profile.largest.at(idx).bytes);
+  }
+
+  ASSERT_EQ(profile.sources.size(), 2u);
+  ASSERT_EQ(profile.sources.at(0).source, "router.json");
+  ASSERT_EQ(profile.sources.at(0).subtrees, 16u);
+  ASSERT_EQ(profile.sources.at(0).nodes, 16u * 14u);
+  ASSERT_EQ(profile.sources.at(1).source, "");
+  ASSERT_EQ(profile.sources.at(0).bytes + profile.sources.at(1).bytes,
+            profile.bytes);
+
+  // Only the routers are reported since their contents are implied.
+  ASSERT_EQ(profile.duplicates.size(), 1u);
+  ASSERT_EQ(profile.duplicates.at(0).path, "/routers/0");
+  ASSERT_EQ(profile.duplicates.at(0).copies, 16u);
+  ASSERT_EQ(profile.duplicates.at(0).savings,
+            15u * settings::heapBytes(router));
+  ASSERT_EQ(profile.dedup_savings, 15u * settings::heapBytes(router));
+
+  ASSERT_FALSE(profile.report().empty());
+}
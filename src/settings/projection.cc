@@ -0,0 +1,384 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/projection.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "settings/settings.h"
+
+namespace settings {
+
+// This parses the selected values of JSON text and skips the others.
+class Projector {
+ public:
+  Projector(
+      const std::string& _text,
+      const std::function<void(const Projection&, nlohmann::json*)>& _visit)
+      : begin_(_text.data()),
+        pos_(_text.data()),
+        end_(_text.data() + _text.size()),
+        visit_(_visit) {}
+
+  void document(const Projection& _projection, nlohmann::json* _settings) {
+    value(_projection, _settings);
+    skipWhitespace();
+    if (pos_ != end_) {
+      fail("unexpected text after the value");
+    }
+  }
+
+ private:
+  void value(const Projection& _projection, nlohmann::json* _value) {
+    skipWhitespace();
+    if (pos_ == end_) {
+      fail("unexpected end of text");
+    }
+    if (!_projection.all() && *pos_ == '{') {
+      object(_projection, _value);
+    } else if (!_projection.all() && *pos_ == '[') {
+      array(_projection, _value);
+    } else {
+      // Parses the whole value.
+      const char* start = pos_;
+      skipValue();
+      try {
+        *_value = nlohmann::json::parse(start, pos_);
+      } catch (nlohmann::json::parse_error& e) {
+        fail(e.what(), start);
+      }
+      if (_projection.all() || _value->is_string()) {
+        visit_(_projection, _value);
+      }
+    }
+  }
+
+  void object(const Projection& _projection, nlohmann::json* _value) {
+    *_value = nlohmann::json::object();
+    pos_++;
+    skipWhitespace();
+    if (pos_ != end_ && *pos_ == '}') {
+      pos_++;
+      return;
+    }
+    while (true) {
+      skipWhitespace();
+      std::string key = string();
+      skipWhitespace();
+      expect(':');
+      const Projection* child = _projection.child(key);
+      if (child != nullptr) {
+        value(*child, &(*_value)[key]);
+      } else {
+        skipWhitespace();
+        skipValue();
+      }
+      skipWhitespace();
+      if (pos_ != end_ && *pos_ == ',') {
+        pos_++;
+      } else {
+        expect('}');
+        return;
+      }
+    }
+  }
+
+  void array(const Projection& _projection, nlohmann::json* _value) {
+    _projection.checkIndices();
+    *_value = nlohmann::json::array();
+    pos_++;
+    skipWhitespace();
+    if (pos_ != end_ && *pos_ == ']') {
+      pos_++;
+      return;
+    }
+    for (u64 index = 0;; index++) {
+      const Projection* child = _projection.child(std::to_string(index));
+      if (child != nullptr) {
+        value(*child, &(*_value)[index]);
+      } else {
+        skipWhitespace();
+        skipValue();
+      }
+      skipWhitespace();
+      if (pos_ != end_ && *pos_ == ',') {
+        pos_++;
+      } else {
+        expect(']');
+        return;
+      }
+    }
+  }
+
+  // This parses a string, which is unescaped only if needed.
+  std::string string() {
+    if (pos_ == end_ || *pos_ != '"') {
+      fail("expected a string");
+    }
+    const char* start = pos_;
+    skipString();
+    if (std::find(start, pos_, '\\') == pos_) {
+      return std::string(start + 1, pos_ - 1);
+    }
+    try {
+      return nlohmann::json::parse(start, pos_).get<std::string>();
+    } catch (nlohmann::json::parse_error& e) {
+      fail(e.what(), start);
+    }
+  }
+
+  void skipValue() {
+    if (pos_ == end_) {
+      fail("unexpected end of text");
+    }
+    switch (*pos_) {
+      case '"':
+        skipString();
+        return;
+
+      case '{':
+      case '[': {
+        // Only strings and brackets matter for finding the end.
+        u64 depth = 0;
+        while (pos_ != end_) {
+          char c = *pos_;
+          if (c == '"') {
+            skipString();
+            continue;
+          }
+          pos_++;
+          if (c == '{' || c == '[') {
+            depth++;
+          } else if (c == '}' || c == ']') {
+            if (--depth == 0) {
+              return;
+            }
+          }
+        }
+        fail("unexpected end of text");
+      }
+
+      default:
+        while (pos_ != end_ && strchr(",}] \t\r\n", *pos_) == nullptr) {
+          pos_++;
+        }
+        return;
+    }
+  }
+
+  void skipString() {
+    const char* pos = pos_ + 1;
+    while (true) {
+      const char* quote =
+          static_cast<const char*>(memchr(pos, '"', end_ - pos));
+      if (quote == nullptr) {
+        fail("unterminated string");
+      }
+      // The quote is escaped by an odd number of backslashes.
+      const char* escape = quote;
+      while (escape > pos && escape[-1] == '\\') {
+        escape--;
+      }
+      pos = quote + 1;
+      if ((quote - escape) % 2 == 0) {
+        pos_ = pos;
+        return;
+      }
+    }
+  }
+
+  void skipWhitespace() {
+    while (pos_ != end_ &&
+           (*pos_ == ' ' || *pos_ == '\t' || *pos_ == '\r' || *pos_ == '\n')) {
+      pos_++;
+    }
+  }
+
+  void expect(char _c) {
+    if (pos_ == end_ || *pos_ != _c) {
+      fail(std::string("expected '") + _c + "'");
+    }
+    pos_++;
+  }
+
+  [[noreturn]] void fail(const std::string& _message) {
+    fail(_message, pos_);
+  }
+
+  [[noreturn]] void fail(const std::string& _message, const char* _at) {
+    throw Error(_message + " at byte " + std::to_string(_at - begin_));
+  }
+
+  const char* begin_;
+  const char* pos_;
+  const char* end_;
+  const std::function<void(const Projection&, nlohmann::json*)>& visit_;
+};
+
+/*** public functions below here ***/
+
+Projection::Projection() : all_(false) {}
+
+Projection::Projection(const std::vector<std::string>& _prefixes)
+    : all_(false) {
+  for (const std::string& prefix : _prefixes) {
+    add(prefix);
+  }
+}
+
+void Projection::add(const std::string& _prefix) {
+  add(pointerTokens(_prefix), 0);
+}
+
+bool Projection::all() const {
+  return all_;
+}
+
+bool Projection::empty() const {
+  return !all_ && children_.empty();
+}
+
+const Projection* Projection::child(const std::string& _token) const {
+  if (all_) {
+    return this;
+  }
+  auto it = children_.find(_token);
+  return it == children_.end() ? nullptr : &it->second;
+}
+
+bool Projection::covers(const std::string& _pointer) const {
+  const Projection* projection = this;
+  for (const std::string& token : pointerTokens(_pointer)) {
+    if (projection->all_) {
+      return true;
+    }
+    projection = projection->child(token);
+    if (projection == nullptr) {
+      return false;
+    }
+  }
+  return projection->all_;
+}
+
+void Projection::prune(nlohmann::json* _settings) const {
+  if (all_) {
+    return;
+  }
+  if (_settings->is_object()) {
+    for (auto it = _settings->begin(); it != _settings->end();) {
+      auto child = children_.find(it.key());
+      if (child == children_.end()) {
+        it = _settings->erase(it);
+      } else {
+        child->second.prune(&it.value());
+        ++it;
+      }
+    }
+  } else if (_settings->is_array()) {
+    // Keeps the selected elements at their indices.
+    checkIndices();
+    nlohmann::json pruned = nlohmann::json::array();
+    for (u64 index = 0; index < _settings->size(); index++) {
+      auto child = children_.find(std::to_string(index));
+      if (child != children_.end()) {
+        pruned[index] = std::move((*_settings)[index]);
+        child->second.prune(&pruned[index]);
+      }
+    }
+    *_settings = std::move(pruned);
+  }
+}
+
+std::vector<std::string> pointerTokens(const std::string& _pointer) {
+  if (!_pointer.empty() && _pointer[0] != '/') {
+    throw Error("invalid JSON pointer \"" + _pointer + "\"");
+  }
+  std::vector<std::string> tokens;
+  size_t start = 0;
+  while (start < _pointer.size()) {
+    size_t end = _pointer.find('/', start + 1);
+    if (end == std::string::npos) {
+      end = _pointer.size();
+    }
+    std::string token;
+    for (size_t idx = start + 1; idx < end; idx++) {
+      if (_pointer[idx] != '~') {
+        token += _pointer[idx];
+      } else if (idx + 1 < end && _pointer[idx + 1] == '0') {
+        token += '~';
+        idx++;
+      } else if (idx + 1 < end && _pointer[idx + 1] == '1') {
+        token += '/';
+        idx++;
+      } else {
+        throw Error("invalid JSON pointer \"" + _pointer + "\"");
+      }
+    }
+    tokens.push_back(std::move(token));
+    start = end;
+  }
+  return tokens;
+}
+
+void parseProjected(
+    const std::string& _text, const Projection& _projection,
+    nlohmann::json* _settings,
+    const std::function<void(const Projection&, nlohmann::json*)>& _visit) {
+  Projector projector(_text, _visit);
+  projector.document(_projection, _settings);
+}
+
+/*** private functions below here ***/
+
+void Projection::add(const std::vector<std::string>& _tokens, u64 _index) {
+  if (all_) {
+    return;
+  }
+  if (_index == _tokens.size()) {
+    all_ = true;
+    children_.clear();
+  } else {
+    children_[_tokens[_index]].add(_tokens, _index + 1);
+  }
+}
+
+void Projection::checkIndices() const {
+  for (const auto& child : children_) {
+    const std::string& token = child.first;
+    if (token.size() > 1 && token[0] == '0' &&
+        std::all_of(token.begin(), token.end(),
+                    [](char _c) { return _c >= '0' && _c <= '9'; })) {
+      throw Error("invalid array index \"" + token + "\"");
+    }
+  }
+}
+
+}  // namespace settings
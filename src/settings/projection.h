@@ -0,0 +1,110 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SETTINGS_PROJECTION_H_
+#define SETTINGS_PROJECTION_H_
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "prim/prim.h"
+
+namespace settings {
+
+// This is a set of JSON pointer (RFC 6901) prefixes that selects subtrees of
+// settings. A value is fully selected if a prefix points to it or to one of its
+// ancestors, and partially selected if a prefix points within it. Selected
+// array elements keep their indices, so unselected elements before them become
+// null. Selecting within an array with a non-canonical index (e.g., "/a/01")
+// fails.
+class Projection {
+ public:
+  // this selects nothing
+  Projection();
+
+  // this selects the subtrees at the prefixes ("" selects everything)
+  //  throws settings::Error if a prefix is invalid
+  explicit Projection(const std::vector<std::string>& _prefixes);
+
+  // this selects the subtree at the prefix
+  //  throws settings::Error if the prefix is invalid
+  void add(const std::string& _prefix);
+
+  // this returns true if the whole value is selected
+  bool all() const;
+
+  // this returns true if nothing is selected
+  bool empty() const;
+
+  // this returns the selection within the child with the reference token (the
+  //  object key or array index), nullptr if the child isn't selected
+  const Projection* child(const std::string& _token) const;
+
+  // this returns true if the value at the pointer is fully selected
+  //  throws settings::Error if the pointer is invalid
+  bool covers(const std::string& _pointer) const;
+
+  // this removes the values that aren't selected
+  //  throws settings::Error if an array is selected within by an invalid index
+  void prune(nlohmann::json* _settings) const;
+
+ private:
+  friend class Projector;
+
+  void add(const std::vector<std::string>& _tokens, u64 _index);
+
+  // this throws settings::Error if a child's reference token is a number that
+  //  isn't a canonical array index (e.g., "01"), so it can't select an element
+  void checkIndices() const;
+
+  bool all_;
+  std::map<std::string, Projection> children_;
+};
+
+// this splits a JSON pointer into its unescaped reference tokens
+//  throws settings::Error if the pointer is invalid
+std::vector<std::string> pointerTokens(const std::string& _pointer);
+
+// this parses JSON text materializing only the selected values. Unselected
+//  values are skipped without being parsed or validated. _visit is called with
+//  each fully selected value and each partially selected string after they
+//  are parsed, and may modify them.
+//  throws settings::Error upon failure
+void parseProjected(
+    const std::string& _text, const Projection& _projection,
+    nlohmann::json* _settings,
+    const std::function<void(const Projection&, nlohmann::json*)>& _visit);
+
+}  // namespace settings
+
+#endif  // SETTINGS_PROJECTION_H_
@@ -0,0 +1,227 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/projection.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+#include "settings/settings.h"
+#include "settings/sidecar.h"
+
+static void noVisit(const settings::Projection&, nlohmann::json*) {}
+
+TEST(Projection, select) {
+  settings::Projection projection({"/a/b", "/c", "/d/1", "/e~1f"});
+  ASSERT_FALSE(projection.all());
+  ASSERT_FALSE(projection.empty());
+  ASSERT_TRUE(settings::Projection().empty());
+  ASSERT_TRUE(settings::Projection({""}).all());
+  ASSERT_NE(projection.child("a"), nullptr);
+  ASSERT_FALSE(projection.child("a")->all());
+  ASSERT_TRUE(projection.child("c")->all());
+  ASSERT_TRUE(projection.child("e/f")->all());
+  ASSERT_EQ(projection.child("x"), nullptr);
+
+  ASSERT_TRUE(projection.covers("/a/b"));
+  ASSERT_TRUE(projection.covers("/a/b/x/0"));
+  ASSERT_TRUE(projection.covers("/c"));
+  ASSERT_FALSE(projection.covers("/a"));
+  ASSERT_FALSE(projection.covers("/a/x"));
+  ASSERT_FALSE(projection.covers(""));
+
+  // Adding an ancestor selects the whole subtree.
+  projection.add("/a");
+  ASSERT_TRUE(projection.covers("/a/x"));
+
+  ASSERT_THROW(settings::Projection({"a"}), settings::Error);
+  ASSERT_THROW(settings::pointerTokens("/a~2"), settings::Error);
+  ASSERT_EQ(settings::pointerTokens("/a~0/~1b/"),
+            std::vector<std::string>({"a~", "/b", ""}));
+}
+
+TEST(Projection, parse) {
+  std::string text =
+      "{\"a\": {\"b\": [1, {\"x\": \"}]\\\"{\"}], \"skip\": \"\\\\\"},\n"
+      " \"c\": 1.5e3, \"d\": [true, [false], null, \"q\"],\n"
+      " \"e/f\": {\"g\": [[[]]]}, \"h\\u0041\": 2, \"skip\": [{\"x\": \"]\"}]}";
+  nlohmann::json full = nlohmann::json::parse(text);
+
+  settings::Projection projection({"/a/b", "/c", "/d/1", "/e~1f", "/hA"});
+  nlohmann::json projected;
+  u64 visits = 0;
+  settings::parseProjected(
+      text, projection, &projected,
+      [&](const settings::Projection& _selected, nlohmann::json* /*_value*/) {
+        ASSERT_TRUE(_selected.all());
+        visits++;
+      });
+  ASSERT_EQ(visits, 5u);
+
+  nlohmann::json pruned = full;
+  projection.prune(&pruned);
+  ASSERT_EQ(projected, pruned);
+  ASSERT_EQ(projected["a"]["b"], full["a"]["b"]);
+  ASSERT_EQ(projected["d"], nlohmann::json::parse("[null, [false]]"));
+  ASSERT_FALSE(projected.contains("skip"));
+  ASSERT_FALSE(projected["a"].contains("skip"));
+
+  // Partially selected strings are visited, other partial values are kept.
+  nlohmann::json partial;
+  visits = 0;
+  settings::parseProjected(
+      "{\"a\": \"s\", \"b\": 3}", settings::Projection({"/a/x", "/b/x"}),
+      &partial,
+      [&](const settings::Projection& _selected, nlohmann::json* _value) {
+        ASSERT_FALSE(_selected.all());
+        ASSERT_EQ(*_value, nlohmann::json("s"));
+        visits++;
+      });
+  ASSERT_EQ(visits, 1u);
+  ASSERT_EQ(partial, nlohmann::json::parse("{\"a\": \"s\", \"b\": 3}"));
+
+  // Selected values are validated, skipped values aren't.
+  nlohmann::json settings;
+  ASSERT_THROW(settings::parseProjected("{\"a\": [1, 2}",
+                                        settings::Projection({"/a"}),
+                                        &settings, noVisit),
+               settings::Error);
+  settings::parseProjected("{\"a\": [1, 2 3], \"b\": 4}",
+                           settings::Projection({"/b"}), &settings, noVisit);
+  ASSERT_EQ(settings, nlohmann::json::parse("{\"b\": 4}"));
+  ASSERT_THROW(settings::parseProjected("{\"a\": \"x, \"b\": 4}",
+                                        settings::Projection({"/b"}),
+                                        &settings, noVisit),
+               settings::Error);
+  ASSERT_THROW(settings::parseProjected("{\"b\": 4} x",
+                                        settings::Projection({"/b"}),
+                                        &settings, noVisit),
+               settings::Error);
+
+  // Non-canonical array indices fail, but are fine as object keys.
+  settings::Projection leading({"/d/01"});
+  ASSERT_THROW(settings::parseProjected(text, leading, &settings, noVisit),
+               settings::Error);
+  nlohmann::json copy = full;
+  ASSERT_THROW(leading.prune(&copy), settings::Error);
+  settings::parseProjected("{\"d\": {\"01\": 1, \"1\": 2}}", leading,
+                           &settings, noVisit);
+  ASSERT_EQ(settings, nlohmann::json::parse("{\"d\": {\"01\": 1}}"));
+}
+
+TEST(Projection, load) {
+  const char* afilename = "TEST_asettings.json";
+  FILE* fp = fopen(afilename, "w");
+  assert(fp != NULL);
+  fprintf(fp, "%s",
+          "{\"stats\": {\"file\": \"s.csv\", \"rate\": \"$&(/big/rate)&$\"},\n"
+          " \"workload\": \"$$(TEST_bsettings.json)$$\",\n"
+          " \"big\": {\"rate\": \"$&(/big/table/2)&$\", \"table\": [1, 2, 3],\n"
+          "         \"other\": \"$$(TEST_missing.json)$$\"},\n"
+          " \"link\": \"$&(/workload/sizes)&$\"}");
+  fclose(fp);
+  const char* bfilename = "TEST_bsettings.json";
+  fp = fopen(bfilename, "w");
+  assert(fp != NULL);
+  fprintf(fp, "%s",
+          "{\"sizes\": [4, 8], \"sub\": \"$$(TEST_csettings.json)$$\",\n"
+          " \"broken\": \"$$(TEST_missing.json)$$\"}");
+  fclose(fp);
+  const char* cfilename = "TEST_csettings.json";
+  fp = fopen(cfilename, "w");
+  assert(fp != NULL);
+  fprintf(fp, "%s", "{\"x\": 1, \"y\": 2}");
+  fclose(fp);
+
+  // Unselected inclusions (i.e., missing files) aren't loaded.
+  nlohmann::json settings;
+  settings::loadProjection(afilename, {"/stats"}, &settings);
+  ASSERT_EQ(settings, nlohmann::json::parse(
+                          "{\"stats\": {\"file\": \"s.csv\", \"rate\": 3}}"));
+
+  // Inclusions on the way to selected subtrees are projected.
+  settings::loadProjection(afilename, {"/workload/sub/y", "/link"},
+                           &settings);
+  ASSERT_EQ(settings,
+            nlohmann::json::parse("{\"workload\": {\"sub\": {\"y\": 2}},"
+                                  " \"link\": [4, 8]}"));
+
+  ASSERT_THROW(settings::loadProjection(afilename, {"/workload"}, &settings),
+               settings::Error);
+  ASSERT_THROW(settings::loadProjection(afilename, {"/big"}, &settings),
+               settings::Error);
+
+  assert(remove(afilename) == 0);
+  assert(remove(bfilename) == 0);
+  assert(remove(cfilename) == 0);
+}
+
+TEST(Projection, loadPartial) {
+  std::vector<u32> elements = {7, 8, 9};
+  const char* sfilename = "TEST_psettings.arr";
+  settings::writeSidecar(
+      sfilename, settings::makeTypedArray(elements.data(), elements.size()));
+  settings::writeToFile({{"v", 6}, {"w", 7}}, "TEST_[p].json");
+  const char* filename = "TEST_psettings.json";
+  FILE* fp = fopen(filename, "w");
+  assert(fp != NULL);
+  fprintf(fp, "%s",
+          "{\"a\": \"$%(range(0, 5))%$\",\n"
+          " \"b\": \"$#(TEST_psettings.arr)#$\",\n"
+          " \"c\": \"$@(x)@$\", \"d\": 1,\n"
+          " \"e\": \"$$(TEST_[p].json)$$\"}");
+  fclose(fp);
+
+  // Partially selected generators are expanded and pruned.
+  nlohmann::json settings;
+  settings::loadProjection(filename, {"/a/2"}, &settings);
+  ASSERT_EQ(settings, nlohmann::json::parse("{\"a\": [null, null, 2]}"));
+
+  // Partially selected sidecars are loaded whole as typed arrays.
+  settings::loadProjection(filename, {"/b/1"}, &settings);
+  ASSERT_EQ(settings.size(), 1u);
+  ASSERT_TRUE(settings::isTypedArray(settings.at("b")));
+  ASSERT_EQ(settings::fromTypedArray(settings.at("b")),
+            nlohmann::json::parse("[7, 8, 9]"));
+
+  // Partially selected substitution sites are kept as a full load would.
+  settings::loadProjection(filename, {"/c/0"}, &settings);
+  ASSERT_EQ(settings, nlohmann::json::parse("{\"c\": \"$@(x)@$\"}"));
+
+  // Files named like patterns are projected as files.
+  settings::loadProjection(filename, {"/e/w"}, &settings);
+  ASSERT_EQ(settings, nlohmann::json::parse("{\"e\": {\"w\": 7}}"));
+
+  assert(remove(filename) == 0);
+  assert(remove(sfilename) == 0);
+  assert(remove("TEST_[p].json") == 0);
+}
@@ -0,0 +1,808 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/schema.h"
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <regex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+
+#include "settings/generator.h"
+#include "settings/settings.h"
+#include "settings/sidecar.h"
+
+namespace settings {
+
+// This marks an absent subschema.
+static const u32 NONE = std::numeric_limits<u32>::max();
+
+// These are the bits of a type mask. Integers are also numbers.
+enum : u32 {
+  NULL_TYPE = 1u << 0,
+  BOOLEAN_TYPE = 1u << 1,
+  INTEGER_TYPE = 1u << 2,
+  NUMBER_TYPE = 1u << 3,
+  STRING_TYPE = 1u << 4,
+  ARRAY_TYPE = 1u << 5,
+  OBJECT_TYPE = 1u << 6
+};
+
+struct Schema::Node {
+  bool never = false;  // the false schema
+  u32 ref = NONE;
+  u32 types = 0;  // 0 allows all types
+
+  bool has_enum = false;
+  std::vector<nlohmann::json> enums;
+  bool has_const = false;
+  nlohmann::json constant;
+
+  bool has_minimum = false;
+  bool minimum_exclusive = false;  // draft 4 boolean exclusiveMinimum
+  f64 minimum = 0.0;
+  bool has_exclusive_minimum = false;
+  f64 exclusive_minimum = 0.0;
+  bool has_maximum = false;
+  bool maximum_exclusive = false;  // draft 4 boolean exclusiveMaximum
+  f64 maximum = 0.0;
+  bool has_exclusive_maximum = false;
+  f64 exclusive_maximum = 0.0;
+  f64 multiple_of = 0.0;  // 0 is none
+
+  u64 min_length = 0;
+  u64 max_length = std::numeric_limits<u64>::max();
+  bool has_pattern = false;
+  std::string pattern_text;
+  std::regex pattern;
+
+  u32 items = NONE;
+  u64 min_items = 0;
+  u64 max_items = std::numeric_limits<u64>::max();
+  bool unique_items = false;
+
+  std::unordered_map<std::string, u32> properties;
+  std::vector<std::string> required;
+  u32 additional = NONE;
+  u64 min_properties = 0;
+  u64 max_properties = std::numeric_limits<u64>::max();
+
+  std::vector<u32> all_of;
+  std::vector<u32> any_of;
+  std::vector<u32> one_of;
+  u32 negated = NONE;
+};
+
+// This is the location of a settings value during validation. Pointers are
+// only built for violations.
+struct Schema::Location {
+  const Location* parent;
+  const std::string* key;  // nullptr for array elements and the root
+  u64 index;
+};
+
+// This compiles a schema into schema nodes. Local references are compiled
+// once per target so recursive schemas are finite.
+class SchemaCompiler {
+ public:
+  SchemaCompiler(const nlohmann::json& _root, std::vector<Schema::Node>* _nodes)
+      : root_(_root), nodes_(_nodes) {}
+
+  u32 compile(const nlohmann::json& _schema, const std::string& _pointer) {
+    u32 index = static_cast<u32>(nodes_->size());
+    nodes_->emplace_back();
+    pointers_.push_back(_pointer);
+    Schema::Node node;
+
+    if (_schema.is_boolean()) {
+      node.never = !_schema.get<bool>();
+      (*nodes_)[index] = std::move(node);
+      return index;
+    }
+    if (!_schema.is_object()) {
+      fail(_pointer, "a schema must be an object or a boolean");
+    }
+
+    for (auto it = _schema.cbegin(); it != _schema.cend(); ++it) {
+      const std::string& key = it.key();
+      const nlohmann::json& value = it.value();
+      std::string pointer = _pointer + '/' + escape(key);
+
+      if (key == "type") {
+        if (value.is_string()) {
+          node.types = typeMask(value, pointer);
+        } else if (value.is_array() && !value.empty()) {
+          for (const nlohmann::json& type : value) {
+            node.types |= typeMask(type, pointer);
+          }
+        } else {
+          fail(pointer, "must be a type name or an array of type names");
+        }
+      } else if (key == "enum") {
+        if (!value.is_array()) {
+          fail(pointer, "must be an array");
+        }
+        node.has_enum = true;
+        node.enums.assign(value.cbegin(), value.cend());
+      } else if (key == "const") {
+        node.has_const = true;
+        node.constant = value;
+      } else if (key == "minimum") {
+        node.has_minimum = true;
+        node.minimum = number(value, pointer);
+      } else if (key == "maximum") {
+        node.has_maximum = true;
+        node.maximum = number(value, pointer);
+      } else if (key == "exclusiveMinimum") {
+        // Draft 4 uses booleans that make minimum exclusive.
+        if (value.is_boolean()) {
+          node.minimum_exclusive = value.get<bool>();
+        } else {
+          node.has_exclusive_minimum = true;
+          node.exclusive_minimum = number(value, pointer);
+        }
+      } else if (key == "exclusiveMaximum") {
+        // Draft 4 uses booleans that make maximum exclusive.
+        if (value.is_boolean()) {
+          node.maximum_exclusive = value.get<bool>();
+        } else {
+          node.has_exclusive_maximum = true;
+          node.exclusive_maximum = number(value, pointer);
+        }
+      } else if (key == "multipleOf") {
+        node.multiple_of = number(value, pointer);
+        if (node.multiple_of <= 0.0) {
+          fail(pointer, "must be greater than 0");
+        }
+      } else if (key == "minLength") {
+        node.min_length = count(value, pointer);
+      } else if (key == "maxLength") {
+        node.max_length = count(value, pointer);
+      } else if (key == "pattern") {
+        if (!value.is_string()) {
+          fail(pointer, "must be a string");
+        }
+        node.has_pattern = true;
+        node.pattern_text = value.get<std::string>();
+        try {
+          node.pattern = std::regex(node.pattern_text,
+                                    std::regex::ECMAScript |
+                                        std::regex::optimize);
+        } catch (std::regex_error& e) {
+          fail(pointer, std::string("invalid regular expression: ") +
+                            e.what());
+        }
+      } else if (key == "items") {
+        if (value.is_array()) {
+          fail(pointer, "tuple validation isn't supported");
+        }
+        node.items = compile(value, pointer);
+      } else if (key == "minItems") {
+        node.min_items = count(value, pointer);
+      } else if (key == "maxItems") {
+        node.max_items = count(value, pointer);
+      } else if (key == "uniqueItems") {
+        if (!value.is_boolean()) {
+          fail(pointer, "must be a boolean");
+        }
+        node.unique_items = value.get<bool>();
+      } else if (key == "properties") {
+        if (!value.is_object()) {
+          fail(pointer, "must be an object");
+        }
+        for (auto prop = value.cbegin(); prop != value.cend(); ++prop) {
+          node.properties[prop.key()] =
+              compile(prop.value(), pointer + '/' + escape(prop.key()));
+        }
+      } else if (key == "required") {
+        if (!value.is_array()) {
+          fail(pointer, "must be an array");
+        }
+        for (const nlohmann::json& name : value) {
+          if (!name.is_string()) {
+            fail(pointer, "must be an array of strings");
+          }
+          node.required.push_back(name.get<std::string>());
+        }
+      } else if (key == "additionalProperties") {
+        node.additional = compile(value, pointer);
+      } else if (key == "minProperties") {
+        node.min_properties = count(value, pointer);
+      } else if (key == "maxProperties") {
+        node.max_properties = count(value, pointer);
+      } else if (key == "allOf" || key == "anyOf" || key == "oneOf") {
+        if (!value.is_array() || value.empty()) {
+          fail(pointer, "must be a non-empty array");
+        }
+        std::vector<u32>& list = key == "allOf"   ? node.all_of
+                                 : key == "anyOf" ? node.any_of
+                                                  : node.one_of;
+        for (u64 idx = 0; idx < value.size(); idx++) {
+          list.push_back(compile(value[idx], pointer + '/' +
+                                                 std::to_string(idx)));
+        }
+      } else if (key == "not") {
+        node.negated = compile(value, pointer);
+      } else if (key == "$ref") {
+        if (!value.is_string()) {
+          fail(pointer, "must be a string");
+        }
+        node.ref = reference(value.get<std::string>(), pointer);
+      } else if (key == "definitions" || key == "$defs" || key == "$schema" ||
+                 key == "$id" || key == "$comment" || key == "title" ||
+                 key == "description" || key == "default" ||
+                 key == "examples" || key == "format") {
+        // Annotations and definitions (compiled when referenced).
+      } else {
+        fail(pointer, "unsupported keyword");
+      }
+    }
+
+    (*nodes_)[index] = std::move(node);
+    return index;
+  }
+
+  // Compiles the root, which may be referenced as "#".
+  void compileRoot() {
+    references_[""] = 0;
+    compile(root_, "");
+
+    // Rejects references that reach themselves without validating a child
+    //  value, which would never finish validating.
+    std::vector<u8> states(nodes_->size(), 0);
+    for (u32 index = 0; index < nodes_->size(); index++) {
+      checkCycles(index, &states);
+    }
+  }
+
+ private:
+  // Visits the subschemas applied to the same value depth first. States are
+  //  0 (unvisited), 1 (on the path), and 2 (done).
+  void checkCycles(u32 _index, std::vector<u8>* _states) const {
+    if ((*_states)[_index] == 2) {
+      return;
+    }
+    if ((*_states)[_index] == 1) {
+      fail(pointers_[_index], "circular reference");
+    }
+    (*_states)[_index] = 1;
+    const Schema::Node& node = (*nodes_)[_index];
+    for (u32 sub : {node.ref, node.negated}) {
+      if (sub != NONE) {
+        checkCycles(sub, _states);
+      }
+    }
+    for (const std::vector<u32>* list :
+         {&node.all_of, &node.any_of, &node.one_of}) {
+      for (u32 sub : *list) {
+        checkCycles(sub, _states);
+      }
+    }
+    (*_states)[_index] = 2;
+  }
+
+  u32 reference(const std::string& _ref, const std::string& _pointer) {
+    if (_ref.empty() || _ref[0] != '#') {
+      fail(_pointer, "only local references are supported");
+    }
+    std::string target = _ref.substr(1);
+    auto it = references_.find(target);
+    if (it != references_.end()) {
+      return it->second;
+    }
+    const nlohmann::json* schema = nullptr;
+    try {
+      schema = &root_.at(nlohmann::json::json_pointer(target));
+    } catch (nlohmann::json::exception& e) {
+      fail(_pointer, "reference \"" + _ref + "\" doesn't exist");
+    }
+    references_[target] = static_cast<u32>(nodes_->size());
+    return compile(*schema, target);
+  }
+
+  static u32 typeMask(const nlohmann::json& _type,
+                      const std::string& _pointer) {
+    std::string name = _type.is_string() ? _type.get<std::string>() : "";
+    if (name == "null") {
+      return NULL_TYPE;
+    } else if (name == "boolean") {
+      return BOOLEAN_TYPE;
+    } else if (name == "integer") {
+      return INTEGER_TYPE;
+    } else if (name == "number") {
+      return NUMBER_TYPE | INTEGER_TYPE;
+    } else if (name == "string") {
+      return STRING_TYPE;
+    } else if (name == "array") {
+      return ARRAY_TYPE;
+    } else if (name == "object") {
+      return OBJECT_TYPE;
+    }
+    fail(_pointer, "invalid type name");
+  }
+
+  static f64 number(const nlohmann::json& _value,
+                    const std::string& _pointer) {
+    if (!_value.is_number()) {
+      fail(_pointer, "must be a number");
+    }
+    return _value.get<f64>();
+  }
+
+  static u64 count(const nlohmann::json& _value,
+                   const std::string& _pointer) {
+    if (!_value.is_number_unsigned()) {
+      fail(_pointer, "must be a non-negative integer");
+    }
+    return _value.get<u64>();
+  }
+
+  static std::string escape(const std::string& _token) {
+    std::string escaped;
+    for (char c : _token) {
+      if (c == '~') {
+        escaped += "~0";
+      } else if (c == '/') {
+        escaped += "~1";
+      } else {
+        escaped += c;
+      }
+    }
+    return escaped;
+  }
+
+  [[noreturn]] static void fail(const std::string& _pointer,
+                                const std::string& _message) {
+    throw Error("invalid schema at \"" + _pointer + "\": " + _message);
+  }
+
+  const nlohmann::json& root_;
+  std::vector<Schema::Node>* nodes_;
+  std::unordered_map<std::string, u32> references_;
+  std::vector<std::string> pointers_;  // of each node
+};
+
+// Returns the type mask of a settings value. Typed arrays and generator
+// expressions are arrays. Floats with integral values are also integers.
+static u32 valueType(const nlohmann::json& _value);
+
+// Returns the name of the type of a settings value.
+static const char* typeName(u32 _type);
+
+// Returns the element of a typed array.
+static nlohmann::json typedElement(const void* _data, ElementType _type,
+                                   u64 _index);
+
+// Returns the number of code points of a UTF-8 string.
+static u64 codePoints(const std::string& _str);
+
+/*** public functions below here ***/
+
+Schema::Schema(const nlohmann::json& _schema) {
+  SchemaCompiler compiler(_schema, &nodes_);
+  compiler.compileRoot();
+}
+
+Schema::~Schema() {}
+
+bool Schema::validate(const nlohmann::json& _settings,
+                      std::vector<Violation>* _violations) const {
+  return visit(0, _settings, {nullptr, nullptr, 0}, _violations);
+}
+
+void Schema::check(const nlohmann::json& _settings) const {
+  std::vector<Violation> violations;
+  if (validate(_settings, &violations)) {
+    return;
+  }
+  std::string message = "settings don't match the schema:";
+  for (const Violation& violation : violations) {
+    message += "\n  " + (violation.path.empty() ? "(root)" : violation.path) +
+               ": " + violation.message;
+  }
+  throw Error(message);
+}
+
+u64 Schema::size() const {
+  return nodes_.size();
+}
+
+/*** private functions below here ***/
+
+bool Schema::visit(u32 _node, const nlohmann::json& _value,
+                   const Location& _location,
+                   std::vector<Violation>* _violations) const {
+  const Node& node = nodes_[_node];
+  if (node.never) {
+    _violations->push_back({pointer(_location), "no value is allowed"});
+    return false;
+  }
+
+  bool valid = true;
+  if (node.ref != NONE) {
+    valid &= visit(node.ref, _value, _location, _violations);
+  }
+
+  // Type dependent keywords aren't checked after a type mismatch.
+  u32 type = valueType(_value);
+  if (node.types != 0 && (node.types & type) == 0) {
+    std::string expected;
+    for (u32 bit = 1; bit <= OBJECT_TYPE; bit <<= 1) {
+      if ((node.types & bit) != 0 && !(bit == INTEGER_TYPE &&
+                                       (node.types & NUMBER_TYPE) != 0)) {
+        expected += expected.empty() ? "" : " or ";
+        expected += typeName(bit);
+      }
+    }
+    _violations->push_back(
+        {pointer(_location),
+         "expected " + expected + ", found " + typeName(type)});
+    return false;
+  }
+
+  if (node.has_enum) {
+    bool found = false;
+    for (const nlohmann::json& option : node.enums) {
+      if (option == _value) {
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      _violations->push_back(
+          {pointer(_location), "value isn't one of the enum values"});
+      valid = false;
+    }
+  }
+  if (node.has_const && node.constant != _value) {
+    _violations->push_back({pointer(_location), "value isn't the constant " +
+                                                    node.constant.dump()});
+    valid = false;
+  }
+
+  if (_value.is_number()) {
+    f64 number = _value.get<f64>();
+    if (node.has_minimum && (node.minimum_exclusive ? number <= node.minimum
+                                                    : number < node.minimum)) {
+      _violations->push_back(
+          {pointer(_location), _value.dump() + " is less than the minimum " +
+                       nlohmann::json(node.minimum).dump()});
+      valid = false;
+    }
+    if (node.has_exclusive_minimum && number <= node.exclusive_minimum) {
+      _violations->push_back(
+          {pointer(_location),
+           _value.dump() + " isn't greater than the exclusive minimum " +
+               nlohmann::json(node.exclusive_minimum).dump()});
+      valid = false;
+    }
+    if (node.has_maximum && (node.maximum_exclusive ? number >= node.maximum
+                                                    : number > node.maximum)) {
+      _violations->push_back(
+          {pointer(_location), _value.dump() + " is greater than the maximum " +
+                       nlohmann::json(node.maximum).dump()});
+      valid = false;
+    }
+    if (node.has_exclusive_maximum && number >= node.exclusive_maximum) {
+      _violations->push_back(
+          {pointer(_location),
+           _value.dump() + " isn't less than the exclusive maximum " +
+               nlohmann::json(node.exclusive_maximum).dump()});
+      valid = false;
+    }
+    if (node.multiple_of > 0.0) {
+      f64 quotient = number / node.multiple_of;
+      if (std::fabs(quotient - std::round(quotient)) > 1e-9) {
+        _violations->push_back(
+            {pointer(_location), _value.dump() + " isn't a multiple of " +
+                         nlohmann::json(node.multiple_of).dump()});
+        valid = false;
+      }
+    }
+  } else if (type == STRING_TYPE) {
+    const std::string& str = _value.get_ref<const std::string&>();
+    if (node.min_length > 0 ||
+        node.max_length != std::numeric_limits<u64>::max()) {
+      u64 length = codePoints(str);
+      if (length < node.min_length || length > node.max_length) {
+        _violations->push_back(
+            {pointer(_location),
+             "length " + std::to_string(length) + " is out of range"});
+        valid = false;
+      }
+    }
+    if (node.has_pattern && !std::regex_search(str, node.pattern)) {
+      _violations->push_back(
+          {pointer(_location),
+           "string doesn't match the pattern " + node.pattern_text});
+      valid = false;
+    }
+  } else if (type == ARRAY_TYPE) {
+    valid &= visitArray(node, _value, _location, _violations);
+  } else if (type == OBJECT_TYPE) {
+    valid &= visitObject(node, _value, _location, _violations);
+  }
+
+  for (u32 sub : node.all_of) {
+    valid &= visit(sub, _value, _location, _violations);
+  }
+  if (!node.any_of.empty() || !node.one_of.empty() || node.negated != NONE) {
+    // Violations of alternatives are only reported as a whole.
+    std::vector<Violation> ignored;
+    bool any = node.any_of.empty();
+    for (u32 sub : node.any_of) {
+      if (visit(sub, _value, _location, &ignored)) {
+        any = true;
+        break;
+      }
+    }
+    if (!any) {
+      _violations->push_back(
+          {pointer(_location), "value doesn't match any of anyOf"});
+      valid = false;
+    }
+    if (!node.one_of.empty()) {
+      u64 matches = 0;
+      for (u32 sub : node.one_of) {
+        matches += visit(sub, _value, _location, &ignored) ? 1 : 0;
+      }
+      if (matches != 1) {
+        _violations->push_back({pointer(_location), "value matches " +
+                                            std::to_string(matches) +
+                                            " of oneOf, expected 1"});
+        valid = false;
+      }
+    }
+    if (node.negated != NONE &&
+        visit(node.negated, _value, _location, &ignored)) {
+      _violations->push_back(
+          {pointer(_location), "value matches the schema of not"});
+      valid = false;
+    }
+  }
+  return valid;
+}
+
+bool Schema::visitArray(const Node& _node, const nlohmann::json& _value,
+                        const Location& _location,
+                        std::vector<Violation>* _violations) const {
+  // Typed arrays are read in place and generators are never materialized
+  // unless checking uniqueness.
+  const void* data = nullptr;
+  ElementType element_type = ElementType::U8;
+  u64 size;
+  std::unique_ptr<Sequence> sequence;
+  if (_value.is_array()) {
+    size = _value.size();
+  } else if (_value.is_binary()) {
+    element_type = typedArrayType(_value);
+    data = typedArrayData(_value, element_type, &size);
+  } else {
+    sequence.reset(new Sequence(_value));
+    size = sequence->size();
+  }
+
+  bool valid = true;
+  if (size < _node.min_items || size > _node.max_items) {
+    _violations->push_back(
+        {pointer(_location), std::to_string(size) + " items is out of range"});
+    valid = false;
+  }
+
+  if (_node.items != NONE || _node.unique_items) {
+    std::set<nlohmann::json> seen;
+    for (u64 idx = 0; idx < size; idx++) {
+      nlohmann::json temp;
+      const nlohmann::json* element;
+      if (_value.is_array()) {
+        element = &_value[idx];
+      } else if (data != nullptr) {
+        temp = typedElement(data, element_type, idx);
+        element = &temp;
+      } else {
+        temp = (*sequence)[idx];
+        element = &temp;
+      }
+      if (_node.unique_items && !seen.insert(*element).second) {
+        _violations->push_back(
+            {pointer(_location),
+             "item " + std::to_string(idx) + " isn't unique"});
+        valid = false;
+      }
+      if (_node.items != NONE) {
+        valid &= visit(_node.items, *element, {&_location, nullptr, idx},
+                       _violations);
+      }
+    }
+  }
+  return valid;
+}
+
+bool Schema::visitObject(const Node& _node, const nlohmann::json& _value,
+                         const Location& _location,
+                         std::vector<Violation>* _violations) const {
+  bool valid = true;
+  if (_value.size() < _node.min_properties ||
+      _value.size() > _node.max_properties) {
+    _violations->push_back(
+        {pointer(_location),
+         std::to_string(_value.size()) + " properties is out of range"});
+    valid = false;
+  }
+  for (const std::string& name : _node.required) {
+    if (_value.find(name) == _value.end()) {
+      _violations->push_back(
+          {pointer(_location), "missing required property \"" + name + "\""});
+      valid = false;
+    }
+  }
+
+  if (_node.properties.empty() && _node.additional == NONE) {
+    return valid;
+  }
+  for (auto it = _value.cbegin(); it != _value.cend(); ++it) {
+    u32 sub = _node.additional;
+    auto prop = _node.properties.find(it.key());
+    if (prop != _node.properties.end()) {
+      sub = prop->second;
+    }
+    if (sub == NONE) {
+      continue;
+    }
+    Location child = {&_location, &it.key(), 0};
+    if (nodes_[sub].never) {
+      _violations->push_back({pointer(child), "property isn't allowed"});
+      valid = false;
+    } else {
+      valid &= visit(sub, it.value(), child, _violations);
+    }
+  }
+  return valid;
+}
+
+std::string Schema::pointer(const Location& _location) {
+  std::vector<const Location*> chain;
+  for (const Location* loc = &_location; loc->parent != nullptr;
+       loc = loc->parent) {
+    chain.push_back(loc);
+  }
+  std::string path;
+  for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+    path.push_back('/');
+    if ((*it)->key == nullptr) {
+      path.append(std::to_string((*it)->index));
+      continue;
+    }
+    for (char c : *(*it)->key) {
+      if (c == '~') {
+        path.append("~0");
+      } else if (c == '/') {
+        path.append("~1");
+      } else {
+        path.push_back(c);
+      }
+    }
+  }
+  return path;
+}
+
+/*** static functions below here ***/
+
+static u32 valueType(const nlohmann::json& _value) {
+  switch (_value.type()) {
+    case nlohmann::json::value_t::null:
+      return NULL_TYPE;
+    case nlohmann::json::value_t::boolean:
+      return BOOLEAN_TYPE;
+    case nlohmann::json::value_t::number_integer:
+    case nlohmann::json::value_t::number_unsigned:
+      return INTEGER_TYPE | NUMBER_TYPE;
+    case nlohmann::json::value_t::number_float: {
+      f64 value = _value.get<f64>();
+      return std::isfinite(value) && std::trunc(value) == value
+                 ? INTEGER_TYPE | NUMBER_TYPE
+                 : NUMBER_TYPE;
+    }
+    case nlohmann::json::value_t::string:
+      return isGenerator(_value) ? ARRAY_TYPE : STRING_TYPE;
+    case nlohmann::json::value_t::array:
+      return ARRAY_TYPE;
+    case nlohmann::json::value_t::object:
+      return OBJECT_TYPE;
+    case nlohmann::json::value_t::binary:
+      return isTypedArray(_value) ? static_cast<u32>(ARRAY_TYPE) : 0u;
+    default:
+      return 0;
+  }
+}
+
+static const char* typeName(u32 _type) {
+  if ((_type & INTEGER_TYPE) != 0) {
+    return "integer";
+  }
+  switch (_type) {
+    case NULL_TYPE:
+      return "null";
+    case BOOLEAN_TYPE:
+      return "boolean";
+    case NUMBER_TYPE:
+      return "number";
+    case STRING_TYPE:
+      return "string";
+    case ARRAY_TYPE:
+      return "array";
+    case OBJECT_TYPE:
+      return "object";
+    default:
+      return "binary";
+  }
+}
+
+static nlohmann::json typedElement(const void* _data, ElementType _type,
+                                   u64 _index) {
+  switch (_type) {
+    case ElementType::U8:
+      return static_cast<const u8*>(_data)[_index];
+    case ElementType::S8:
+      return static_cast<const s8*>(_data)[_index];
+    case ElementType::U16:
+      return static_cast<const u16*>(_data)[_index];
+    case ElementType::S16:
+      return static_cast<const s16*>(_data)[_index];
+    case ElementType::U32:
+      return static_cast<const u32*>(_data)[_index];
+    case ElementType::S32:
+      return static_cast<const s32*>(_data)[_index];
+    case ElementType::U64:
+      return static_cast<const u64*>(_data)[_index];
+    case ElementType::S64:
+      return static_cast<const s64*>(_data)[_index];
+    case ElementType::F32:
+      return static_cast<const f32*>(_data)[_index];
+    case ElementType::F64:
+      return static_cast<const f64*>(_data)[_index];
+  }
+  return nullptr;
+}
+
+static u64 codePoints(const std::string& _str) {
+  u64 count = 0;
+  for (char c : _str) {
+    if ((static_cast<u8>(c) & 0xc0) != 0x80) {
+      count++;
+    }
+  }
+  return count;
+}
+
+}  // namespace settings
@@ -0,0 +1,104 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SETTINGS_SCHEMA_H_
+#define SETTINGS_SCHEMA_H_
+
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "prim/prim.h"
+
+namespace settings {
+
+// This is a JSON Schema validator for resolved settings. The schema is
+// compiled once and each validation is a single traversal of the settings
+// that reports every violation.
+//
+// These keywords are supported (all others are rejected):
+//   type, enum, const,
+//   minimum, maximum, exclusiveMinimum, exclusiveMaximum, multipleOf,
+//   minLength, maxLength, pattern,
+//   items (a single schema), minItems, maxItems, uniqueItems,
+//   properties, required, additionalProperties, minProperties, maxProperties,
+//   allOf, anyOf, oneOf, not,
+//   $ref (local, e.g. "#/definitions/name" or "#/$defs/name"),
+//   definitions, $defs, $schema, $id, $comment, title, description, default,
+//   examples, format (ignored)
+// Typed arrays (see settings/sidecar.h) and lazy generator expressions (see
+// settings/generator.h) are validated as arrays.
+class Schema {
+ public:
+  // This is a violation of the schema.
+  struct Violation {
+    std::string path;  // JSON pointer (RFC 6901) of the settings value
+    std::string message;
+  };
+
+  // this compiles the schema
+  //  throws settings::Error if the schema is invalid or unsupported
+  explicit Schema(const nlohmann::json& _schema);
+  ~Schema();
+
+  // this validates the settings and appends all violations
+  //  returns true if the settings are valid
+  bool validate(const nlohmann::json& _settings,
+                std::vector<Violation>* _violations) const;
+
+  // this validates the settings
+  //  throws settings::Error listing all violations upon failure
+  void check(const nlohmann::json& _settings) const;
+
+  // this returns the number of compiled schema nodes
+  u64 size() const;
+
+ private:
+  struct Node;
+  struct Location;
+  friend class SchemaCompiler;
+
+  bool visit(u32 _node, const nlohmann::json& _value,
+             const Location& _location,
+             std::vector<Violation>* _violations) const;
+  bool visitArray(const Node& _node, const nlohmann::json& _value,
+                  const Location& _location,
+                  std::vector<Violation>* _violations) const;
+  bool visitObject(const Node& _node, const nlohmann::json& _value,
+                   const Location& _location,
+                   std::vector<Violation>* _violations) const;
+  static std::string pointer(const Location& _location);
+
+  std::vector<Node> nodes_;
+};
+
+}  // namespace settings
+
+#endif  // SETTINGS_SCHEMA_H_
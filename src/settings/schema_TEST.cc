@@ -0,0 +1,227 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/schema.h"
+
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+#include "settings/settings.h"
+#include "settings/sidecar.h"
+
+static const char* kSchema = R"({
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "type": "object",
+  "required": ["name", "routers"],
+  "additionalProperties": false,
+  "properties": {
+    "name": {"type": "string", "minLength": 1, "pattern": "^[a-z_]+$"},
+    "seed": {"type": "integer", "minimum": 0},
+    "mode": {"enum": ["fast", "slow"]},
+    "rate": {"type": "number", "exclusiveMinimum": 0, "maximum": 1},
+    "ports": {"type": "array", "items": {"type": "integer", "maximum": 63},
+              "uniqueItems": true},
+    "routers": {"type": "array", "minItems": 1,
+                "items": {"$ref": "#/definitions/router"}}
+  },
+  "definitions": {
+    "router": {
+      "type": "object",
+      "required": ["radix"],
+      "properties": {
+        "radix": {"type": "integer", "multipleOf": 2},
+        "child": {"anyOf": [{"type": "null"}, {"$ref": "#/definitions/router"}]}
+      }
+    }
+  }
+})";
+
+TEST(Schema, valid) {
+  settings::Schema schema(nlohmann::json::parse(kSchema));
+  nlohmann::json settings = nlohmann::json::parse(R"({
+    "name": "torus", "seed": 3, "mode": "fast", "rate": 1.0,
+    "ports": [0, 1, 2, 63],
+    "routers": [{"radix": 16, "child": {"radix": 4, "child": null}}]
+  })");
+  std::vector<settings::Schema::Violation> violations;
+  ASSERT_TRUE(schema.validate(settings, &violations));
+  ASSERT_TRUE(violations.empty());
+  schema.check(settings);
+
+  // Floats with integral values are integers.
+  settings["seed"] = 4.0;
+  ASSERT_TRUE(schema.validate(settings, &violations));
+}
+
+TEST(Schema, violations) {
+  settings::Schema schema(nlohmann::json::parse(kSchema));
+  nlohmann::json settings = nlohmann::json::parse(R"({
+    "name": "Torus", "seed": -1, "mode": "medium", "rate": 0,
+    "ports": [0, 64, 0],
+    "routers": [{"radix": 15}, {"child": {"radix": "4"}}],
+    "extra": true
+  })");
+
+  // All violations are reported in traversal order.
+  std::vector<settings::Schema::Violation> violations;
+  ASSERT_FALSE(schema.validate(settings, &violations));
+  std::vector<std::string> paths;
+  for (const settings::Schema::Violation& violation : violations) {
+    paths.push_back(violation.path);
+  }
+  ASSERT_EQ(paths, std::vector<std::string>(
+                       {"/extra", "/mode", "/name", "/ports/1", "/ports",
+                        "/rate", "/routers/0/radix", "/routers/1",
+                        "/routers/1/child", "/seed"}));
+  ASSERT_EQ(violations.at(0).message, "property isn't allowed");
+  ASSERT_EQ(violations.at(7).message, "missing required property \"radix\"");
+
+  try {
+    schema.check(settings);
+    FAIL();
+  } catch (settings::Error& e) {
+    std::string message = e.what();
+    ASSERT_NE(message.find("/routers/0/radix"), std::string::npos);
+    ASSERT_NE(message.find("/seed"), std::string::npos);
+  }
+
+  violations.clear();
+  ASSERT_FALSE(schema.validate(nlohmann::json::parse("[]"), &violations));
+  ASSERT_EQ(violations.size(), 1u);
+  ASSERT_EQ(violations.at(0).path, "");
+  ASSERT_EQ(violations.at(0).message, "expected object, found array");
+}
+
+TEST(Schema, arrays) {
+  settings::Schema schema(nlohmann::json::parse(
+      R"({"type": "array", "maxItems": 100,
+          "items": {"type": "integer", "minimum": 0}})"));
+  std::vector<settings::Schema::Violation> violations;
+
+  // Generators and typed arrays are validated as arrays.
+  ASSERT_TRUE(schema.validate("$%(range(0,100))%$", &violations));
+  ASSERT_FALSE(schema.validate("$%(range(-1,100))%$", &violations));
+  ASSERT_EQ(violations.size(), 2u);
+  ASSERT_EQ(violations.at(0).path, "");
+  ASSERT_EQ(violations.at(1).path, "/0");
+
+  std::vector<s32> elements = {0, 5, -3};
+  violations.clear();
+  ASSERT_FALSE(schema.validate(
+      settings::makeTypedArray(elements.data(), elements.size()),
+      &violations));
+  ASSERT_EQ(violations.size(), 1u);
+  ASSERT_EQ(violations.at(0).path, "/2");
+}
+
+TEST(Schema, bounds) {
+  auto valid = [](const settings::Schema& _schema, f64 _value) {
+    std::vector<settings::Schema::Violation> violations;
+    return _schema.validate(nlohmann::json(_value), &violations);
+  };
+
+  // Inclusive and exclusive bounds apply together regardless of key order.
+  for (const char* text :
+       {R"({"exclusiveMinimum": 10, "minimum": 5})",
+        R"({"minimum": 5, "exclusiveMinimum": 10})"}) {
+    settings::Schema schema(nlohmann::json::parse(text));
+    ASSERT_FALSE(valid(schema, 6)) << text;
+    ASSERT_FALSE(valid(schema, 10)) << text;
+    ASSERT_TRUE(valid(schema, 11)) << text;
+  }
+  for (const char* text :
+       {R"({"exclusiveMinimum": 0, "minimum": 5})",
+        R"({"minimum": 5, "exclusiveMinimum": 0})"}) {
+    settings::Schema schema(nlohmann::json::parse(text));
+    ASSERT_TRUE(valid(schema, 5)) << text;
+    ASSERT_FALSE(valid(schema, 4)) << text;
+  }
+  for (const char* text :
+       {R"({"exclusiveMaximum": 10, "maximum": 15})",
+        R"({"maximum": 15, "exclusiveMaximum": 10})"}) {
+    settings::Schema schema(nlohmann::json::parse(text));
+    ASSERT_FALSE(valid(schema, 12)) << text;
+    ASSERT_TRUE(valid(schema, 9)) << text;
+  }
+
+  // Draft 4 boolean exclusiveMinimum modifies minimum.
+  settings::Schema draft4(nlohmann::json::parse(
+      R"({"exclusiveMinimum": true, "minimum": 5})"));
+  ASSERT_FALSE(valid(draft4, 5));
+  ASSERT_TRUE(valid(draft4, 6));
+}
+
+TEST(Schema, invalid) {
+  for (const char* text :
+       {"3", R"({"type": "float"})", R"({"minimum": "0"})",
+        R"({"items": [{"type": "integer"}]})", R"({"$ref": "other.json#"})",
+        R"({"$ref": "#/definitions/missing"})", R"({"pattern": "("})",
+        R"({"required": [1]})", R"({"unknownKeyword": 1})",
+        R"({"anyOf": []})", R"({"$ref": "#"})",
+        R"({"definitions": {"a": {"$ref": "#/definitions/a"}},
+            "$ref": "#/definitions/a"})",
+        R"({"definitions": {"a": {"not": {"$ref": "#/definitions/b"}},
+                            "b": {"allOf": [{"$ref": "#/definitions/a"}]}},
+            "items": {"$ref": "#/definitions/a"}})"}) {
+    ASSERT_THROW(settings::Schema(nlohmann::json::parse(text)),
+                 settings::Error)
+        << text;
+  }
+  settings::Schema recursive(
+      nlohmann::json::parse(R"({"items": {"$ref": "#"}})"));
+  ASSERT_EQ(recursive.size(), 2u);
+  std::vector<settings::Schema::Violation> violations;
+  ASSERT_TRUE(recursive.validate(nlohmann::json::parse("[[[]], []]"),
+                                 &violations));
+}
+
+TEST(Schema, load) {
+  const char* filename = "TEST_settings.json";
+  FILE* fp = fopen(filename, "w");
+  assert(fp != NULL);
+  fprintf(fp, "%s", "{\"name\": \"mesh\", \"routers\": [{\"radix\": 8}]}");
+  fclose(fp);
+
+  settings::Schema schema(nlohmann::json::parse(kSchema));
+  nlohmann::json settings;
+  settings::LoadOptions options;
+  options.schema = &schema;
+  settings::load(filename, {"/seed=uint=7"}, &settings, nullptr, options);
+  ASSERT_EQ(settings["seed"].get<u64>(), 7u);
+  ASSERT_THROW(settings::load(filename, {"/seed=int=-7", "/rate=float=2"},
+                              &settings, nullptr, options),
+               settings::Error);
+
+  assert(remove(filename) == 0);
+}
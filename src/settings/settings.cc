@@ -30,20 +30,40 @@
  */
 #include "settings/settings.h"
 
+#include <dirent.h>
+#include <glob.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cctype>
 #include <cstdarg>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <exception>
 #include <fstream>  // NOLINT
 #include <iomanip>
+#include <iterator>
 #include <memory>
 #include <queue>
 #include <sstream>
 #include <stack>
+#include <thread>  // NOLINT
+#include <type_traits>
 #include <unordered_set>
+#include <utility>
 
 #include "fio/InFile.h"
 #include "fio/OutFile.h"
+#include "settings/compress.h"
+#include "settings/format.h"
+#include "settings/generator.h"
+#include "settings/pool.h"
+#include "settings/projection.h"
+#include "settings/schema.h"
+#include "settings/sidecar.h"
 #include "strop/strop.h"
 
 namespace settings {
@@ -52,6 +72,47 @@ namespace settings {
 // This blocks against infinite recursion.
 static const u32 MAX_INCLUSION_DEPTH = 100;
 
+// This defines the maximum number of references copied into one another
+// (i.e., a reference within a copied value or a chain of references). This
+// blocks against circular references.
+static const u32 MAX_REFERENCE_DEPTH = 100;
+
+// This is the minimum estimated text printed by each toString() thread.
+static const u64 MIN_PRINT_CHUNK_BYTES = 256 * 1024;
+
+// This is a parsed template file with the locations of its "$@(...)@$"
+// substitution sites and their parameter names.
+struct Template {
+  nlohmann::json settings;
+  Origins origins;
+  std::vector<std::pair<nlohmann::json::json_pointer, std::string>> sites;
+};
+
+// This is a piece of the pretty-printed settings: the text of containers
+// split across chunks, a value, or a run of values within a container
+// (including their separators and keys), printed at an indentation.
+struct PrintChunk {
+  std::string text;
+  const nlohmann::json* value = nullptr;
+  bool run = false;
+  nlohmann::json::const_iterator first;
+  nlohmann::json::const_iterator last;
+  u64 indent = 0;
+};
+
+// This holds the state shared by all steps of a single load.
+struct Context {
+  IncludeCache* cache = nullptr;
+  // generator expressions are kept as strings instead of expanded
+  bool lazy = false;
+  // templates are parsed once per load
+  mutable std::mutex template_lock;
+  mutable std::unordered_map<std::string, std::shared_ptr<const Template>>
+      templates;
+  // threads loading file sets, which nested file sets share
+  mutable std::atomic<u32> threads{0};
+};
+
 // Prints the usage ("-h" or "--help") message.
 static void usage(const char* _exe, const char* _error);
 
@@ -59,52 +120,259 @@ static void usage(const char* _exe, const char* _error);
 static std::string dirname(const std::string& _path);
 static std::string join(const std::string& _a, const std::string& _b);
 
-// Loads the JSON::Value represented in the file.
+// Loads the JSON::Value represented in the file, using the include cache if
+// there is one.
 // Recursively performs file inclusion.
-// Error prints and exit(-1) upon failure.
+// Throws settings::Error upon failure.
 static void fileToJson(const std::string& _config, nlohmann::json* _settings,
-                       u32 _recursion_depth);
+                       u32 _recursion_depth, Origins* _origins,
+                       const Context& _ctx);
+
+// Returns the include cache key of a file, which is its canonical path marked
+// with how generators are expanded.
+static std::string cacheKey(const std::string& _config, const Context& _ctx);
+
+// Loads an included file, which is instantiated as a template if it has
+// parameters (i.e., "file?name=value&..."). The file is relative to _cwd
+// unless _cwd is empty. The source is the file and its parameters.
+// Throws settings::Error upon failure.
+static void includeToJson(const std::string& _spec, const std::string& _cwd,
+                          nlohmann::json* _settings, u32 _recursion_depth,
+                          Origins* _origins, const Context& _ctx,
+                          std::string* _source);
+
+// Returns true if the included file is a directory, or a glob pattern (i.e.,
+// contains '*' or "[...]") that isn't the name of a regular file.
+static bool isFileSet(const std::string& _filepath);
+
+// Reserves up to _wanted of the threads a load may use to load file sets
+// concurrently (one per hardware thread). Returns the number reserved, which
+// are released by subtracting them from the context.
+static u32 reserveThreads(const Context& _ctx, u64 _wanted);
+
+// Loads the regular files matching the glob pattern, or in the directory,
+// concurrently. The files are instantiated as templates if there are
+// parameters. The result is an object keyed by file stem, or an array in file
+// name order if _array is true.
+// Throws settings::Error upon failure.
+static void fileSetToJson(const std::string& _filepath,
+                          const std::string& _params, bool _array,
+                          nlohmann::json* _settings, u32 _recursion_depth,
+                          Origins* _origins, const Context& _ctx);
+
+// Instantiates the template file with the parameters.
+// Throws settings::Error upon failure.
+static void templateToJson(const std::string& _config,
+                           const std::string& _params,
+                           nlohmann::json* _settings, u32 _recursion_depth,
+                           Origins* _origins, const Context& _ctx);
+
+// Finds the "$@(...)@$" substitution sites of a template.
+static void findSites(
+    const nlohmann::json& _settings, const std::string& _path,
+    std::vector<std::pair<nlohmann::json::json_pointer, std::string>>* _sites);
+
+// Reads and loads the JSON::Value represented in the file.
+// Recursively performs file inclusion.
+// Throws settings::Error upon failure.
+static void readFileToJson(const std::string& _config,
+                           nlohmann::json* _settings, u32 _recursion_depth,
+                           Origins* _origins, const Context& _ctx);
+
+// Reads and parses the JSON file without performing file inclusion.
+// Compressed files are decompressed while parsing. Binary files (see
+// settings/format.h) are detected by extension or magic bytes.
+// Throws settings::Error upon failure.
+static void parseFile(const std::string& _config, nlohmann::json* _settings);
+
+// Returns true if the byte may start JSON text.
+static bool isTextLead(s32 _byte);
+
+// Parses the JSON string without performing file inclusion.
+// Throws settings::Error upon failure.
+static void parseJson(const std::string& _config, const std::string& _filename,
+                      nlohmann::json* _settings);
 
 // Loads the JSON::Value represented by the string.
 // Recursively performs file inclusion.
-// Error prints and exit(-1) upon failure.
+// Throws settings::Error upon failure.
 static void stringToJson(const std::string& _config, nlohmann::json* _settings,
                          const std::string& _filename, const std::string& _cwd,
-                         u32 _recursion_depth);
+                         u32 _recursion_depth, Origins* _origins,
+                         const Context& _ctx);
 
-// This replaces "$$(...)$$" references with file JSON contents.
+// This replaces "$$(...)$$" references with file JSON contents (templates are
+// instantiated and file sets are loaded concurrently), "$#(...)#$" references
+// with sidecar typed arrays, and "$%(...)%$" generator expressions with arrays
+// (unless lazy).
 static void processInclusions(const std::string& _cwd,
-                              nlohmann::json* _settings, u32 _recursion_depth);
+                              nlohmann::json* _settings, u32 _recursion_depth,
+                              Origins* _origins, const Context& _ctx);
+
+// Loads only the selected subtrees of the file (see settings/projection.h).
+// Inclusions are only loaded within or on the way to selected subtrees.
+// Compressed and binary files are loaded whole and pruned.
+// Throws settings::Error upon failure.
+static void projectFile(const std::string& _config,
+                        const Projection& _projection,
+                        nlohmann::json* _settings, u32 _recursion_depth,
+                        const Context& _ctx);
+
+// Loads the selected subtrees of a partially selected "$$(...)$$" inclusion.
+// Other strings (e.g., sidecars and generators) are expanded as a full load
+// would and pruned.
+// Throws settings::Error upon failure.
+static void projectInclusion(const std::string& _cwd,
+                             const Projection& _projection,
+                             nlohmann::json* _settings, u32 _recursion_depth,
+                             const Context& _ctx);
+
+// This appends the targets of the "$&(...)&$" references in the settings.
+static void findTargets(const nlohmann::json& _settings,
+                        std::vector<std::string>* _targets);
+
+// This appends the targets of the references a settings update produces
+// (i.e., "ref" updates and "string" updates that are references).
+static void updateTargets(const std::string& _update,
+                          std::vector<std::string>* _targets);
+
+// This adds the top-level keys of the targets. A target that is the whole
+// settings sets _all.
+static void targetKeys(const std::vector<std::string>& _targets,
+                       std::unordered_set<std::string>* _keys, bool* _all);
 
 // This replaces "$&(...)&$" reference with nlohmann::json contents.
-static void processReferences(nlohmann::json* _settings);
+static void processReferences(nlohmann::json* _settings, Origins* _origins);
+
+// This replaces references the same as processReferences() using _threads
+// threads. References are copied once their targets are final, so independent
+// references are copied concurrently. Returns false without modifying the
+// settings if the references need the serial semantics (i.e., a target that
+// doesn't exist yet or that is within a referenced value).
+// Throws settings::Error upon circular references.
+static bool processReferencesParallel(nlohmann::json* _settings, u32 _threads);
+
+// This returns true if the value is or contains the other value.
+static bool containsValue(const nlohmann::json& _settings,
+                          const nlohmann::json* _value);
+
+// This returns true if the settings contain any "$&(...)&$" reference.
+static bool hasReferences(const nlohmann::json& _settings);
 
 // This applies command line updates to the current settings.
 // This will perform inclusions but not references.
 static void applyUpdates(nlohmann::json* _settings,
-                         const std::vector<std::string>& _updates, bool _debug);
+                         const std::vector<std::string>& _updates, bool _debug,
+                         Origins* _origins, const Context& _ctx);
+
+// This checks that the elements of a generated update match the update type.
+// Throws settings::Error upon failure.
+static void checkSequence(const Sequence& _sequence,
+                          const std::string& _type,
+                          const std::string& _update);
+
+// This returns the top-level key an update modifies.
+// Returns false if the update might modify the entire settings.
+static bool updateKey(const std::string& _update, std::string* _key);
+
+// Utilities for recording origins.
+static std::string pointerToken(const std::string& _key);
+static void eraseOrigins(Origins* _origins, const std::string& _path);
+static void mergeOrigins(Origins* _origins, const std::string& _path,
+                         const std::string& _source, const Origins& _inner);
 
 // This is a debug printer utility for printing debug info.
 static void dprintf(bool _debug, const char* _format, ...);
 
+// This throws a settings::Error with a printf style message.
+[[noreturn]] static void error(const char* _format, ...);
+
+// This error prints and exit(-1).
+[[noreturn]] static void fail(const Error& _error);
+
+// This estimates the bytes consumed by a heap allocation of the given size.
+static u64 allocBytes(u64 _size);
+
+// This estimates the bytes of the printed settings and records the estimates
+// of containers of at least MIN_PRINT_CHUNK_BYTES.
+static u64 printBytes(const nlohmann::json& _settings,
+                      std::unordered_map<const nlohmann::json*, u64>* _heavy);
+
+// This splits the printing of the settings into chunks of about _target
+// bytes by printing the containers of heavier values directly.
+static void planChunks(
+    const nlohmann::json& _settings, u64 _indent, u64 _target,
+    const std::unordered_map<const nlohmann::json*, u64>& _heavy,
+    std::vector<PrintChunk>* _chunks);
+
+// This prints the value or run of a chunk into its text.
+static void printChunk(PrintChunk* _chunk);
+
+// This appends the value printed the same as nlohmann::json::dump() at the
+// indentation.
+static void printValue(const nlohmann::json& _value, u64 _indent,
+                       std::string* _text);
+
+
+// This converts a string to a number for settings updates.
+// Throws settings::Error upon failure.
+template <typename T>
+static T toNumber(const std::string& _str, const std::string& _type);
+
 /*** public functions below here ***/
 
-void initFile(const std::string& _config_file, nlohmann::json* _settings) {
-  // Parses the file into JSON.
-  fileToJson(_config_file, _settings, 1);
-  // Process all references.
-  processReferences(_settings);
+void initFile(const std::string& _config_file, nlohmann::json* _settings,
+              Origins* _origins) {
+  try {
+    // Parses the file into JSON.
+    fileToJson(_config_file, _settings, 1, _origins, Context());
+    // Process all references.
+    processReferences(_settings, _origins);
+  } catch (Error& e) {
+    fail(e);
+  }
 }
 
-void initString(const std::string& _config_str, nlohmann::json* _settings) {
-  // Parses the string into JSON.
-  stringToJson(_config_str, _settings, "", ".", 1);
-  // Process all references.
-  processReferences(_settings);
+void initString(const std::string& _config_str, nlohmann::json* _settings,
+                Origins* _origins) {
+  try {
+    // Parses the string into JSON.
+    stringToJson(_config_str, _settings, "", ".", 1, _origins, Context());
+    // Process all references.
+    processReferences(_settings, _origins);
+  } catch (Error& e) {
+    fail(e);
+  }
 }
 
-void commandLine(s32 _argc, const char* const* _argv,
-                 nlohmann::json* _settings) {
+void commandLine(s32 _argc, const char* const* _argv, nlohmann::json* _settings,
+                 Origins* _origins) {
+  // Parses the command line.
+  std::string config_file;
+  std::vector<std::string> settings_updates;
+  bool debug;
+  parseCommandLine(_argc, _argv, &config_file, &settings_updates, &debug);
+
+  try {
+    // Parses the file into JSON.
+    Context ctx;
+    dprintf(debug, "beginning parsing of JSON file %s\n", config_file.c_str());
+    fileToJson(config_file, _settings, 1, _origins, ctx);
+    dprintf(debug, "parsing of JSON file %s complete\n", config_file.c_str());
+
+    // Applies settings updates.
+    applyUpdates(_settings, settings_updates, debug, _origins, ctx);
+
+    // Processes. all references.
+    processReferences(_settings, _origins);
+  } catch (Error& e) {
+    fail(e);
+  }
+}
+
+void parseCommandLine(s32 _argc, const char* const* _argv,
+                      std::string* _config_file,
+                      std::vector<std::string>* _updates, bool* _debug) {
   assert(_argc > 0);
 
   // Scan for:
@@ -129,48 +397,411 @@ void commandLine(s32 _argc, const char* const* _argv,
     }
   }
   dprintf(debug, "first non-flag location is %i\n", first);
+  if (_debug != nullptr) {
+    *_debug = debug;
+  }
 
-  // Creates a settings object.
+  // Gets the settings file.
   if (_argc <= first) {
     usage(_argv[0], "Please specify a settings file\n");
     exit(-1);
   }
-  std::string config_file = _argv[first];
-
-  // Parses the file into JSON.
-  dprintf(debug, "beginning parsing of JSON file %s\n", config_file.c_str());
-  fileToJson(config_file, _settings, 1);
-  dprintf(debug, "parsing of JSON file %s complete\n", config_file.c_str());
+  *_config_file = _argv[first];
 
   // Reads in settings updates.
-  std::vector<std::string> settings_updates;
+  _updates->clear();
   for (s64 arg = first + 1; arg < _argc; arg++) {
     std::string update(_argv[arg]);
     dprintf(debug, "adding update: %s\n", update.c_str());
-    settings_updates.push_back(update);
+    _updates->push_back(update);
   }
+}
 
-  // Applies settings updates.
-  applyUpdates(_settings, settings_updates, debug);
+void load(const std::string& _config_file,
+          const std::vector<std::string>& _updates, nlohmann::json* _settings,
+          Origins* _origins, const LoadOptions& _options) {
+  Context ctx;
+  ctx.cache = _options.cache;
+  ctx.lazy = _options.lazy_generators;
+  fileToJson(_config_file, _settings, 1, _origins, ctx);
+  applyUpdates(_settings, _updates, false, _origins, ctx);
+  resolveReferences(_settings, _origins, _options.threads);
+  if (_options.schema != nullptr) {
+    _options.schema->check(*_settings);
+  }
+}
 
-  // Processes. all references.
-  processReferences(_settings);
+void resolveReferences(nlohmann::json* _settings, Origins* _origins,
+                       u32 _threads) {
+  if (_threads != 1 && _origins == nullptr &&
+      processReferencesParallel(_settings, _threads)) {
+    return;
+  }
+  processReferences(_settings, _origins);
 }
 
-std::string toString(const nlohmann::json& _settings) {
-  std::ostringstream ss;
-  ss << std::setw(2) << _settings << std::endl;
-  return ss.str();
+void parseUpdate(const std::string& _update, std::string* _pointer,
+                 nlohmann::json* _value) {
+  // Applies the update to empty settings and extracts the value.
+  nlohmann::json scratch;
+  applyUpdates(&scratch, {_update}, false, nullptr, Context());
+  nlohmann::json::json_pointer ptr(_update.substr(0, _update.find('=')));
+  *_pointer = ptr.to_string();
+
+  // Each "-" token appended the only element of a new array.
+  std::string at = *_pointer;
+  for (u64 pos = at.find("/-"); pos != std::string::npos;
+       pos = at.find("/-", pos + 1)) {
+    if (pos + 2 == at.size() || at[pos + 2] == '/') {
+      at[pos + 1] = '0';
+    }
+  }
+  try {
+    *_value = std::move(scratch.at(nlohmann::json::json_pointer(at)));
+  } catch (nlohmann::json::exception& e) {
+    error("update \"%s\" caused a failure:\n%s", _update.c_str(), e.what());
+  }
+  if (hasReferences(*_value)) {
+    error("references aren't supported in this update: %s", _update.c_str());
+  }
 }
 
-void writeToFile(const nlohmann::json& _settings,
-                 const std::string& _config_file) {
-  std::string text = toString(_settings);
-  fio::OutFile::Status sts = fio::OutFile::writeFile(_config_file, text);
-  if (sts != fio::OutFile::Status::OK) {
-    fprintf(stderr, "Settings error: couldn't write to file %s\n",
+void loadIncrementally(const std::string& _config_file,
+                       const std::vector<std::string>& _updates,
+                       nlohmann::json* _settings, Origins* _origins,
+                       IncludeCache* _cache,
+                       const std::function<void(const std::string&)>& _ready,
+                       bool _debug) {
+  Context ctx;
+  ctx.cache = _cache;
+
+  // Parses the file without inclusions.
+  dprintf(_debug, "beginning parsing of JSON file %s\n", _config_file.c_str());
+  parseFile(_config_file, _settings);
+
+  // Only objects have top-level subtrees to make ready early.
+  if (!_settings->is_object()) {
+    processInclusions(dirname(_config_file), _settings, 1, _origins, ctx);
+    dprintf(_debug, "parsing of JSON file %s complete\n",
             _config_file.c_str());
-    exit(-1);
+    applyUpdates(_settings, _updates, _debug, _origins, ctx);
+    processReferences(_settings, _origins);
+    if (_settings->is_object()) {
+      for (const auto& item : _settings->items()) {
+        _ready(item.key());
+      }
+    }
+    return;
+  }
+
+  // Finds the top-level subtrees modified by updates, and those targeted by
+  //  the references of the file and of the updates.
+  bool update_all = false;
+  std::unordered_set<std::string> updated;
+  for (const std::string& update : _updates) {
+    std::string key;
+    if (updateKey(update, &key)) {
+      updated.insert(key);
+    } else {
+      update_all = true;
+    }
+  }
+  bool target_all = false;
+  std::unordered_set<std::string> targeted;
+  std::vector<std::string> targets;
+  findTargets(*_settings, &targets);
+  for (const std::string& update : _updates) {
+    updateTargets(update, &targets);
+  }
+  targetKeys(targets, &targeted, &target_all);
+
+  // Performs inclusions one top-level subtree at a time. Subtrees that won't
+  //  be modified by updates or references are ready right away. References
+  //  found in included files hold back the subtrees they target.
+  std::unordered_set<std::string> ready;
+  for (auto& item : _settings->items()) {
+    // The subtree is moved into its own object so that it is processed
+    //  exactly as it would be within the top-level object.
+    nlohmann::json subtree = nlohmann::json::object();
+    subtree[item.key()] = std::move(item.value());
+    processInclusions(dirname(_config_file), &subtree, 1, _origins, ctx);
+    item.value() = std::move(subtree[item.key()]);
+
+    targets.clear();
+    findTargets(item.value(), &targets);
+    targetKeys(targets, &targeted, &target_all);
+    if (!update_all && updated.count(item.key()) == 0 && targets.empty() &&
+        !target_all && targeted.count(item.key()) == 0) {
+      ready.insert(item.key());
+      _ready(item.key());
+    }
+  }
+  dprintf(_debug, "parsing of JSON file %s complete\n", _config_file.c_str());
+
+  // Applies updates, then finds all targets. References found after a
+  //  subtree is ready only read it, so their targets must exist.
+  applyUpdates(_settings, _updates, _debug, _origins, ctx);
+  if (!_settings->is_object()) {
+    processReferences(_settings, _origins);
+    return;
+  }
+  targets.clear();
+  findTargets(*_settings, &targets);
+  targetKeys(targets, &targeted, &target_all);
+  for (const std::string& target : targets) {
+    std::vector<std::string> tokens;
+    try {
+      tokens = pointerTokens(target);
+    } catch (Error& e) {
+      continue;  // reported while resolving references
+    }
+    if (!tokens.empty() && ready.count(tokens.front()) > 0 &&
+        !_settings->contains(nlohmann::json::json_pointer(target))) {
+      error("reference \"%s\" targets a missing value of a ready subtree",
+            target.c_str());
+    }
+  }
+
+  // Makes ready the subtrees neither containing nor targeted by references.
+  for (const auto& item : _settings->items()) {
+    if (ready.count(item.key()) == 0 && !target_all &&
+        targeted.count(item.key()) == 0 && !hasReferences(item.value())) {
+      ready.insert(item.key());
+      _ready(item.key());
+    }
+  }
+
+  // Processes all references, then makes ready the remaining subtrees
+  //  (including missing targets that were created).
+  processReferences(_settings, _origins);
+  for (const auto& item : _settings->items()) {
+    if (ready.count(item.key()) == 0) {
+      _ready(item.key());
+    }
+  }
+}
+
+IncludeCache::IncludeCache(bool _record_origins)
+    : record_origins_(_record_origins) {}
+
+IncludeCache::~IncludeCache() {}
+
+bool IncludeCache::recordOrigins() const {
+  return record_origins_;
+}
+
+std::shared_ptr<const IncludeCache::File> IncludeCache::find(
+    const std::string& _file) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  auto it = files_.find(_file);
+  return it != files_.end() ? it->second : nullptr;
+}
+
+std::shared_ptr<const IncludeCache::File> IncludeCache::insert(
+    const std::string& _file, std::shared_ptr<const File> _contents) {
+  std::lock_guard<std::mutex> lock(lock_);
+  // The first insertion wins when several threads loaded the same file.
+  return files_.emplace(_file, _contents).first->second;
+}
+
+u64 IncludeCache::size() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return files_.size();
+}
+
+void IncludeCache::clear() {
+  std::lock_guard<std::mutex> lock(lock_);
+  files_.clear();
+}
+
+void loadProjection(const std::string& _config_file,
+                    const std::vector<std::string>& _prefixes,
+                    nlohmann::json* _settings, IncludeCache* _cache) {
+  Context ctx;
+  ctx.cache = _cache;
+  Projection projection(_prefixes);
+  projectFile(_config_file, projection, _settings, 1, ctx);
+
+  // Fetches the targets of references that aren't loaded, which may hold more
+  //  references, one projected load per round.
+  Projection loaded = projection;
+  std::vector<std::string> targets;
+  findTargets(*_settings, &targets);
+  while (!targets.empty()) {
+    Projection fetch;
+    std::vector<std::string> fetched;
+    for (const std::string& target : targets) {
+      if (!loaded.covers(target)) {
+        loaded.add(target);
+        fetch.add(target);
+        fetched.push_back(target);
+      }
+    }
+    targets.clear();
+    if (fetched.empty()) {
+      break;
+    }
+    nlohmann::json values;
+    projectFile(_config_file, fetch, &values, 1, ctx);
+    for (const std::string& target : fetched) {
+      nlohmann::json::json_pointer ptr(target);
+      if (!values.contains(ptr)) {
+        continue;  // reported while resolving references
+      }
+      try {
+        nlohmann::json& value = (*_settings)[ptr];
+        value = values[ptr];
+        findTargets(value, &targets);
+      } catch (nlohmann::json::exception& e) {
+        error("couldn't fetch reference target \"%s\":\n%s", target.c_str(),
+              e.what());
+      }
+    }
+  }
+
+  processReferences(_settings, nullptr);
+  projection.prune(_settings);
+}
+
+std::string toString(const nlohmann::json& _settings, u32 _threads) {
+  if (_threads == 0) {
+    _threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  std::unordered_map<const nlohmann::json*, u64> heavy;
+  u64 bytes = _threads > 1 ? printBytes(_settings, &heavy) : 0;
+  if (bytes < 2 * MIN_PRINT_CHUNK_BYTES) {
+    std::ostringstream ss;
+    ss << std::setw(2) << _settings << std::endl;
+    return ss.str();
+  }
+
+  // Prints chunks of a few per thread concurrently.
+  u64 target = std::max(MIN_PRINT_CHUNK_BYTES, bytes / (4 * _threads));
+  std::vector<PrintChunk> chunks(1);
+  planChunks(_settings, 0, target, heavy, &chunks);
+  chunks.back().text += '\n';
+  std::vector<std::exception_ptr> failures(chunks.size());
+  {
+    ThreadPool pool(
+        std::max<u64>(1, std::min<u64>(_threads, chunks.size() / 2)));
+    for (u64 idx = 0; idx < chunks.size(); idx++) {
+      if (chunks[idx].value != nullptr) {
+        PrintChunk* chunk = &chunks[idx];
+        std::exception_ptr* failure = &failures[idx];
+        pool.run([chunk, failure] {
+          try {
+            printChunk(chunk);
+          } catch (...) {
+            *failure = std::current_exception();
+          }
+        });
+      }
+    }
+    pool.wait();
+  }
+  for (const std::exception_ptr& failure : failures) {
+    if (failure != nullptr) {
+      std::rethrow_exception(failure);
+    }
+  }
+
+  // Joins the chunks in order.
+  u64 size = 0;
+  for (const PrintChunk& chunk : chunks) {
+    size += chunk.text.size();
+  }
+  std::string text;
+  text.reserve(size);
+  for (PrintChunk& chunk : chunks) {
+    text += chunk.text;
+    std::string().swap(chunk.text);
+  }
+  return text;
+}
+
+void writeToFile(const nlohmann::json& _settings,
+                 const std::string& _config_file, s32 _level, u32 _threads,
+                 u64 _sidecar_threshold) {
+  try {
+    save(_settings, _config_file, _level, _threads, _sidecar_threshold);
+  } catch (Error& e) {
+    fail(e);
+  }
+}
+
+void save(const nlohmann::json& _settings, const std::string& _config_file,
+          s32 _level, u32 _threads, u64 _sidecar_threshold) {
+  Format format = extensionFormat(_config_file);
+  if (format != Format::JSON) {
+    // Binary formats hold typed arrays inline.
+    writeCompressed(_config_file, encode(_settings, format), _level,
+                    _threads);
+  } else if (_sidecar_threshold > 0 || hasTypedArrays(_settings)) {
+    nlohmann::json spilled = _settings;
+    spillSidecars(&spilled, _config_file, _sidecar_threshold);
+    writeCompressed(_config_file, toString(spilled, _threads), _level,
+                    _threads);
+  } else {
+    writeCompressed(_config_file, toString(_settings, _threads), _level,
+                    _threads);
+  }
+}
+
+u64 heapBytes(const nlohmann::json& _settings, bool _recursive) {
+  switch (_settings.type()) {
+    case nlohmann::json::value_t::object: {
+      // std::map allocates one tree node per member.
+      u64 bytes = allocBytes(sizeof(nlohmann::json::object_t));
+      for (auto it = _settings.cbegin(); it != _settings.cend(); ++it) {
+        const std::string& key = it.key();
+        bytes += allocBytes(4 * sizeof(void*) +
+                            sizeof(nlohmann::json::object_t::value_type));
+        if (key.capacity() > 15) {
+          bytes += allocBytes(key.capacity() + 1);
+        }
+        if (_recursive) {
+          bytes += heapBytes(it.value(), true);
+        }
+      }
+      return bytes;
+    }
+
+    case nlohmann::json::value_t::array: {
+      const nlohmann::json::array_t& arr =
+          _settings.get_ref<const nlohmann::json::array_t&>();
+      u64 bytes = allocBytes(sizeof(nlohmann::json::array_t));
+      if (arr.capacity() > 0) {
+        bytes += allocBytes(arr.capacity() * sizeof(nlohmann::json));
+      }
+      if (_recursive) {
+        for (const nlohmann::json& elem : arr) {
+          bytes += heapBytes(elem, true);
+        }
+      }
+      return bytes;
+    }
+
+    case nlohmann::json::value_t::string: {
+      const std::string& str = _settings.get_ref<const std::string&>();
+      u64 bytes = allocBytes(sizeof(std::string));
+      if (str.capacity() > 15) {
+        bytes += allocBytes(str.capacity() + 1);
+      }
+      return bytes;
+    }
+
+    case nlohmann::json::value_t::binary: {
+      const nlohmann::json::binary_t& bin = _settings.get_binary();
+      u64 bytes = allocBytes(sizeof(nlohmann::json::binary_t));
+      if (bin.capacity() > 0) {
+        bytes += allocBytes(bin.capacity());
+      }
+      return bytes;
+    }
+
+    default:
+      // Other values are stored inline.
+      return 0;
   }
 }
 
@@ -204,6 +835,19 @@ static void usage(const char* _exe, const char* _error) {
       "              ### really complex examples ###\n"
       "              /me=file=[a.json,b.json,c.json]\n"
       "              /you=ref=[/me/2,/me/0,/me/1]\n"
+      "              /ports=uint=$%%(range(0,64,2))%%$\n"
+      "\n"
+      "  settings files may include:\n"
+      "              \"$$(other.json)$$\"     settings file\n"
+      "              \"$$(other.json?k=v)$$\" settings template with each\n"
+      "                                     \"$@(k)@$\" replaced by v\n"
+      "              \"$$(dir/*.json)$$\"    object of the matching files (or\n"
+      "                                     a directory) keyed by file stem\n"
+      "              \"$$([dir/*.json])$$\"  array of the matching files\n"
+      "              \"$&(/some/setting)&$\"  reference\n"
+      "              \"$#(table.arr)#$\"      binary sidecar array\n"
+      "              \"$%%(range(0,8,2))%%$\"   generated array [0,2,4,6]\n"
+      "              \"$%%(repeat(1.5,3))%%$\"  generated array [1.5,1.5,1.5]\n"
       "\n",
       _exe);
 }
@@ -226,96 +870,657 @@ static std::string join(const std::string& _a, const std::string& _b) {
 }
 
 static void fileToJson(const std::string& _config, nlohmann::json* _settings,
-                       u32 _recursion_depth) {
+                       u32 _recursion_depth, Origins* _origins,
+                       const Context& _ctx) {
   assert(_recursion_depth <= MAX_INCLUSION_DEPTH);
   if (_recursion_depth == MAX_INCLUSION_DEPTH) {
-    fprintf(stderr,
-            "Settings error: max inclusion depth reached\n"
-            "You likely have an infinite file inclusion cycle\n");
-    exit(-1);
+    error(
+        "max inclusion depth reached\n"
+        "You likely have an infinite file inclusion cycle");
   }
 
-  std::string dir = dirname(_config);
+  // Only included files are cached, the root files of loads aren't kept.
+  if (_ctx.cache == nullptr || _recursion_depth == 1) {
+    readFileToJson(_config, _settings, _recursion_depth, _origins, _ctx);
+    return;
+  }
 
-  // Reads the file into a string.
-  std::string text;
-  fio::InFile::Status sts = fio::InFile::readFile(_config, &text);
-  assert(sts == fio::InFile::Status::OK);
+  // Loads the file through the cache. Concurrent misses on the same file may
+  // both load it, but only one copy is kept.
+  std::string key = cacheKey(_config, _ctx);
+  std::shared_ptr<const IncludeCache::File> file = _ctx.cache->find(key);
+  if (file == nullptr) {
+    std::shared_ptr<IncludeCache::File> loaded =
+        std::make_shared<IncludeCache::File>();
+    readFileToJson(_config, &loaded->settings, _recursion_depth,
+                   _ctx.cache->recordOrigins() ? &loaded->origins : nullptr,
+                   _ctx);
+    file = _ctx.cache->insert(key, loaded);
+  }
+  *_settings = file->settings;
+  if (_origins != nullptr) {
+    *_origins = file->origins;
+  }
+}
+
+static std::string cacheKey(const std::string& _config, const Context& _ctx) {
+  // Lazy loads keep generator expressions, so they don't share entries with
+  // expanding loads. Canonical paths start with '/', so the marker can't clash.
+  std::string key = _ctx.lazy ? "lazy:" : "";
 
-  // Parses the string into JSON.
-  stringToJson(text, _settings, _config, dir, _recursion_depth);
+  // A file that no longer exists (but may be cached) is keyed by its
+  // canonical directory.
+  char* path = realpath(_config.c_str(), nullptr);
+  if (path != nullptr) {
+    key += path;
+  } else {
+    path = realpath(dirname(_config).c_str(), nullptr);
+    if (path == nullptr) {
+      return key + _config;
+    }
+    key = join(key + path, _config.substr(_config.find_last_of('/') + 1));
+  }
+  free(path);
+  return key;
 }
 
-static void stringToJson(const std::string& _config, nlohmann::json* _settings,
-                         const std::string& _filename, const std::string& _cwd,
-                         u32 _recursion_depth) {
-  // Parses the JSON string.
+static void includeToJson(const std::string& _spec, const std::string& _cwd,
+                          nlohmann::json* _settings, u32 _recursion_depth,
+                          Origins* _origins, const Context& _ctx,
+                          std::string* _source) {
+  // A bracketed file set (i.e., "[dir/*.json]") becomes an array.
+  std::string spec = _spec;
+  bool array = false;
+  if (spec.size() > 2 && spec.front() == '[' && spec.back() == ']') {
+    spec = spec.substr(1, spec.size() - 2);
+    array = true;
+  }
+
+  // Splits the file from the template parameters.
+  size_t query = spec.find_first_of('?');
+  std::string filepath = spec.substr(0, query);
+  if (!_cwd.empty()) {
+    filepath = join(_cwd, filepath);
+  }
+
+  if (array || isFileSet(filepath)) {
+    std::string params =
+        query == std::string::npos ? "" : spec.substr(query + 1);
+    *_source = query == std::string::npos ? filepath : filepath + '?' + params;
+    fileSetToJson(filepath, params, array, _settings, _recursion_depth,
+                  _origins, _ctx);
+  } else if (query == std::string::npos) {
+    *_source = filepath;
+    fileToJson(filepath, _settings, _recursion_depth, _origins, _ctx);
+  } else {
+    std::string params = spec.substr(query + 1);
+    *_source = filepath + '?' + params;
+    templateToJson(filepath, params, _settings, _recursion_depth, _origins,
+                   _ctx);
+  }
+}
+
+static bool isFileSet(const std::string& _filepath) {
+  struct stat st;
+  if (stat(_filepath.c_str(), &st) == 0) {
+    return S_ISDIR(st.st_mode);
+  }
+  return _filepath.find_first_of("*[") != std::string::npos ||
+         (!_filepath.empty() && _filepath.back() == '/');
+}
+
+static u32 reserveThreads(const Context& _ctx, u64 _wanted) {
+  u32 limit = std::max(1u, std::thread::hardware_concurrency());
+  u32 used = _ctx.threads.load();
+  u32 reserved;
+  do {
+    reserved = used < limit ? std::min<u64>(_wanted, limit - used) : 0;
+  } while (reserved > 0 &&
+           !_ctx.threads.compare_exchange_weak(used, used + reserved));
+  return reserved;
+}
+
+static void fileSetToJson(const std::string& _filepath,
+                          const std::string& _params, bool _array,
+                          nlohmann::json* _settings, u32 _recursion_depth,
+                          Origins* _origins, const Context& _ctx) {
+  // Finds the regular files.
+  std::vector<std::string> files;
+  struct stat st;
+  if (stat(_filepath.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+    DIR* dir = opendir(_filepath.c_str());
+    if (dir == nullptr) {
+      error("couldn't read directory %s", _filepath.c_str());
+    }
+    while (struct dirent* entry = readdir(dir)) {
+      if (entry->d_name[0] != '.') {
+        files.push_back(join(_filepath, entry->d_name));
+      }
+    }
+    closedir(dir);
+  } else {
+    glob_t matches;
+    s32 sts = glob(_filepath.c_str(), GLOB_NOSORT, nullptr, &matches);
+    if (sts != 0 && sts != GLOB_NOMATCH) {
+      globfree(&matches);
+      error("couldn't match files %s", _filepath.c_str());
+    }
+    for (u64 idx = 0; idx < matches.gl_pathc; idx++) {
+      files.push_back(matches.gl_pathv[idx]);
+    }
+    globfree(&matches);
+    if (files.empty() && _filepath.find_first_of("*[") == std::string::npos) {
+      error("couldn't read file %s", _filepath.c_str());
+    }
+  }
+  files.erase(std::remove_if(files.begin(), files.end(),
+                             [](const std::string& _file) {
+                               struct stat fst;
+                               return stat(_file.c_str(), &fst) != 0 ||
+                                      !S_ISREG(fst.st_mode);
+                             }),
+              files.end());
+  std::sort(files.begin(), files.end());
+
+  // Loads the files concurrently. The first failure in file order is thrown.
+  std::vector<nlohmann::json> loaded(files.size());
+  std::vector<Origins> suborigins(files.size());
+  std::vector<std::string> failures(files.size());
+  auto load = [&](u64 _idx) {
+    try {
+      Origins* origins = _origins != nullptr ? &suborigins[_idx] : nullptr;
+      if (_params.empty()) {
+        fileToJson(files[_idx], &loaded[_idx], _recursion_depth, origins,
+                   _ctx);
+      } else {
+        templateToJson(files[_idx], _params, &loaded[_idx], _recursion_depth,
+                       origins, _ctx);
+      }
+    } catch (Error& e) {
+      failures[_idx] = e.what();
+    }
+  };
+  //  Nested file sets share the threads of the load, and are loaded serially
+  //  once all are in use.
+  u32 threads = files.size() > 1 ? reserveThreads(_ctx, files.size()) : 0;
+  if (threads > 1) {
+    {
+      ThreadPool pool(threads);
+      for (u64 idx = 0; idx < files.size(); idx++) {
+        pool.run([&load, idx]() { load(idx); });
+      }
+      pool.wait();
+    }
+    _ctx.threads -= threads;
+  } else {
+    _ctx.threads -= threads;
+    for (u64 idx = 0; idx < files.size(); idx++) {
+      load(idx);
+    }
+  }
+  for (const std::string& failure : failures) {
+    if (!failure.empty()) {
+      throw Error(failure);
+    }
+  }
+
+  // Assembles the files in order.
+  *_settings = _array ? nlohmann::json::array() : nlohmann::json::object();
+  if (_origins != nullptr) {
+    _origins->clear();
+  }
+  for (u64 idx = 0; idx < files.size(); idx++) {
+    std::string token;
+    if (_array) {
+      token = std::to_string(idx);
+      _settings->push_back(std::move(loaded[idx]));
+    } else {
+      // The stem excludes the directory, a compressed extension, and the last
+      //  extension.
+      std::string stem = files[idx].substr(files[idx].find_last_of('/') + 1);
+      for (const char* compressed : {".gz", ".zst"}) {
+        size_t len = strlen(compressed);
+        if (stem.size() > len &&
+            stem.compare(stem.size() - len, len, compressed) == 0) {
+          stem.resize(stem.size() - len);
+          break;
+        }
+      }
+      size_t dot = stem.find_last_of('.');
+      if (dot != std::string::npos && dot > 0) {
+        stem.resize(dot);
+      }
+      if (_settings->contains(stem)) {
+        error("duplicate file stem \"%s\" in %s", stem.c_str(),
+              _filepath.c_str());
+      }
+      token = pointerToken(stem);
+      (*_settings)[stem] = std::move(loaded[idx]);
+    }
+    if (_origins != nullptr) {
+      mergeOrigins(_origins, '/' + token, files[idx], suborigins[idx]);
+    }
+  }
+}
+
+static void templateToJson(const std::string& _config,
+                           const std::string& _params,
+                           nlohmann::json* _settings, u32 _recursion_depth,
+                           Origins* _origins, const Context& _ctx) {
+  // Parses the template and finds its sites once per load.
+  std::shared_ptr<const Template> tmpl;
+  {
+    std::lock_guard<std::mutex> lock(_ctx.template_lock);
+    auto it = _ctx.templates.find(_config);
+    if (it != _ctx.templates.end()) {
+      tmpl = it->second;
+    }
+  }
+  if (tmpl == nullptr) {
+    std::shared_ptr<Template> parsed = std::make_shared<Template>();
+    fileToJson(_config, &parsed->settings, _recursion_depth,
+               _origins != nullptr ? &parsed->origins : nullptr, _ctx);
+    findSites(parsed->settings, "", &parsed->sites);
+    std::lock_guard<std::mutex> lock(_ctx.template_lock);
+    tmpl = _ctx.templates.emplace(_config, parsed).first->second;
+  }
+
+  // Parses the parameters. Values are JSON, or strings otherwise.
+  std::map<std::string, nlohmann::json> values;
+  for (const std::string& param : strop::split(_params, '&')) {
+    size_t equals = param.find_first_of('=');
+    if (equals == std::string::npos || equals == 0) {
+      error("invalid template parameter \"%s\" for %s", param.c_str(),
+            _config.c_str());
+    }
+    std::string text = param.substr(equals + 1);
+    nlohmann::json value = nlohmann::json::parse(text, nullptr, false);
+    if (value.is_discarded()) {
+      value = text;
+    }
+    values[param.substr(0, equals)] = std::move(value);
+  }
+
+  // Instantiates the template by patching only its sites.
+  *_settings = tmpl->settings;
+  std::unordered_set<std::string> used;
+  for (const auto& site : tmpl->sites) {
+    auto it = values.find(site.second);
+    if (it == values.end()) {
+      error("missing template parameter \"%s\" for %s", site.second.c_str(),
+            _config.c_str());
+    }
+    (*_settings)[site.first] = it->second;
+    used.insert(site.second);
+  }
+  for (const auto& value : values) {
+    if (used.count(value.first) == 0) {
+      error("unknown template parameter \"%s\" for %s", value.first.c_str(),
+            _config.c_str());
+    }
+  }
+  if (_origins != nullptr) {
+    *_origins = tmpl->origins;
+  }
+}
+
+static void findSites(
+    const nlohmann::json& _settings, const std::string& _path,
+    std::vector<std::pair<nlohmann::json::json_pointer, std::string>>* _sites) {
+  if (_settings.is_string()) {
+    const std::string& str = _settings.get_ref<const std::string&>();
+    if ((str.size() > 6) && (str.compare(0, 3, "$@(") == 0) &&
+        (str.compare(str.size() - 3, 3, ")@$") == 0)) {
+      _sites->emplace_back(nlohmann::json::json_pointer(_path),
+                           str.substr(3, str.size() - 6));
+    }
+  } else if (_settings.is_object()) {
+    for (const auto& item : _settings.items()) {
+      findSites(item.value(), _path + '/' + pointerToken(item.key()), _sites);
+    }
+  } else if (_settings.is_array()) {
+    for (u64 idx = 0; idx < _settings.size(); idx++) {
+      findSites(_settings[idx], _path + '/' + std::to_string(idx), _sites);
+    }
+  }
+}
+
+static void readFileToJson(const std::string& _config,
+                           nlohmann::json* _settings, u32 _recursion_depth,
+                           Origins* _origins, const Context& _ctx) {
+  // Parses the file into JSON.
+  parseFile(_config, _settings);
+
+  // Performs JSON inclusions.
+  processInclusions(dirname(_config), _settings, _recursion_depth, _origins,
+                    _ctx);
+}
+
+static void parseFile(const std::string& _config, nlohmann::json* _settings) {
+  Compression compression = fileCompression(_config);
+  Format format = extensionFormat(_config);
+  std::string data;
+  if (compression == Compression::NONE) {
+    // Reads the file into a string.
+    fio::InFile::Status sts = fio::InFile::readFile(_config, &data);
+    if (sts != fio::InFile::Status::OK) {
+      error("couldn't read file %s", _config.c_str());
+    }
+  } else {
+    std::unique_ptr<std::istream> stream =
+        openDecompressed(_config, compression);
+    if (format == Format::JSON && isTextLead(stream->peek())) {
+      // Parses the decompressed stream into JSON.
+      try {
+        *(_settings) = nlohmann::json::parse(*stream);
+      } catch (nlohmann::json::parse_error& e) {
+        error("failed to parse JSON file:%s\n%s", _config.c_str(), e.what());
+      }
+      return;
+    }
+
+    // Reads the decompressed binary file into a string.
+    data.assign(std::istreambuf_iterator<char>(*stream),
+                std::istreambuf_iterator<char>());
+  }
+
+  if (format == Format::JSON) {
+    format = dataFormat(data);
+  }
+  if (format == Format::JSON) {
+    // Parses the string into JSON.
+    parseJson(data, _config, _settings);
+  } else {
+    try {
+      decode(data, format, _settings);
+    } catch (Error& e) {
+      error("failed to parse %s file:%s\n%s", formatName(format),
+            _config.c_str(), e.what());
+    }
+  }
+}
+
+static bool isTextLead(s32 _byte) {
+  // Includes whitespace and the UTF-8 byte order mark.
+  return _byte == EOF || isspace(_byte) || _byte == 0xef ||
+         (_byte != 0 && strchr("{[\"-0123456789tfn", _byte) != nullptr);
+}
+
+static void parseJson(const std::string& _config, const std::string& _filename,
+                      nlohmann::json* _settings) {
   try {
     *(_settings) = nlohmann::json::parse(_config);
   } catch (nlohmann::json::parse_error& e) {
-    if (_filename == "") {
-      fprintf(stderr, "Settings error: failed to parse JSON file:%s\n%s",
-              _filename.c_str(), e.what());
+    if (_filename != "") {
+      error("failed to parse JSON file:%s\n%s", _filename.c_str(), e.what());
     } else {
-      fprintf(stderr, "Settings error: failed to parse JSON string:\n%s\n%s",
-              _config.c_str(), e.what());
+      error("failed to parse JSON string:\n%s\n%s", _config.c_str(),
+            e.what());
     }
-    exit(-1);
   }
+}
+
+static void stringToJson(const std::string& _config, nlohmann::json* _settings,
+                         const std::string& _filename, const std::string& _cwd,
+                         u32 _recursion_depth, Origins* _origins,
+                         const Context& _ctx) {
+  // Parses the JSON string.
+  parseJson(_config, _filename, _settings);
 
   // Performs JSON inclusions.
-  processInclusions(_cwd, _settings, _recursion_depth);
+  processInclusions(_cwd, _settings, _recursion_depth, _origins, _ctx);
 }
 
 static void processInclusions(const std::string& _cwd,
-                              nlohmann::json* _settings, u32 _recursion_depth) {
+                              nlohmann::json* _settings, u32 _recursion_depth,
+                              Origins* _origins, const Context& _ctx) {
   // Performs inclusion processing via BFS.
   std::queue<nlohmann::json*> queue;
   queue.push(_settings);
+  // Paths are only tracked when recording origins.
+  std::queue<std::string> paths;
+  if (_origins != nullptr) {
+    paths.push("");
+  }
 
   while (!queue.empty()) {
     nlohmann::json* parent = queue.front();
     queue.pop();
+    std::string parent_path;
+    if (_origins != nullptr) {
+      parent_path = paths.front();
+      paths.pop();
+    }
     for (auto& item : parent->items()) {
       nlohmann::json& child = item.value();
+      std::string child_path;
+      if (_origins != nullptr) {
+        child_path = (&child != parent)
+                         ? parent_path + '/' + pointerToken(item.key())
+                         : parent_path;
+      }
 
       // Checks if an insertion is needed.
       if (child.is_string()) {
         std::string chstr = child.get<std::string>();
         if ((chstr.size() > 6) && (chstr.substr(0, 3) == "$$(") &&
             (chstr.substr(chstr.size() - 3, 3) == ")$$")) {
-          // Extracts the subsettings filepath.
-          std::string filepath = chstr.substr(3, chstr.size() - 6);
-
           // Parses the subsettings.
           nlohmann::json subsettings;
-          fileToJson(join(_cwd, filepath), &subsettings, _recursion_depth + 1);
+          Origins suborigins;
+          std::string source;
+          includeToJson(chstr.substr(3, chstr.size() - 6), _cwd, &subsettings,
+                        _recursion_depth + 1,
+                        _origins != nullptr ? &suborigins : nullptr, _ctx,
+                        &source);
 
           // Performs insertion.
-          child = subsettings;
+          child = std::move(subsettings);
+          if (_origins != nullptr) {
+            mergeOrigins(_origins, child_path, source, suborigins);
+          }
+        } else if ((chstr.size() > 6) && (chstr.substr(0, 3) == "$#(") &&
+                   (chstr.substr(chstr.size() - 3, 3) == ")#$")) {
+          // Reads the sidecar into a typed array.
+          std::string filepath = join(_cwd, chstr.substr(3, chstr.size() - 6));
+          readSidecar(filepath, &child);
+          if (_origins != nullptr) {
+            mergeOrigins(_origins, child_path, filepath, Origins());
+          }
+        } else if (isGenerator(child)) {
+          // Expands the generator expression, or just validates it if lazy.
+          Sequence sequence(child);
+          if (!_ctx.lazy) {
+            child = sequence.toJson();
+          }
         }
       }
 
-      // Adds item to BFS queue.
+      // Adds item to BFS queue. A primitive is its own only item and may have
+      //  been replaced.
       if (&child != parent) {
         queue.push(&child);
+        if (_origins != nullptr) {
+          paths.push(child_path);
+        }
+      } else {
+        break;
       }
     }
   }
 }
 
-static void processReferences(nlohmann::json* _settings) {
-  // Performs reference processing via BFS.
-  std::queue<nlohmann::json*> queue;
-  queue.push(_settings);
+static void projectFile(const std::string& _config,
+                        const Projection& _projection,
+                        nlohmann::json* _settings, u32 _recursion_depth,
+                        const Context& _ctx) {
+  assert(_recursion_depth <= MAX_INCLUSION_DEPTH);
+  if (_recursion_depth == MAX_INCLUSION_DEPTH) {
+    error(
+        "max inclusion depth reached\n"
+        "You likely have an infinite file inclusion cycle");
+  }
+
+  if (_projection.all() || fileCompression(_config) != Compression::NONE ||
+      extensionFormat(_config) != Format::JSON) {
+    fileToJson(_config, _settings, _recursion_depth, nullptr, _ctx);
+    _projection.prune(_settings);
+    return;
+  }
+
+  // Reads the file into a string.
+  std::string text;
+  fio::InFile::Status sts = fio::InFile::readFile(_config, &text);
+  if (sts != fio::InFile::Status::OK) {
+    error("couldn't read file %s", _config.c_str());
+  }
+  if (dataFormat(text) != Format::JSON) {
+    fileToJson(_config, _settings, _recursion_depth, nullptr, _ctx);
+    _projection.prune(_settings);
+    return;
+  }
+
+  // Parses the selected values and performs their inclusions. Failures of
+  //  inclusions are rethrown as they are.
+  std::string cwd = dirname(_config);
+  std::exception_ptr inclusion;
+  try {
+    parseProjected(
+        text, _projection, _settings,
+        [&](const Projection& _selected, nlohmann::json* _value) {
+          try {
+            if (_selected.all()) {
+              processInclusions(cwd, _value, _recursion_depth, nullptr, _ctx);
+            } else {
+              projectInclusion(cwd, _selected, _value, _recursion_depth, _ctx);
+            }
+          } catch (Error& e) {
+            inclusion = std::current_exception();
+            throw;
+          }
+        });
+  } catch (Error& e) {
+    if (inclusion != nullptr) {
+      std::rethrow_exception(inclusion);
+    }
+    error("failed to parse JSON file:%s\n%s", _config.c_str(), e.what());
+  }
+}
+
+static void projectInclusion(const std::string& _cwd,
+                             const Projection& _projection,
+                             nlohmann::json* _settings, u32 _recursion_depth,
+                             const Context& _ctx) {
+  const std::string& str = _settings->get_ref<const std::string&>();
+  if ((str.size() <= 6) || (str.compare(0, 3, "$$(") != 0) ||
+      (str.compare(str.size() - 3, 3, ")$$") != 0)) {
+    processInclusions(_cwd, _settings, _recursion_depth, nullptr, _ctx);
+    _projection.prune(_settings);
+    return;
+  }
+
+  // Only plain files are projected, templates and file sets are pruned. File
+  //  sets are detected the same as by includeToJson().
+  std::string spec = str.substr(3, str.size() - 6);
+  std::string filepath = join(_cwd, spec);
+  if ((spec.size() > 2 && spec.front() == '[' && spec.back() == ']') ||
+      spec.find_first_of('?') != std::string::npos || isFileSet(filepath)) {
+    std::string source;
+    includeToJson(spec, _cwd, _settings, _recursion_depth + 1, nullptr, _ctx,
+                  &source);
+    _projection.prune(_settings);
+  } else {
+    projectFile(filepath, _projection, _settings, _recursion_depth + 1, _ctx);
+  }
+}
+
+static void findTargets(const nlohmann::json& _settings,
+                        std::vector<std::string>* _targets) {
+  if (_settings.is_string()) {
+    const std::string& str = _settings.get_ref<const std::string&>();
+    if ((str.size() > 6) && (str.compare(0, 3, "$&(") == 0) &&
+        (str.compare(str.size() - 3, 3, ")&$") == 0)) {
+      _targets->push_back(str.substr(3, str.size() - 6));
+    }
+  } else if (_settings.is_structured()) {
+    for (const auto& child : _settings) {
+      findTargets(child, _targets);
+    }
+  }
+}
+
+static void updateTargets(const std::string& _update,
+                          std::vector<std::string>* _targets) {
+  size_t first = _update.find_first_of('=');
+  size_t second = _update.find_first_of('=', first + 1);
+  if (first == std::string::npos || second == std::string::npos) {
+    return;  // reported while applying updates
+  }
+  std::string type = _update.substr(first + 1, second - first - 1);
+  std::string value = _update.substr(second + 1);
+  std::vector<std::string> elems;
+  if (value.size() >= 2 && value.front() == '[' && value.back() == ']') {
+    elems = strop::split(value.substr(1, value.size() - 2), ',');
+  } else {
+    elems.push_back(value);
+  }
+  for (const std::string& elem : elems) {
+    if (type == "ref") {
+      _targets->push_back(elem);
+    } else if (type == "string") {
+      findTargets(elem, _targets);
+    }
+  }
+}
+
+static void targetKeys(const std::vector<std::string>& _targets,
+                       std::unordered_set<std::string>* _keys, bool* _all) {
+  for (const std::string& target : _targets) {
+    std::vector<std::string> tokens;
+    try {
+      tokens = pointerTokens(target);
+    } catch (Error& e) {
+      continue;  // reported while resolving references
+    }
+    if (tokens.empty()) {
+      *_all = true;
+    } else {
+      _keys->insert(tokens.front());
+    }
+  }
+}
+
+static void processReferences(nlohmann::json* _settings, Origins* _origins) {
+  // Performs reference processing via BFS. Each value tracks the number of
+  //  references copied into its ancestors and itself.
+  std::queue<std::pair<nlohmann::json*, u32>> queue;
+  queue.push({_settings, 0});
+  // Paths are only tracked when recording origins.
+  std::queue<std::string> paths;
+  if (_origins != nullptr) {
+    paths.push("");
+  }
 
   while (!queue.empty()) {
-    nlohmann::json* parent = queue.front();
+    nlohmann::json* parent = queue.front().first;
+    u32 depth = queue.front().second;
     queue.pop();
+    std::string parent_path;
+    if (_origins != nullptr) {
+      parent_path = paths.front();
+      paths.pop();
+    }
     for (auto& item : parent->items()) {
       nlohmann::json& child = item.value();
+      std::string child_path;
+      if (_origins != nullptr) {
+        child_path = (&child != parent)
+                         ? parent_path + '/' + pointerToken(item.key())
+                         : parent_path;
+      }
 
       // Checks if an insertion is needed.
+      bool inserted = false;
       if (child.is_string()) {
         std::string chstr = child.get<std::string>();
         if ((chstr.size() > 6) && (chstr.substr(0, 3) == "$&(") &&
@@ -326,40 +1531,247 @@ static void processReferences(nlohmann::json* _settings) {
           try {
             ptr = nlohmann::json::json_pointer(path_str);
           } catch (nlohmann::json::parse_error& e) {
-            printf("Pointer specification \"%s\" caused a failure\n:%s\n",
-                   path_str.c_str(), e.what());
-            exit(-1);
+            error("pointer specification \"%s\" caused a failure:\n%s",
+                  path_str.c_str(), e.what());
           }
 
-          // Performs insertion.
-          child = (*_settings)[ptr];
+          // Performs insertion. A target containing the reference never
+          //  resolves.
+          try {
+            // Existing targets are only read (e.g., in subtrees other
+            //  threads read, see loadIncrementally()).
+            nlohmann::json& target = _settings->contains(ptr)
+                                         ? _settings->at(ptr)
+                                         : (*_settings)[ptr];
+            if (depth == MAX_REFERENCE_DEPTH || containsValue(target, &child)) {
+              error("circular reference \"%s\"", path_str.c_str());
+            }
+            child = target;
+          } catch (nlohmann::json::exception& e) {
+            error("reference \"%s\" caused a failure:\n%s", path_str.c_str(),
+                  e.what());
+          }
+          if (_origins != nullptr) {
+            mergeOrigins(_origins, child_path, chstr, Origins());
+          }
+          inserted = true;
         }
       }
 
-      // Adds item to BFS queue.
+      // Adds item to BFS queue. A primitive that was replaced is its own only
+      // item and is queued again since the copy may hold references.
       if (&child != parent) {
-        queue.push(&child);
+        queue.push({&child, inserted ? depth + 1 : depth});
+        if (_origins != nullptr) {
+          paths.push(child_path);
+        }
+      } else if (inserted) {
+        queue.push({&child, depth + 1});
+        if (_origins != nullptr) {
+          paths.push(child_path);
+        }
+        break;
+      }
+    }
+  }
+}
+
+static bool processReferencesParallel(nlohmann::json* _settings,
+                                      u32 _threads) {
+  // Finds all reference sites.
+  struct Site {
+    nlohmann::json* node;
+    std::string path;
+    nlohmann::json::json_pointer target;
+    std::vector<u64> dependents;
+  };
+  std::vector<Site> sites;
+  std::string path;
+  std::function<void(nlohmann::json*)> find = [&](nlohmann::json* _node) {
+    if (_node->is_string()) {
+      const std::string& str = _node->get_ref<const std::string&>();
+      if ((str.size() > 6) && (str.compare(0, 3, "$&(") == 0) &&
+          (str.compare(str.size() - 3, 3, ")&$") == 0)) {
+        sites.push_back({_node, path, nlohmann::json::json_pointer(), {}});
+      }
+    } else if (_node->is_object()) {
+      for (auto& item : _node->items()) {
+        size_t size = path.size();
+        path += '/' + pointerToken(item.key());
+        find(&item.value());
+        path.resize(size);
+      }
+    } else if (_node->is_array()) {
+      for (u64 idx = 0; idx < _node->size(); idx++) {
+        size_t size = path.size();
+        path += '/' + std::to_string(idx);
+        find(&(*_node)[idx]);
+        path.resize(size);
+      }
+    }
+  };
+  find(_settings);
+  if (sites.empty()) {
+    return true;
+  }
+
+  // Checks that all targets already exist. Targets within referenced values
+  // don't exist until references are copied.
+  const nlohmann::json& root = *_settings;
+  for (Site& site : sites) {
+    const std::string& str = site.node->get_ref<const std::string&>();
+    try {
+      site.target = nlohmann::json::json_pointer(str.substr(3, str.size() - 6));
+    } catch (nlohmann::json::parse_error& e) {
+      return false;
+    }
+    if (!root.contains(site.target)) {
+      return false;
+    }
+  }
+
+  // A reference depends on the references within its target. Sorting the
+  // site paths groups the sites within each target.
+  std::vector<u64> order(sites.size());
+  for (u64 idx = 0; idx < sites.size(); idx++) {
+    order[idx] = idx;
+  }
+  std::sort(order.begin(), order.end(), [&](u64 _a, u64 _b) {
+    return sites[_a].path < sites[_b].path;
+  });
+  std::unique_ptr<std::atomic<u64>[]> pending(
+      new std::atomic<u64>[sites.size()]);
+  for (u64 idx = 0; idx < sites.size(); idx++) {
+    pending[idx].store(0, std::memory_order_relaxed);
+  }
+  for (u64 idx = 0; idx < sites.size(); idx++) {
+    std::string target = sites[idx].target.to_string();
+    auto first = std::lower_bound(
+        order.begin(), order.end(), target,
+        [&](u64 _site, const std::string& _target) {
+          return sites[_site].path < _target;
+        });
+    for (auto it = first; it != order.end(); ++it) {
+      const std::string& inner = sites[*it].path;
+      if (inner.compare(0, target.size(), target) != 0) {
+        break;
+      }
+      if (inner.size() == target.size() || inner[target.size()] == '/') {
+        sites[*it].dependents.push_back(idx);
+        pending[idx].fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Checks for circular references before copying anything.
+  std::vector<u64> counts(sites.size());
+  std::vector<u64> ready;
+  for (u64 idx = 0; idx < sites.size(); idx++) {
+    counts[idx] = pending[idx].load(std::memory_order_relaxed);
+    if (counts[idx] == 0) {
+      ready.push_back(idx);
+    }
+  }
+  std::vector<u64> roots = ready;
+  u64 resolvable = 0;
+  while (!ready.empty()) {
+    u64 idx = ready.back();
+    ready.pop_back();
+    resolvable++;
+    for (u64 dependent : sites[idx].dependents) {
+      if (--counts[dependent] == 0) {
+        ready.push_back(dependent);
+      }
+    }
+  }
+  if (resolvable != sites.size()) {
+    for (u64 idx = 0; idx < sites.size(); idx++) {
+      if (counts[idx] > 0) {
+        error("circular reference at \"%s\"", sites[idx].path.c_str());
+      }
+    }
+  }
+
+  // Copies the targets, queueing each dependent reference once all the
+  // references within its target are copied. Tasks must not throw, so
+  // failures are kept per site, which stops its dependents, and rethrown here.
+  std::vector<std::exception_ptr> failures(sites.size());
+  {
+    std::function<void(u64)> copy;  // outlives the pool's tasks
+    ThreadPool pool(_threads);
+    copy = [&](u64 _idx) {
+      try {
+        Site& site = sites[_idx];
+        *site.node = root.at(site.target);
+        for (u64 dependent : site.dependents) {
+          if (pending[dependent].fetch_sub(1, std::memory_order_acq_rel) ==
+              1) {
+            pool.run([&copy, dependent]() { copy(dependent); });
+          }
+        }
+      } catch (...) {
+        failures[_idx] = std::current_exception();
       }
+    };
+    for (u64 idx : roots) {
+      pool.run([&copy, idx]() { copy(idx); });
+    }
+    pool.wait();
+  }
+  for (const std::exception_ptr& failure : failures) {
+    if (failure != nullptr) {
+      std::rethrow_exception(failure);
     }
   }
+  return true;
+}
+
+static bool containsValue(const nlohmann::json& _settings,
+                          const nlohmann::json* _value) {
+  if (&_settings == _value) {
+    return true;
+  }
+  if (_settings.is_structured()) {
+    for (const auto& child : _settings) {
+      if (containsValue(child, _value)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static bool hasReferences(const nlohmann::json& _settings) {
+  if (_settings.is_string()) {
+    const std::string& str = _settings.get_ref<const std::string&>();
+    return (str.size() > 6) && (str.compare(0, 3, "$&(") == 0) &&
+           (str.compare(str.size() - 3, 3, ")&$") == 0);
+  }
+  if (_settings.is_structured()) {
+    for (const auto& child : _settings) {
+      if (hasReferences(child)) {
+        return true;
+      }
+    }
+  }
+  return false;
 }
 
 static void applyUpdates(nlohmann::json* _settings,
-                         const std::vector<std::string>& _updates,
-                         bool _debug) {
+                         const std::vector<std::string>& _updates, bool _debug,
+                         Origins* _origins, const Context& _ctx) {
   for (auto it = _updates.cbegin(); it != _updates.cend(); ++it) {
     // Gets the update string.
     const std::string& update = *it;
     dprintf(_debug, "applying update: %s\n", update.c_str());
 
-    // Splits the update string into symbols.
+    // Splits the update string into symbols. Values may contain '=' (e.g.,
+    // template parameters).
     size_t equalsLoc = update.find_first_of('=');
-    size_t atSymLoc = update.find_last_of('=');
+    size_t atSymLoc = update.find_first_of('=', equalsLoc + 1);
     if ((equalsLoc == std::string::npos) || (atSymLoc == std::string::npos) ||
-        (atSymLoc <= equalsLoc + 1)) {
-      fprintf(stderr, "Settings error: invalid setting update spec: %s\n",
-              update.c_str());
-      exit(-1);
+        (atSymLoc <= equalsLoc + 1) || (atSymLoc + 1 == update.size())) {
+      error("invalid setting update spec: %s", update.c_str());
     }
 
     std::string path_str = update.substr(0, equalsLoc);
@@ -367,7 +1779,9 @@ static void applyUpdates(nlohmann::json* _settings,
         update.substr(equalsLoc + 1, atSymLoc - equalsLoc - 1);
     std::string value_str = update.substr(atSymLoc + 1);
 
-    // Determines if the value is an array type.
+    // Determines if the value is an array type. Generator expressions are
+    // single values that become arrays.
+    bool is_generator = isGenerator(value_str);
     bool is_array = ((value_str.at(0) == '[') &&
                      (value_str.at(value_str.size() - 1) == ']'));
     std::vector<std::string> value_elems;
@@ -382,15 +1796,26 @@ static void applyUpdates(nlohmann::json* _settings,
 
     // Converts all strings to a nlohmann::json array.
     std::vector<nlohmann::json> array(value_elems.size());
+    std::vector<Origins> suborigins(value_elems.size());
+    if (is_generator) {
+      Sequence sequence(value_str);
+      checkSequence(sequence, var_type, update);
+      if (_ctx.lazy) {
+        array[0] = value_str;
+      } else {
+        array[0] = sequence.toJson();
+      }
+      value_elems.clear();
+    }
     for (u32 idx = 0; idx < value_elems.size(); idx++) {
       if (var_type == "int") {
-        const s64 val = std::stoll(value_elems[idx]);
+        const s64 val = toNumber<s64>(value_elems[idx], var_type);
         array[idx] = val;
       } else if (var_type == "uint") {
-        const u64 val = std::stoull(value_elems[idx]);
+        const u64 val = toNumber<u64>(value_elems[idx], var_type);
         array[idx] = val;
       } else if (var_type == "float") {
-        const f64 val = std::stod(value_elems[idx]);
+        const f64 val = toNumber<f64>(value_elems[idx], var_type);
         array[idx] = val;
       } else if (var_type == "string") {
         array[idx] = value_elems[idx];
@@ -400,21 +1825,20 @@ static void applyUpdates(nlohmann::json* _settings,
         } else if (value_elems[idx] == "false" || value_elems[idx] == "0") {
           array[idx] = false;
         } else {
-          fprintf(stderr, "Settings error: invalid bool: %s\n",
-                  value_elems[idx].c_str());
-          exit(-1);
+          error("invalid bool: %s", value_elems[idx].c_str());
         }
       } else if (var_type == "file") {
         nlohmann::json subsettings;
-        fileToJson(value_elems[idx], &subsettings, 2);
-        array[idx] = subsettings;
+        std::string source;
+        includeToJson(value_elems[idx], "", &subsettings, 2,
+                      _origins != nullptr ? &suborigins[idx] : nullptr, _ctx,
+                      &source);
+        array[idx] = std::move(subsettings);
       } else if (var_type == "ref") {
         // Just fake it as a string for now.
         array[idx] = "$&(" + value_elems[idx] + ")&$";
       } else {
-        fprintf(stderr, "Settings error: invalid setting type: %s\n",
-                var_type.c_str());
-        exit(-1);
+        error("invalid setting type: %s", var_type.c_str());
       }
     }
 
@@ -423,19 +1847,279 @@ static void applyUpdates(nlohmann::json* _settings,
     try {
       ptr = nlohmann::json::json_pointer(path_str);
     } catch (nlohmann::json::parse_error& e) {
-      printf("Pointer specification \"%s\" caused a failure\n:%s\n",
-             path_str.c_str(), e.what());
-      exit(-1);
+      error("pointer specification \"%s\" caused a failure:\n%s",
+            path_str.c_str(), e.what());
     }
 
     // Makes the update.
-    if (!is_array) {
-      assert(array.size() == 1u);
-      (*_settings)[ptr] = array[0];
+    try {
+      if (!is_array) {
+        assert(array.size() == 1u);
+        (*_settings)[ptr] = array[0];
+      } else {
+        (*_settings)[ptr] = array;
+      }
+    } catch (nlohmann::json::exception& e) {
+      error("update \"%s\" caused a failure:\n%s", update.c_str(), e.what());
+    }
+
+    // Records the origins of file updates.
+    if (_origins != nullptr) {
+      std::string path = ptr.to_string();
+      eraseOrigins(_origins, path);
+      if (var_type == "file") {
+        for (u32 idx = 0; idx < value_elems.size(); idx++) {
+          mergeOrigins(_origins,
+                       is_array ? path + '/' + std::to_string(idx) : path,
+                       value_elems[idx], suborigins[idx]);
+        }
+      }
+    }
+  }
+}
+
+static void checkSequence(const Sequence& _sequence,
+                          const std::string& _type,
+                          const std::string& _update) {
+  // Elements are homogeneous except for the sign of range elements, so only
+  // the first and last elements are checked.
+  if (_type != "int" && _type != "uint" && _type != "float" &&
+      _type != "string" && _type != "bool") {
+    error("generator expressions aren't supported for %s updates: %s",
+          _type.c_str(), _update.c_str());
+  }
+  for (u64 idx : {static_cast<u64>(0), _sequence.size() - 1}) {
+    if (_sequence.size() == 0) {
+      break;
+    }
+    nlohmann::json element = _sequence[idx];
+    if ((_type == "int" && !element.is_number_integer()) ||
+        (_type == "uint" && !element.is_number_unsigned()) ||
+        (_type == "float" && !element.is_number()) ||
+        (_type == "string" && !element.is_string()) ||
+        (_type == "bool" && !element.is_boolean())) {
+      error("invalid %s generator: %s", _type.c_str(), _update.c_str());
+    }
+  }
+}
+
+static bool updateKey(const std::string& _update, std::string* _key) {
+  // Extracts the first token of the update's JSON pointer.
+  size_t end = _update.find_first_of('=');
+  if (end == std::string::npos || end == 0 || _update[0] != '/') {
+    return false;
+  }
+  size_t slash = _update.find_first_of('/', 1);
+  std::string token = _update.substr(1, std::min(slash, end) - 1);
+
+  // Unescapes per RFC 6901.
+  _key->clear();
+  for (size_t idx = 0; idx < token.size(); idx++) {
+    if (token[idx] == '~' && idx + 1 < token.size() && token[idx + 1] == '1') {
+      *_key += '/';
+      idx++;
+    } else if (token[idx] == '~' && idx + 1 < token.size() &&
+               token[idx + 1] == '0') {
+      *_key += '~';
+      idx++;
     } else {
-      (*_settings)[ptr] = array;
+      *_key += token[idx];
     }
   }
+  return true;
+}
+
+static std::string pointerToken(const std::string& _key) {
+  // Escapes per RFC 6901.
+  if (_key.find_first_of("~/") == std::string::npos) {
+    return _key;
+  }
+  std::string token;
+  for (char c : _key) {
+    if (c == '~') {
+      token += "~0";
+    } else if (c == '/') {
+      token += "~1";
+    } else {
+      token += c;
+    }
+  }
+  return token;
+}
+
+static void eraseOrigins(Origins* _origins, const std::string& _path) {
+  // Erases the path and everything below it.
+  auto it = _origins->lower_bound(_path);
+  while (it != _origins->end() &&
+         it->first.compare(0, _path.size(), _path) == 0 &&
+         (it->first.size() == _path.size() || it->first[_path.size()] == '/')) {
+    it = _origins->erase(it);
+  }
+}
+
+static void mergeOrigins(Origins* _origins, const std::string& _path,
+                         const std::string& _source, const Origins& _inner) {
+  eraseOrigins(_origins, _path);
+  (*_origins)[_path] = _source;
+  for (const auto& inner : _inner) {
+    (*_origins)[_path + inner.first] = inner.second;
+  }
+}
+
+template <typename T>
+static T toNumber(const std::string& _str, const std::string& _type) {
+  size_t pos = 0;
+  T val = 0;
+  try {
+    if constexpr (std::is_same<T, s64>::value) {
+      val = std::stoll(_str, &pos);
+    } else if constexpr (std::is_same<T, u64>::value) {
+      val = std::stoull(_str, &pos);
+    } else {
+      val = std::stod(_str, &pos);
+    }
+  } catch (std::exception& e) {
+    pos = 0;
+  }
+  if (pos == 0 || pos != _str.size()) {
+    error("invalid %s: %s", _type.c_str(), _str.c_str());
+  }
+  return val;
+}
+
+static u64 printBytes(const nlohmann::json& _settings,
+                      std::unordered_map<const nlohmann::json*, u64>* _heavy) {
+  u64 bytes;
+  switch (_settings.type()) {
+    case nlohmann::json::value_t::object:
+      bytes = 2;
+      for (auto it = _settings.cbegin(); it != _settings.cend(); ++it) {
+        bytes += it.key().size() + 8 + printBytes(it.value(), _heavy);
+      }
+      break;
+
+    case nlohmann::json::value_t::array:
+      bytes = 2;
+      for (const nlohmann::json& elem : _settings) {
+        bytes += 4 + printBytes(elem, _heavy);
+      }
+      break;
+
+    case nlohmann::json::value_t::string:
+      return _settings.get_ref<const std::string&>().size() + 2;
+
+    case nlohmann::json::value_t::binary:
+      return _settings.get_binary().size() * 4 + 32;
+
+    default:
+      return 8;
+  }
+  if (bytes >= MIN_PRINT_CHUNK_BYTES) {
+    (*_heavy)[&_settings] = bytes;
+  }
+  return bytes;
+}
+
+static void planChunks(
+    const nlohmann::json& _settings, u64 _indent, u64 _target,
+    const std::unordered_map<const nlohmann::json*, u64>& _heavy,
+    std::vector<PrintChunk>* _chunks) {
+  auto it = _heavy.find(&_settings);
+  if (it == _heavy.end() || it->second <= _target) {
+    _chunks->back().value = &_settings;
+    _chunks->back().indent = _indent;
+    _chunks->emplace_back();
+    return;
+  }
+
+  // Prints the container the same as nlohmann::json. Heavy values are planned
+  //  recursively and runs of other values, sized by the average value, are
+  //  printed as chunks.
+  std::string pad(_indent + 2, ' ');
+  bool object = _settings.is_object();
+  _chunks->back().text += object ? "{\n" : "[\n";
+  u64 average = std::max<u64>(1, it->second / _settings.size());
+  u64 run_bytes = 0;
+  for (auto child = _settings.cbegin(); child != _settings.cend(); ++child) {
+    if (_heavy.count(&child.value()) == 0) {
+      if (run_bytes == 0) {
+        _chunks->back().value = &_settings;
+        _chunks->back().run = true;
+        _chunks->back().first = child;
+        _chunks->back().indent = _indent;
+      }
+      _chunks->back().last = std::next(child);
+      run_bytes += average;
+      if (run_bytes >= _target) {
+        _chunks->emplace_back();
+        run_bytes = 0;
+      }
+      continue;
+    }
+    if (run_bytes > 0) {
+      _chunks->emplace_back();
+      run_bytes = 0;
+    }
+    std::string& text = _chunks->back().text;
+    if (child != _settings.cbegin()) {
+      text += ",\n";
+    }
+    text += pad;
+    if (object) {
+      text += nlohmann::json(child.key()).dump();
+      text += ": ";
+    }
+    planChunks(child.value(), _indent + 2, _target, _heavy, _chunks);
+  }
+  if (run_bytes > 0) {
+    _chunks->emplace_back();
+  }
+  _chunks->back().text +=
+      '\n' + std::string(_indent, ' ') + (object ? '}' : ']');
+}
+
+static void printChunk(PrintChunk* _chunk) {
+  if (!_chunk->run) {
+    printValue(*_chunk->value, _chunk->indent, &_chunk->text);
+    return;
+  }
+  std::string pad(_chunk->indent + 2, ' ');
+  for (auto child = _chunk->first; child != _chunk->last; ++child) {
+    if (child != _chunk->value->cbegin()) {
+      _chunk->text += ",\n";
+    }
+    _chunk->text += pad;
+    if (_chunk->value->is_object()) {
+      _chunk->text += nlohmann::json(child.key()).dump();
+      _chunk->text += ": ";
+    }
+    printValue(child.value(), _chunk->indent + 2, &_chunk->text);
+  }
+}
+
+static void printValue(const nlohmann::json& _value, u64 _indent,
+                       std::string* _text) {
+  // Strings escape their line breaks, so each line break of the printed value
+  //  starts a line to indent.
+  std::string printed = _value.dump(2);
+  u64 start = 0;
+  while (true) {
+    u64 end = printed.find('\n', start);
+    if (end == std::string::npos) {
+      _text->append(printed, start, std::string::npos);
+      return;
+    }
+    _text->append(printed, start, end + 1 - start);
+    _text->append(_indent, ' ');
+    start = end + 1;
+  }
+}
+
+static u64 allocBytes(u64 _size) {
+  // Models a typical malloc: an 8 byte header, 16 byte alignment, and a 32
+  // byte minimum chunk size.
+  u64 chunk = ((_size + 8 + 15) / 16) * 16;
+  return chunk < 32 ? 32 : chunk;
 }
 
 void dprintf(bool _debug, const char* _format, ...) {
@@ -448,4 +2132,21 @@ void dprintf(bool _debug, const char* _format, ...) {
   }
 }
 
+static void error(const char* _format, ...) {
+  va_list args;
+  va_start(args, _format);
+  s32 size = vsnprintf(nullptr, 0, _format, args);
+  va_end(args);
+  std::string msg(size, '\0');
+  va_start(args, _format);
+  vsnprintf(&msg[0], size + 1, _format, args);
+  va_end(args);
+  throw Error(msg);
+}
+
+static void fail(const Error& _error) {
+  fprintf(stderr, "Settings error: %s\n", _error.what());
+  exit(-1);
+}
+
 }  // namespace settings
@@ -31,7 +31,13 @@
 #ifndef SETTINGS_SETTINGS_H_
 #define SETTINGS_SETTINGS_H_
 
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "nlohmann/json.hpp"
@@ -39,26 +45,195 @@
 
 namespace settings {
 
+class Schema;
+
+// this maps JSON pointers (RFC 6901) within the resolved settings to the
+//  include file or reference that produced the subtree at that location
+typedef std::map<std::string, std::string> Origins;
+
+// this is thrown by the functions that don't exit upon failure
+class Error : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+// this caches included files (with their inclusions processed) so that they
+//  are only read and parsed once across many loads. The root files of loads
+//  aren't cached. Files are keyed by canonical path (see realpath()), so
+//  different paths to the same file share an entry, and loads with lazy
+//  generators have their own entries. Files stay cached until cleared. It is
+//  thread safe.
+class IncludeCache {
+ public:
+  struct File {
+    nlohmann::json settings;
+    Origins origins;  // only if recording origins
+  };
+
+  // if not recording origins, cached subtrees only report their own file
+  explicit IncludeCache(bool _record_origins = false);
+  ~IncludeCache();
+
+  bool recordOrigins() const;
+
+  // this returns the cached file or nullptr
+  std::shared_ptr<const File> find(const std::string& _file) const;
+
+  // this caches a file and returns the cached file, which is a different one
+  //  if another thread inserted it first
+  std::shared_ptr<const File> insert(const std::string& _file,
+                                     std::shared_ptr<const File> _contents);
+
+  u64 size() const;
+  void clear();
+
+ private:
+  const bool record_origins_;
+  mutable std::mutex lock_;
+  std::unordered_map<std::string, std::shared_ptr<const File>> files_;
+};
+
 // this initializes the settings from a JSON file
+//  gzip and zstd files are decompressed (see settings/compress.h)
+//  CBOR, MessagePack, and BSON files are detected by extension or magic bytes
+//   (see settings/format.h), as are included files and "file" updates
+//  included templates ("$$(file?name=value&...)$$") are parsed once per load
+//   and instantiated by replacing their "$@(name)@$" strings with the values
+//  included glob patterns ("$$(dir/*.json)$$", '*' and "[...]" only) and
+//   directories ("$$(dir)$$") become an object keyed by file stem (i.e.,
+//   without the last and compressed extensions), or an array in file name
+//   order if bracketed ("$$([dir/*.json])$$"). The matching regular files
+//   (excluding hidden files in directories) are loaded concurrently.
+//  if given, the origins of included and referenced subtrees are recorded
 //  error print and exit(-1) upon failure
-void initFile(const std::string& _config_file, nlohmann::json* _settings);
+void initFile(const std::string& _config_file, nlohmann::json* _settings,
+              Origins* _origins = nullptr);
 
 // this initializes the settings from a JSON string
+//  if given, the origins of included and referenced subtrees are recorded
 //  error print and exit(-1) upon failure
-void initString(const std::string& _config_str, nlohmann::json* _settings);
+void initString(const std::string& _config_str, nlohmann::json* _settings,
+                Origins* _origins = nullptr);
 
 // this initializes the settings from a JSON file and settings updates
 //  pass the "-h" flag to see how to use
+//  if given, the origins of included and referenced subtrees are recorded
+//  error print and exit(-1) upon failure
+void commandLine(s32 _argc, const char* const* _argv, nlohmann::json* _settings,
+                 Origins* _origins = nullptr);
+
+// this parses a command line the same way as commandLine() without loading
+//  any settings
+//  pass the "-h" flag to see how to use
 //  error print and exit(-1) upon failure
-void commandLine(s32 _argc, const char* const* _argv,
-                 nlohmann::json* _settings);
+void parseCommandLine(s32 _argc, const char* const* _argv,
+                      std::string* _config_file,
+                      std::vector<std::string>* _updates,
+                      bool* _debug = nullptr);
+
+// These are the options of load().
+struct LoadOptions {
+  // if given, files are loaded through the cache
+  IncludeCache* cache = nullptr;
+  // if true, generator expressions are kept as strings to be accessed through
+  //  settings::Sequence and can't be referenced into
+  bool lazy_generators = false;
+  // if given, the resolved settings are validated against the schema
+  const Schema* schema = nullptr;
+  // references are resolved with this many threads (see resolveReferences())
+  u32 threads = 1;
+};
+
+// this initializes the settings from a JSON file and settings updates the
+//  same way as commandLine(), with the options
+//  if given, the origins of included and referenced subtrees are recorded
+//  this is thread safe
+//  throws settings::Error upon failure (listing all schema violations)
+void load(const std::string& _config_file,
+          const std::vector<std::string>& _updates, nlohmann::json* _settings,
+          Origins* _origins = nullptr,
+          const LoadOptions& _options = LoadOptions());
+
+// this replaces the "$&(...)&$" references the same way the loaders do
+//  with more than one thread (0 means one per hardware thread), references
+//  are copied concurrently once the references within their targets are
+//  copied. The result is identical to the serial resolution. If recording
+//  origins, or if a target only exists after other references are copied,
+//  references are resolved serially.
+//  throws settings::Error upon failure
+void resolveReferences(nlohmann::json* _settings, Origins* _origins = nullptr,
+                       u32 _threads = 1);
+
+// this parses a settings update (see commandLine()) into the normalized JSON
+//  pointer it modifies and its value. The pointer keeps "-" tokens, which
+//  append to arrays (see Layer::set()). Files are loaded and generator
+//  expressions are expanded. References aren't resolved, so updates that
+//  produce references are rejected.
+//  throws settings::Error upon failure
+void parseUpdate(const std::string& _update, std::string* _pointer,
+                 nlohmann::json* _value);
+
+// this loads the same as load() and calls _ready with each top-level key as
+//  soon as its subtree is final. _ready is called before the load completes
+//  and may let other threads read ready subtrees concurrently with the rest of
+//  the load, but the top-level object itself must not be accessed until load
+//  completes. Each subtree is ready as soon as its inclusions are processed,
+//  except that subtrees modified by updates, containing references, or
+//  targeted by references known by then become ready only after all updates
+//  or all references are processed. References found later (e.g., in files
+//  included by other subtrees) may only target existing values of ready
+//  subtrees.
+//  if debugging, the load is traced the same as commandLine() with "-d"
+//  throws settings::Error upon failure
+void loadIncrementally(const std::string& _config_file,
+                       const std::vector<std::string>& _updates,
+                       nlohmann::json* _settings, Origins* _origins,
+                       IncludeCache* _cache,
+                       const std::function<void(const std::string&)>& _ready,
+                       bool _debug = false);
+
+// this loads only the subtrees of the settings file at the JSON pointer
+//  prefixes ("" selects everything). Unselected parts of JSON text files are
+//  skipped without being parsed, and only inclusions within or on the way to
+//  selected subtrees are loaded. References to unselected subtrees are
+//  resolved by loading just their targets. Compressed and binary files are
+//  loaded whole then pruned. See settings/projection.h for how arrays are
+//  selected. Files are loaded through the cache if given.
+//  this is thread safe
+//  throws settings::Error upon failure
+void loadProjection(const std::string& _config_file,
+                    const std::vector<std::string>& _prefixes,
+                    nlohmann::json* _settings, IncludeCache* _cache = nullptr);
 
 // this returns a string representation of the settings
-std::string toString(const nlohmann::json& _settings);
+//  with more than one thread (0 means one per hardware thread), large
+//  settings are split into subtrees that are printed concurrently. The text
+//  is identical to printing with one thread.
+std::string toString(const nlohmann::json& _settings, u32 _threads = 1);
 
 // writes settings to a file
+//  the settings are printed (see toString()), and ".gz" and ".zst" files are
+//  compressed using the level (0 is the default level), with the number of
+//  threads (0 means one per hardware thread)
+//  ".cbor", ".msgpack", ".mpk", and ".bson" files are written in that binary
+//  format (see settings/format.h), holding typed arrays inline
+//  otherwise typed arrays, and arrays of at least _sidecar_threshold numbers
+//  (0 means none), are written to sidecar files (see settings/sidecar.h)
+//  error print and exit(-1) upon failure
 void writeToFile(const nlohmann::json& _settings,
-                 const std::string& _config_file);
+                 const std::string& _config_file, s32 _level = 0,
+                 u32 _threads = 1, u64 _sidecar_threshold = 0);
+
+// this writes settings to a file the same way as writeToFile()
+//  this is thread safe
+//  throws settings::Error upon failure
+void save(const nlohmann::json& _settings, const std::string& _config_file,
+          s32 _level = 0, u32 _threads = 1, u64 _sidecar_threshold = 0);
+
+// this returns an estimate of the heap bytes held by the settings
+//  (i.e., excluding the root nlohmann::json object itself)
+//  if not recursive, the heap bytes held by the children are excluded
+u64 heapBytes(const nlohmann::json& _settings, bool _recursive = true);
 
 }  // namespace settings
 
@@ -30,6 +30,9 @@
  */
 #include "settings/settings.h"
 
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <string>
 
 #include "gtest/gtest.h"
@@ -466,6 +469,59 @@ TEST(Settings, referenceTricky) {
   assert(remove(filename) == 0);
 }
 
+TEST(Settings, referenceParallel) {
+  // Chains, references within targets, and references copied many times.
+  nlohmann::json original = nlohmann::json::parse(
+      "{\"age\": 30,"
+      " \"blah\": {\"words\": \"$&(/names)&$\", \"age\": \"$&(/x/y)&$\"},"
+      " \"names\": [\"You\", \"$&(/age)&$\", \"Them\"],"
+      " \"x\": {\"y\": \"$&(/names/1)&$\"},"
+      " \"copies\": [\"$&(/blah)&$\", \"$&(/blah)&$\", \"$&(/x)&$\"],"
+      " \"root\": {\"a-b\": \"$&(/copies)&$\"}}");
+  nlohmann::json serial = original;
+  settings::resolveReferences(&serial);
+  ASSERT_EQ(serial["root"]["a-b"][2]["y"].get<u64>(), 30u);
+  for (u32 threads : {0u, 2u, 4u, 16u}) {
+    nlohmann::json parallel = original;
+    settings::resolveReferences(&parallel, nullptr, threads);
+    ASSERT_EQ(parallel, serial) << threads;
+  }
+
+  // A chain that copies a reference before its target is a container.
+  nlohmann::json chained = nlohmann::json::parse(
+      "{\"a\": \"$&(/b)&$\", \"b\": \"$&(/c)&$\", \"c\": [1, 2]}");
+  settings::resolveReferences(&chained);
+  ASSERT_EQ(chained["a"], nlohmann::json::parse("[1, 2]"));
+
+  // Targets within referenced values are resolved serially.
+  nlohmann::json within = nlohmann::json::parse(
+      "{\"a\": {\"b\": 1}, \"c\": \"$&(/a)&$\", \"d\": \"$&(/c/b)&$\"}");
+  settings::resolveReferences(&within, nullptr, 4);
+  ASSERT_EQ(within["d"].get<u64>(), 1u);
+
+  nlohmann::json circular = nlohmann::json::parse(
+      "{\"a\": {\"b\": \"$&(/c)&$\"}, \"c\": \"$&(/a)&$\"}");
+  ASSERT_THROW(settings::resolveReferences(&circular, nullptr, 4),
+               settings::Error);
+}
+
+TEST(Settings, referenceCircular) {
+  for (const char* text :
+       {"{\"a\": \"$&(/a)&$\"}",
+        "{\"a\": [1, \"$&(/a)&$\"]}",
+        "{\"a\": \"$&(/b)&$\", \"b\": \"$&(/a)&$\"}",
+        "{\"a\": \"$&(/b)&$\", \"b\": {\"x\": \"$&(/a)&$\"}}"}) {
+    for (u32 threads : {1u, 4u}) {
+      nlohmann::json settings = nlohmann::json::parse(text);
+      ASSERT_THROW(settings::resolveReferences(&settings, nullptr, threads),
+                   settings::Error)
+          << text;
+    }
+    nlohmann::json settings;
+    ASSERT_DEATH(settings::initString(text, &settings), "circular reference");
+  }
+}
+
 TEST(Settings, commandlineArraySimple) {
   const char* filename = "TEST_settings.json";
   FILE* fp = fopen(filename, "w");
@@ -588,3 +644,218 @@ TEST(Settings, commandlineArrayWithTrickyFiles) {
   assert(remove(afilename) == 0);
   assert(remove(bfilename) == 0);
 }
+
+TEST(Settings, templateInitFile) {
+  const char* afilename = "TEST_asettings.json";
+  FILE* afp = fopen(afilename, "w");
+  assert(afp != NULL);
+  fprintf(afp, "%s",
+          "{\"r0\": \"$$(TEST_bsettings.json?id=7&ports=64)$$\",\n"
+          " \"r1\": \"$$(TEST_bsettings.json?id=\\\"7\\\"&ports=[1,2])$$\",\n"
+          " \"r2\": \"$$(TEST_bsettings.json?id=x&ports=null)$$\",\n"
+          " \"b\": \"$$(TEST_bsettings.json)$$\"}");
+  fclose(afp);
+
+  const char* bfilename = "TEST_bsettings.json";
+  FILE* bfp = fopen(bfilename, "w");
+  assert(bfp != NULL);
+  fprintf(bfp, "%s",
+          "{\"id\": \"$@(id)@$\", \"name\": \"router $@(id)@$\",\n"
+          " \"sub\": [\"$@(ports)@$\", \"$$(TEST_csettings.json)$$\"]}");
+  fclose(bfp);
+
+  const char* cfilename = "TEST_csettings.json";
+  FILE* cfp = fopen(cfilename, "w");
+  assert(cfp != NULL);
+  fprintf(cfp, "%s", "{\"c\": \"$@(id)@$\"}");
+  fclose(cfp);
+
+  nlohmann::json settings;
+  settings::Origins origins;
+  settings::initFile(afilename, &settings, &origins);
+
+  ASSERT_EQ(settings["r0"]["id"], nlohmann::json(7));
+  ASSERT_EQ(settings["r0"]["name"].get<std::string>(), "router $@(id)@$");
+  ASSERT_EQ(settings["r0"]["sub"][0], nlohmann::json(64));
+  ASSERT_EQ(settings["r0"]["sub"][1]["c"], nlohmann::json(7));
+  ASSERT_EQ(settings["r1"]["id"].get<std::string>(), "7");
+  ASSERT_EQ(settings["r1"]["sub"][0], nlohmann::json::parse("[1,2]"));
+  ASSERT_EQ(settings["r2"]["id"].get<std::string>(), "x");
+  ASSERT_TRUE(settings["r2"]["sub"][0].is_null());
+  ASSERT_EQ(settings["b"]["id"].get<std::string>(), "$@(id)@$");
+  ASSERT_EQ(settings["b"]["sub"][1]["c"].get<std::string>(), "$@(id)@$");
+
+  ASSERT_EQ(origins.at("/r0"), "./TEST_bsettings.json?id=7&ports=64");
+  ASSERT_EQ(origins.at("/r0/sub/1"), "./TEST_csettings.json");
+  ASSERT_EQ(origins.at("/r2/sub/1"), "./TEST_csettings.json");
+  ASSERT_EQ(origins.at("/b"), "./TEST_bsettings.json");
+
+  assert(remove(afilename) == 0);
+  assert(remove(bfilename) == 0);
+  assert(remove(cfilename) == 0);
+}
+
+TEST(Settings, templateCommandLine) {
+  const char* afilename = "TEST_asettings.json";
+  FILE* afp = fopen(afilename, "w");
+  assert(afp != NULL);
+  fprintf(afp, "%s", "{\"a\": 1, \"routers\": []}");
+  fclose(afp);
+
+  const char* bfilename = "TEST_bsettings.json";
+  FILE* bfp = fopen(bfilename, "w");
+  assert(bfp != NULL);
+  fprintf(bfp, "%s", "{\"id\": \"$@(id)@$\", \"radix\": \"$@(radix)@$\"}");
+  fclose(bfp);
+
+  const int argc = 3;
+  const char* argv[argc] = {
+      "./path/to/some/binary", afilename,
+      "/routers=file=[TEST_bsettings.json?id=0&radix=4,"
+      "TEST_bsettings.json?id=1&radix=8]"};
+
+  nlohmann::json settings;
+  settings::commandLine(argc, argv, &settings);
+
+  ASSERT_EQ(settings["routers"].size(), 2u);
+  ASSERT_EQ(settings["routers"][0]["id"], nlohmann::json(0));
+  ASSERT_EQ(settings["routers"][0]["radix"], nlohmann::json(4));
+  ASSERT_EQ(settings["routers"][1]["id"], nlohmann::json(1));
+  ASSERT_EQ(settings["routers"][1]["radix"], nlohmann::json(8));
+
+  assert(remove(afilename) == 0);
+  assert(remove(bfilename) == 0);
+}
+
+TEST(Settings, templateErrors) {
+  const char* bfilename = "TEST_bsettings.json";
+  FILE* bfp = fopen(bfilename, "w");
+  assert(bfp != NULL);
+  fprintf(bfp, "%s", "{\"id\": \"$@(id)@$\"}");
+  fclose(bfp);
+
+  nlohmann::json settings;
+  ASSERT_THROW(
+      settings::load(bfilename, {"/x=file=TEST_bsettings.json?id=1&y=2"},
+                     &settings),
+      settings::Error);
+  ASSERT_THROW(
+      settings::load(bfilename, {"/x=file=TEST_bsettings.json?y=2"},
+                     &settings),
+      settings::Error);
+  ASSERT_THROW(
+      settings::load(bfilename, {"/x=file=TEST_bsettings.json?id"}, &settings),
+      settings::Error);
+  settings::load(bfilename, {"/x=file=TEST_bsettings.json?id=1"}, &settings);
+  ASSERT_EQ(settings["x"]["id"], nlohmann::json(1));
+
+  assert(remove(bfilename) == 0);
+}
+
+TEST(Settings, fileSetInclusion) {
+  const char* dirname = "TEST_fileset";
+  assert(mkdir(dirname, 0755) == 0);
+  FILE* fp = fopen("TEST_fileset/a.json", "w");
+  assert(fp != NULL);
+  fprintf(fp, "%s", "{\"v\": 1, \"b\": \"$$(b.json)$$\"}");
+  fclose(fp);
+  fp = fopen("TEST_fileset/b.json", "w");
+  assert(fp != NULL);
+  fprintf(fp, "%s", "{\"v\": 2}");
+  fclose(fp);
+  fp = fopen("TEST_fileset/.hidden.json", "w");
+  assert(fp != NULL);
+  fprintf(fp, "%s", "{\"v\": 4}");
+  fclose(fp);
+  settings::writeToFile({{"v", 3}}, "TEST_fileset/c.cbor");
+  settings::writeToFile({{"v", 6}}, "TEST_[lit].json");
+
+  const char* afilename = "TEST_asettings.json";
+  fp = fopen(afilename, "w");
+  assert(fp != NULL);
+  fprintf(fp, "%s",
+          "{\"obj\": \"$$(TEST_fileset/*.json)$$\",\n"
+          " \"arr\": \"$$([TEST_fileset/*.json])$$\",\n"
+          " \"dir\": \"$$(TEST_fileset)$$\",\n"
+          " \"none\": \"$$(TEST_fileset/*.txt)$$\",\n"
+          " \"lit\": \"$$(TEST_[lit].json)$$\",\n"
+          " \"r\": \"$&(/obj/b/v)&$\"}");
+  fclose(fp);
+
+  nlohmann::json settings;
+  settings::Origins origins;
+  settings::load(afilename, {"/u=file=TEST_fileset/"}, &settings, &origins);
+
+  ASSERT_EQ(settings["obj"].size(), 2u);
+  ASSERT_EQ(settings["obj"]["a"]["v"].get<u64>(), 1u);
+  ASSERT_EQ(settings["obj"]["a"]["b"]["v"].get<u64>(), 2u);
+  ASSERT_EQ(settings["obj"]["b"]["v"].get<u64>(), 2u);
+  ASSERT_EQ(settings["arr"].size(), 2u);
+  ASSERT_EQ(settings["arr"][0], settings["obj"]["a"]);
+  ASSERT_EQ(settings["arr"][1], settings["obj"]["b"]);
+  ASSERT_EQ(settings["dir"].size(), 3u);
+  ASSERT_EQ(settings["dir"]["c"]["v"].get<u64>(), 3u);
+  ASSERT_EQ(settings["none"], nlohmann::json::object());
+  ASSERT_EQ(settings["lit"]["v"].get<u64>(), 6u);  // not a pattern
+  ASSERT_EQ(settings["r"].get<u64>(), 2u);
+  ASSERT_EQ(settings["u"].size(), 3u);
+  ASSERT_EQ(settings["u"], settings["dir"]);
+
+  ASSERT_EQ(origins.at("/obj"), "./TEST_fileset/*.json");
+  ASSERT_EQ(origins.at("/obj/a"), "./TEST_fileset/a.json");
+  ASSERT_EQ(origins.at("/obj/a/b"), "./TEST_fileset/b.json");
+  ASSERT_EQ(origins.at("/arr/1"), "./TEST_fileset/b.json");
+  ASSERT_EQ(origins.at("/u/c"), "TEST_fileset/c.cbor");
+
+  // Files with the same stem, a missing file, and a file that doesn't parse.
+  settings::writeToFile({{"v", 5}}, "TEST_fileset/c.json");
+  ASSERT_THROW(settings::load(afilename, {}, &settings), settings::Error);
+  ASSERT_THROW(
+      settings::load(afilename, {"/u=file=[TEST_fileset/d.json]"}, &settings),
+      settings::Error);
+  fp = fopen("TEST_fileset/d.json", "w");
+  assert(fp != NULL);
+  fprintf(fp, "%s", "{\"v\": ");
+  fclose(fp);
+  ASSERT_THROW(settings::load(afilename, {}, &settings), settings::Error);
+
+  for (const char* file :
+       {"TEST_fileset/a.json", "TEST_fileset/b.json", "TEST_fileset/c.cbor",
+        "TEST_fileset/c.json", "TEST_fileset/d.json",
+        "TEST_fileset/.hidden.json"}) {
+    assert(remove(file) == 0);
+  }
+  assert(rmdir(dirname) == 0);
+  assert(remove("TEST_[lit].json") == 0);
+  assert(remove(afilename) == 0);
+}
+
+TEST(Settings, toStringParallel) {
+  // Large and small subtrees, empty containers, escapes, and binary values.
+  nlohmann::json settings;
+  for (u64 idx = 0; idx < 8000; idx++) {
+    settings["big"]["key\"" + std::to_string(idx)] = {
+        {"name", "caf\xc3\xa9\n" + std::to_string(idx)},
+        {"values", {idx, -1.5, nullptr, true, nlohmann::json::array()}},
+        {"empty", nlohmann::json::object()}};
+  }
+  for (u64 idx = 0; idx < 200; idx++) {
+    settings["list"].push_back({{"x", idx}, {"y", {idx, idx + 1}}});
+  }
+  settings["deep"][0][0]["list"] = settings["list"];
+  settings["deep"][0][1] = settings["big"];
+  settings["bytes"] = nlohmann::json::binary({1, 2, 3}, 7);
+  settings["tiny"] = 1;
+
+  std::string serial = settings::toString(settings);
+  for (u32 threads : {0u, 2u, 3u, 16u}) {
+    ASSERT_EQ(settings::toString(settings, threads), serial) << threads;
+  }
+  nlohmann::json big = nlohmann::json(std::string(1000000, 'x'));
+  ASSERT_EQ(settings::toString(big, 4), settings::toString(big));
+
+  // Invalid UTF-8 throws the same way.
+  settings["deep"][0][1]["bad"] = "\xff";
+  ASSERT_THROW(settings::toString(settings), nlohmann::json::exception);
+  ASSERT_THROW(settings::toString(settings, 4), nlohmann::json::exception);
+}
@@ -0,0 +1,232 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/shared.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "settings/settings.h"
+
+namespace settings {
+
+// The segment starts with this header, followed by the image.
+//  state (MAGIC once the image is complete), image size, reserved
+static const u64 MAGIC = 0x31304d4853544553ull;  // "SETSHM01"
+static const u64 HEADER_BYTES = 64;
+
+static_assert(std::atomic<u64>::is_always_lock_free,
+              "the segment state must be lock free to be shared");
+
+// This returns the segment state.
+static std::atomic<u64>* state(void* _mapping) {
+  return reinterpret_cast<std::atomic<u64>*>(_mapping);
+}
+
+// This removes a segment the publisher failed to complete, then error prints
+//  and exits.
+static void failPublish(const std::string& _name, const char* _what,
+                        s32 _fd, void* _mapping, u64 _size) {
+  s32 err = errno;
+  if (_mapping != nullptr) {
+    munmap(_mapping, _size);
+  }
+  if (_fd >= 0) {
+    close(_fd);
+  }
+  shm_unlink(_name.c_str());
+  fprintf(stderr, "Settings error: couldn't %s shared memory %s: %s\n", _what,
+          _name.c_str(), strerror(err));
+  exit(-1);
+}
+
+std::unique_ptr<SharedImage> SharedImage::publish(
+    const std::string& _name, const nlohmann::json& _settings) {
+  // Builds the image before creating the segment so that only the calls below
+  // can fail while the segment is incomplete.
+  Image image(_settings);
+
+  // Creates the segment, failing if it exists so that stale segments are
+  // never mixed with new settings.
+  s32 fd = shm_open(_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "Settings error: couldn't create shared memory %s: %s\n",
+            _name.c_str(), strerror(errno));
+    exit(-1);
+  }
+
+  // Sizes and fills the segment. Attaching processes wait for the state. From
+  // here on the segment is removed upon failure.
+  u64 size = HEADER_BYTES + image.size();
+  if (ftruncate(fd, size) != 0) {
+    failPublish(_name, "size", fd, nullptr, 0);
+  }
+  void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                       0);
+  if (mapping == MAP_FAILED) {
+    failPublish(_name, "map", fd, nullptr, 0);
+  }
+  close(fd);
+  u8* bytes = reinterpret_cast<u8*>(mapping);
+  u64 image_size = image.size();
+  memcpy(bytes + 8, &image_size, sizeof(image_size));
+  memcpy(bytes + HEADER_BYTES, image.data(), image.size());
+  state(mapping)->store(MAGIC, std::memory_order_release);
+
+  // The publisher only reads the settings from here on.
+  if (mprotect(mapping, size, PROT_READ) != 0) {
+    failPublish(_name, "protect", -1, mapping, size);
+  }
+  return std::unique_ptr<SharedImage>(new SharedImage(mapping, size, _name));
+}
+
+std::unique_ptr<SharedImage> SharedImage::attach(const std::string& _name,
+                                                 f64 _timeout) {
+  std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::now() +
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<f64>(_timeout));
+  void* mapping = nullptr;
+  u64 size = 0;
+  while (true) {
+    // Waits for the segment to exist, be sized, and be complete.
+    s32 fd = shm_open(_name.c_str(), O_RDONLY, 0);
+    if (fd < 0 && errno != ENOENT) {
+      fprintf(stderr, "Settings error: couldn't open shared memory %s: %s\n",
+              _name.c_str(), strerror(errno));
+      exit(-1);
+    }
+    if (fd >= 0) {
+      struct stat st;
+      if (fstat(fd, &st) == 0 && static_cast<u64>(st.st_size) >= HEADER_BYTES) {
+        size = st.st_size;
+        mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+          fprintf(stderr,
+                  "Settings error: couldn't map shared memory %s: %s\n",
+                  _name.c_str(), strerror(errno));
+          exit(-1);
+        }
+        if (state(mapping)->load(std::memory_order_acquire) == MAGIC) {
+          close(fd);
+          break;
+        }
+        munmap(mapping, size);
+      }
+      close(fd);
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+      fprintf(stderr,
+              "Settings error: timed out waiting for shared memory %s\n",
+              _name.c_str());
+      exit(-1);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // Checks the size before wrapping the image.
+  u64 image_size;
+  memcpy(&image_size, reinterpret_cast<u8*>(mapping) + 8, sizeof(image_size));
+  if (HEADER_BYTES + image_size != size) {
+    fprintf(stderr, "Settings error: invalid shared memory %s\n",
+            _name.c_str());
+    exit(-1);
+  }
+  return std::unique_ptr<SharedImage>(new SharedImage(mapping, size, ""));
+}
+
+void SharedImage::unlink(const std::string& _name) {
+  if (shm_unlink(_name.c_str()) != 0 && errno != ENOENT) {
+    fprintf(stderr, "Settings error: couldn't unlink shared memory %s: %s\n",
+            _name.c_str(), strerror(errno));
+    exit(-1);
+  }
+}
+
+void SharedImage::unlink() {
+  if (!name_.empty()) {
+    unlink(name_);
+    name_.clear();
+  }
+}
+
+SharedImage::SharedImage(void* _mapping, u64 _mapping_size,
+                         const std::string& _name)
+    : mapping_(_mapping),
+      mapping_size_(_mapping_size),
+      name_(_name),
+      image_(std::make_unique<Image>(
+          reinterpret_cast<u8*>(_mapping) + HEADER_BYTES,
+          _mapping_size - HEADER_BYTES)) {}
+
+SharedImage::~SharedImage() {
+  image_.reset();
+  munmap(mapping_, mapping_size_);
+  if (!name_.empty()) {
+    shm_unlink(name_.c_str());
+  }
+}
+
+const Image& SharedImage::image() const {
+  return *image_;
+}
+
+ImageNode SharedImage::root() const {
+  return image_->root();
+}
+
+std::unique_ptr<SharedImage> commandLineShared(const std::string& _name,
+                                               bool _leader, s32 _argc,
+                                               const char* const* _argv,
+                                               f64 _timeout) {
+  if (_leader) {
+    nlohmann::json settings;
+    commandLine(_argc, _argv, &settings);
+    return SharedImage::publish(_name, settings);
+  } else {
+    std::string config_file;
+    std::vector<std::string> updates;
+    parseCommandLine(_argc, _argv, &config_file, &updates);
+    return SharedImage::attach(_name, _timeout);
+  }
+}
+
+}  // namespace settings
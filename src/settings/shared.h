@@ -0,0 +1,105 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SETTINGS_SHARED_H_
+#define SETTINGS_SHARED_H_
+
+#include <memory>
+#include <string>
+
+#include "nlohmann/json.hpp"
+#include "prim/prim.h"
+#include "settings/image.h"
+
+namespace settings {
+
+// This is a settings image (see settings::Image) in a POSIX shared memory
+// segment. One process publishes the resolved settings and the other processes
+// of the same machine attach to the segment read-only, sharing one copy of the
+// settings without parsing anything.
+// The publisher owns the segment name: it is removed when the published
+// SharedImage is destroyed or unlinked, or if publishing fails. Processes must
+// attach before then. Attached processes stay attached after the name is
+// removed, and the memory is freed when the last one detaches. A process that
+// dies without destroying its published SharedImage leaves the name behind,
+// which the static unlink() removes.
+class SharedImage {
+ public:
+  // this publishes the settings in a new shared memory segment named _name
+  //  (e.g., "/myjob.settings"). The name remains until the returned
+  //  SharedImage is destroyed or unlinked.
+  //  error print and exit(-1) if the segment exists or can't be created
+  static std::unique_ptr<SharedImage> publish(const std::string& _name,
+                                              const nlohmann::json& _settings);
+
+  // this attaches to a segment, waiting up to _timeout seconds for it to be
+  //  published
+  //  error print and exit(-1) upon timeout or if the segment is invalid
+  static std::unique_ptr<SharedImage> attach(const std::string& _name,
+                                             f64 _timeout = 60.0);
+
+  // this removes the segment name (e.g., left behind by a dead publisher).
+  //  Attached processes stay attached.
+  static void unlink(const std::string& _name);
+
+  // this removes the name of a published segment now instead of upon
+  //  destruction. It does nothing for attached segments.
+  void unlink();
+
+  ~SharedImage();
+  SharedImage(const SharedImage&) = delete;
+  SharedImage& operator=(const SharedImage&) = delete;
+
+  const Image& image() const;
+  ImageNode root() const;
+
+ private:
+  SharedImage(void* _mapping, u64 _mapping_size, const std::string& _name);
+
+  void* mapping_;
+  u64 mapping_size_;
+  std::string name_;  // only set while a published segment is named
+  std::unique_ptr<Image> image_;
+};
+
+// this is commandLine() for a job of many processes on one machine. The leader
+//  resolves the settings with commandLine() and publishes them, the others
+//  attach to them (see SharedImage). All processes parse the command line
+//  (e.g., "-h" is handled by all). The leader keeps the segment name until
+//  its returned SharedImage is destroyed.
+//  error print and exit(-1) upon failure
+std::unique_ptr<SharedImage> commandLineShared(const std::string& _name,
+                                               bool _leader, s32 _argc,
+                                               const char* const* _argv,
+                                               f64 _timeout = 60.0);
+
+}  // namespace settings
+
+#endif  // SETTINGS_SHARED_H_
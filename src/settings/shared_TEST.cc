@@ -0,0 +1,108 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/shared.h"
+
+#include <unistd.h>
+
+#include <chrono>  // NOLINT
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+
+static std::string segmentName() {
+  return "/settings_TEST." + std::to_string(getpid());
+}
+
+TEST(Shared, publishAttach) {
+  std::string name = segmentName();
+  settings::SharedImage::unlink(name);
+  nlohmann::json settings = {
+      {"a", {1, 2, 3}}, {"b", {{"c", "hello"}, {"d", 2.5}}}, {"e", true}};
+
+  // An attaching process waits for the publisher.
+  std::unique_ptr<settings::SharedImage> attached;
+  std::thread follower(
+      [&] { attached = settings::SharedImage::attach(name, 30.0); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  std::unique_ptr<settings::SharedImage> published =
+      settings::SharedImage::publish(name, settings);
+  follower.join();
+
+  ASSERT_EQ(published->root().toJson(), settings);
+  ASSERT_EQ(attached->root().toJson(), settings);
+  ASSERT_EQ(attached->root()["b"]["c"].getString(), "hello");
+  ASSERT_EQ(attached->root().at("/a/2").getUint(), 3u);
+  ASSERT_EQ(attached->image().size(), published->image().size());
+  ASSERT_NE(attached->image().data(), published->image().data());
+
+  // Segments can't be published twice, and unlinking keeps attachments.
+  ASSERT_DEATH(settings::SharedImage::publish(name, settings),
+               "couldn't create shared memory");
+  settings::SharedImage::unlink(name);
+  ASSERT_EQ(attached->root()["e"].getBool(), true);
+  ASSERT_DEATH(settings::SharedImage::attach(name, 0.01), "timed out");
+
+  // The name can be published again once unlinked by its publisher.
+  published.reset();
+  published = settings::SharedImage::publish(name, settings);
+  published->unlink();
+  published->unlink();
+  ASSERT_DEATH(settings::SharedImage::attach(name, 0.01), "timed out");
+  ASSERT_EQ(published->root().toJson(), settings);
+}
+
+TEST(Shared, commandLineShared) {
+  std::string name = segmentName();
+  settings::SharedImage::unlink(name);
+  const char* filename = "TEST_settings.json";
+  FILE* fp = fopen(filename, "w");
+  assert(fp != NULL);
+  fprintf(fp, "%s", "{\"x\": 1, \"y\": \"$&(/x)&$\"}");
+  fclose(fp);
+
+  const char* argv[] = {"exe", filename, "/x=uint=4"};
+  std::unique_ptr<settings::SharedImage> leader =
+      settings::commandLineShared(name, true, 3, argv);
+  std::unique_ptr<settings::SharedImage> follower =
+      settings::commandLineShared(name, false, 3, argv);
+  ASSERT_EQ(follower->root()["y"].getUint(), 4u);
+  ASSERT_EQ(follower->root().toJson(), leader->root().toJson());
+
+  // The leader removes the name when done, the follower stays attached.
+  leader.reset();
+  ASSERT_DEATH(settings::SharedImage::attach(name, 0.01), "timed out");
+  ASSERT_EQ(follower->root()["x"].getUint(), 4u);
+
+  assert(remove(filename) == 0);
+}
@@ -0,0 +1,432 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/sidecar.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "fio/OutFile.h"
+#include "settings/settings.h"
+
+namespace settings {
+
+// The sidecar file header (4 words):
+//  magic, element type, element count, reserved
+static const u64 MAGIC = 0x3130525241544553ull;  // "SETARR01"
+static const u64 HEADER_BYTES = 32;
+
+// This returns true if the element type code is valid.
+static bool validType(u64 _code);
+
+// This returns true if this machine is little endian.
+static bool littleEndian();
+
+// This reverses the byte order of each element.
+static void swapBytes(u8* _data, u64 _bytes, u64 _element_bytes);
+
+// This reads exactly _bytes bytes from the file descriptor.
+// Returns false upon failure or end of file.
+static bool readBytes(s32 _fd, u8* _data, u64 _bytes);
+
+// This spills typed arrays and large numeric arrays to sidecar files.
+static void spill(nlohmann::json* _node, const std::string& _config_file,
+                  u64 _threshold, u64* _count);
+
+/*** public functions below here ***/
+
+u64 elementBytes(ElementType _type) {
+  switch (_type) {
+    case ElementType::U8:
+    case ElementType::S8:
+      return 1;
+    case ElementType::U16:
+    case ElementType::S16:
+      return 2;
+    case ElementType::U32:
+    case ElementType::S32:
+    case ElementType::F32:
+      return 4;
+    default:
+      return 8;
+  }
+}
+
+const char* elementName(ElementType _type) {
+  switch (_type) {
+    case ElementType::U8:
+      return "u8";
+    case ElementType::S8:
+      return "s8";
+    case ElementType::U16:
+      return "u16";
+    case ElementType::S16:
+      return "s16";
+    case ElementType::U32:
+      return "u32";
+    case ElementType::S32:
+      return "s32";
+    case ElementType::U64:
+      return "u64";
+    case ElementType::S64:
+      return "s64";
+    case ElementType::F32:
+      return "f32";
+    case ElementType::F64:
+      return "f64";
+    default:
+      return "invalid";
+  }
+}
+
+bool isTypedArray(const nlohmann::json& _value) {
+  if (!_value.is_binary() || !_value.get_binary().has_subtype()) {
+    return false;
+  }
+  const nlohmann::json::binary_t& bin = _value.get_binary();
+  u64 code = bin.subtype() ^ TYPED_ARRAY_SUBTYPE;
+  if (!validType(code)) {
+    return false;
+  }
+  ElementType type = static_cast<ElementType>(code);
+  return bin.size() % elementBytes(type) == 0;
+}
+
+bool isTypedArray(const ImageNode& _node) {
+  if (!_node.isBinary() || _node.getSubtype() < 0) {
+    return false;
+  }
+  u64 code = static_cast<u64>(_node.getSubtype()) ^ TYPED_ARRAY_SUBTYPE;
+  if (!validType(code)) {
+    return false;
+  }
+  ElementType type = static_cast<ElementType>(code);
+  return _node.getBinary().size() % elementBytes(type) == 0;
+}
+
+ElementType typedArrayType(const nlohmann::json& _value) {
+  if (!isTypedArray(_value)) {
+    fprintf(stderr, "Settings error: value isn't a typed array\n");
+    exit(-1);
+  }
+  return static_cast<ElementType>(_value.get_binary().subtype() ^
+                                  TYPED_ARRAY_SUBTYPE);
+}
+
+ElementType typedArrayType(const ImageNode& _node) {
+  if (!isTypedArray(_node)) {
+    fprintf(stderr, "Settings error: value isn't a typed array\n");
+    exit(-1);
+  }
+  return static_cast<ElementType>(_node.getSubtype() ^ TYPED_ARRAY_SUBTYPE);
+}
+
+bool toTypedArray(const nlohmann::json& _array, nlohmann::json* _typed) {
+  if (!_array.is_array() || _array.empty()) {
+    return false;
+  }
+
+  // Determines the element type.
+  u64 floats = 0;
+  u64 unsigneds = 0;
+  bool fits = true;
+  for (const nlohmann::json& elem : _array) {
+    if (elem.is_number_float()) {
+      floats++;
+    } else if (elem.is_number_unsigned()) {
+      unsigneds++;
+      fits = fits && elem.get<u64>() <=
+                         static_cast<u64>(std::numeric_limits<s64>::max());
+    } else if (!elem.is_number_integer()) {
+      return false;
+    }
+  }
+
+  if (floats == _array.size()) {
+    std::vector<f64> values(_array.size());
+    for (u64 idx = 0; idx < values.size(); idx++) {
+      values[idx] = _array[idx].get<f64>();
+    }
+    *_typed = makeTypedArray(values.data(), values.size());
+  } else if (unsigneds == _array.size()) {
+    std::vector<u64> values(_array.size());
+    for (u64 idx = 0; idx < values.size(); idx++) {
+      values[idx] = _array[idx].get<u64>();
+    }
+    *_typed = makeTypedArray(values.data(), values.size());
+  } else if (floats == 0 && fits) {
+    std::vector<s64> values(_array.size());
+    for (u64 idx = 0; idx < values.size(); idx++) {
+      values[idx] = _array[idx].get<s64>();
+    }
+    *_typed = makeTypedArray(values.data(), values.size());
+  } else {
+    return false;
+  }
+  return true;
+}
+
+nlohmann::json fromTypedArray(const nlohmann::json& _typed) {
+  nlohmann::json array = nlohmann::json::array();
+  switch (typedArrayType(_typed)) {
+    case ElementType::U8:
+      for (u8 value : typedArray<u8>(_typed)) {
+        array.push_back(value);
+      }
+      break;
+    case ElementType::S8:
+      for (s8 value : typedArray<s8>(_typed)) {
+        array.push_back(value);
+      }
+      break;
+    case ElementType::U16:
+      for (u16 value : typedArray<u16>(_typed)) {
+        array.push_back(value);
+      }
+      break;
+    case ElementType::S16:
+      for (s16 value : typedArray<s16>(_typed)) {
+        array.push_back(value);
+      }
+      break;
+    case ElementType::U32:
+      for (u32 value : typedArray<u32>(_typed)) {
+        array.push_back(value);
+      }
+      break;
+    case ElementType::S32:
+      for (s32 value : typedArray<s32>(_typed)) {
+        array.push_back(value);
+      }
+      break;
+    case ElementType::U64:
+      for (u64 value : typedArray<u64>(_typed)) {
+        array.push_back(value);
+      }
+      break;
+    case ElementType::S64:
+      for (s64 value : typedArray<s64>(_typed)) {
+        array.push_back(value);
+      }
+      break;
+    case ElementType::F32:
+      for (f32 value : typedArray<f32>(_typed)) {
+        array.push_back(value);
+      }
+      break;
+    case ElementType::F64:
+      for (f64 value : typedArray<f64>(_typed)) {
+        array.push_back(value);
+      }
+      break;
+  }
+  return array;
+}
+
+void readSidecar(const std::string& _file, nlohmann::json* _typed) {
+  s32 fd = open(_file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw Error("couldn't read file " + _file);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw Error("couldn't read file " + _file);
+  }
+  u64 size = st.st_size;
+
+  // Checks the header.
+  u64 header[4];
+  if (size < HEADER_BYTES ||
+      !readBytes(fd, reinterpret_cast<u8*>(header), sizeof(header))) {
+    close(fd);
+    throw Error("invalid sidecar file " + _file);
+  }
+  if (!littleEndian()) {
+    swapBytes(reinterpret_cast<u8*>(header), sizeof(header), 8);
+  }
+  bool valid = header[0] == MAGIC && validType(header[1]);
+  u64 element_bytes =
+      valid ? elementBytes(static_cast<ElementType>(header[1])) : 0;
+  valid = valid && header[2] <= (size - HEADER_BYTES) / element_bytes &&
+          HEADER_BYTES + header[2] * element_bytes == size;
+  if (!valid) {
+    close(fd);
+    throw Error("invalid sidecar file " + _file);
+  }
+
+  // Reads the elements directly into the settings.
+  nlohmann::json::binary_t::container_type bytes(size - HEADER_BYTES);
+  bool read = readBytes(fd, bytes.data(), bytes.size());
+  close(fd);
+  if (!read) {
+    throw Error("couldn't read file " + _file);
+  }
+  if (!littleEndian()) {
+    swapBytes(bytes.data(), bytes.size(), element_bytes);
+  }
+  *_typed = nlohmann::json::binary(std::move(bytes),
+                                   TYPED_ARRAY_SUBTYPE | header[1]);
+}
+
+void writeSidecar(const std::string& _file, const nlohmann::json& _typed) {
+  if (!isTypedArray(_typed)) {
+    throw Error("value for sidecar file " + _file + " isn't a typed array");
+  }
+  ElementType type = typedArrayType(_typed);
+  const nlohmann::json::binary_t& bin = _typed.get_binary();
+  u64 header[4] = {MAGIC, static_cast<u64>(type),
+                   bin.size() / elementBytes(type), 0};
+  std::string text(HEADER_BYTES + bin.size(), '\0');
+  memcpy(&text[0], header, sizeof(header));
+  memcpy(&text[HEADER_BYTES], bin.data(), bin.size());
+  if (!littleEndian()) {
+    swapBytes(reinterpret_cast<u8*>(&text[0]), HEADER_BYTES, 8);
+    swapBytes(reinterpret_cast<u8*>(&text[HEADER_BYTES]), bin.size(),
+              elementBytes(type));
+  }
+  if (fio::OutFile::writeFile(_file, text) != fio::OutFile::Status::OK) {
+    throw Error("couldn't write to file " + _file);
+  }
+}
+
+bool hasTypedArrays(const nlohmann::json& _settings) {
+  if (isTypedArray(_settings)) {
+    return true;
+  }
+  if (_settings.is_structured()) {
+    for (const nlohmann::json& child : _settings) {
+      if (hasTypedArrays(child)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void spillSidecars(nlohmann::json* _settings, const std::string& _config_file,
+                   u64 _threshold) {
+  u64 count = 0;
+  spill(_settings, _config_file, _threshold, &count);
+}
+
+const void* typedArrayData(const nlohmann::json& _value, ElementType _type,
+                           u64* _size) {
+  if (!isTypedArray(_value) || typedArrayType(_value) != _type) {
+    fprintf(stderr, "Settings error: value isn't a typed array of %s\n",
+            elementName(_type));
+    exit(-1);
+  }
+  const nlohmann::json::binary_t& bin = _value.get_binary();
+  *_size = bin.size() / elementBytes(_type);
+  return bin.data();
+}
+
+const void* typedArrayData(const ImageNode& _node, ElementType _type,
+                           u64* _size) {
+  if (!isTypedArray(_node) || typedArrayType(_node) != _type) {
+    fprintf(stderr, "Settings error: value isn't a typed array of %s\n",
+            elementName(_type));
+    exit(-1);
+  }
+  std::string_view bin = _node.getBinary();
+  *_size = bin.size() / elementBytes(_type);
+  return bin.data();
+}
+
+/*** static functions below here ***/
+
+static bool validType(u64 _code) {
+  return _code >= static_cast<u64>(ElementType::U8) &&
+         _code <= static_cast<u64>(ElementType::F64);
+}
+
+static bool littleEndian() {
+  const u16 one = 1;
+  u8 first;
+  memcpy(&first, &one, 1);
+  return first == 1;
+}
+
+static void swapBytes(u8* _data, u64 _bytes, u64 _element_bytes) {
+  for (u64 offset = 0; offset + _element_bytes <= _bytes;
+       offset += _element_bytes) {
+    std::reverse(_data + offset, _data + offset + _element_bytes);
+  }
+}
+
+static bool readBytes(s32 _fd, u8* _data, u64 _bytes) {
+  while (_bytes > 0) {
+    ssize_t count = read(_fd, _data, _bytes);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return false;
+    }
+    _data += count;
+    _bytes -= count;
+  }
+  return true;
+}
+
+static void spill(nlohmann::json* _node, const std::string& _config_file,
+                  u64 _threshold, u64* _count) {
+  nlohmann::json typed;
+  bool convert = !isTypedArray(*_node) && _threshold > 0 &&
+                 _node->is_array() && _node->size() >= _threshold &&
+                 toTypedArray(*_node, &typed);
+  if (isTypedArray(*_node) || convert) {
+    // Sidecars are included relative to the settings file.
+    std::string file = _config_file + '.' + std::to_string((*_count)++) +
+                       ".arr";
+    writeSidecar(file, convert ? typed : *_node);
+    size_t slash = file.find_last_of('/');
+    *_node = "$#(" +
+             (slash == std::string::npos ? file : file.substr(slash + 1)) +
+             ")#$";
+  } else if (_node->is_structured()) {
+    for (nlohmann::json& child : *_node) {
+      spill(&child, _config_file, _threshold, _count);
+    }
+  }
+}
+
+}  // namespace settings
@@ -0,0 +1,161 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SETTINGS_SIDECAR_H_
+#define SETTINGS_SIDECAR_H_
+
+#include <string>
+
+#include "nlohmann/json.hpp"
+#include "prim/prim.h"
+#include "settings/image.h"
+
+namespace settings {
+
+// Large numeric arrays can be stored in binary sidecar files and included with
+// "$#(file)#$". A sidecar file holds a header (magic "SETARR01", element type,
+// element count, reserved) followed by the packed elements, all little endian.
+// Included sidecars become typed arrays: binary settings values whose subtype
+// holds the element type.
+//
+// Settings values own their bytes, so loading a sidecar copies its elements
+// once into the settings. Views of a typed array in a settings image (see
+// settings/image.h) don't copy, so mapping or sharing an image gives
+// zero-copy access to its typed arrays.
+
+// This is the element type of a typed array.
+enum class ElementType : u8 {
+  U8 = 1,
+  S8 = 2,
+  U16 = 3,
+  S16 = 4,
+  U32 = 5,
+  S32 = 6,
+  U64 = 7,
+  S64 = 8,
+  F32 = 9,
+  F64 = 10
+};
+
+// the binary subtype of a typed array is this plus the element type
+const u8 TYPED_ARRAY_SUBTYPE = 0xe0;
+
+// this returns the element type of a C++ type
+template <typename T>
+ElementType elementType();
+
+// this returns the bytes of one element
+u64 elementBytes(ElementType _type);
+
+// this returns the element type name (e.g., "f64")
+const char* elementName(ElementType _type);
+
+// This is a read-only view of the elements of a typed array. It doesn't own
+// the elements or copy them.
+template <typename T>
+class ArrayView {
+ public:
+  ArrayView(const T* _data, u64 _size);
+
+  const T* data() const;
+  u64 size() const;
+  bool empty() const;
+  const T& operator[](u64 _index) const;
+  const T* begin() const;
+  const T* end() const;
+
+ private:
+  const T* data_;
+  u64 size_;
+};
+
+// this returns true if the value is a typed array
+bool isTypedArray(const nlohmann::json& _value);
+bool isTypedArray(const ImageNode& _node);
+
+// this returns the element type of a typed array
+//  error print and exit(-1) if the value isn't a typed array
+ElementType typedArrayType(const nlohmann::json& _value);
+ElementType typedArrayType(const ImageNode& _node);
+
+// this returns a view of the elements of a typed array. The view is valid as
+//  long as the value (or image) isn't modified or destroyed.
+//  error print and exit(-1) if the value isn't a typed array of T
+template <typename T>
+ArrayView<T> typedArray(const nlohmann::json& _value);
+template <typename T>
+ArrayView<T> typedArray(const ImageNode& _node);
+
+// this creates a typed array
+template <typename T>
+nlohmann::json makeTypedArray(const T* _data, u64 _size);
+
+// this converts a JSON array of numbers to a typed array. Only arrays of all
+//  floats (f64), all unsigned integers (u64), or all integers that fit in s64
+//  (s64) are converted.
+//  returns false if the array isn't converted
+bool toTypedArray(const nlohmann::json& _array, nlohmann::json* _typed);
+
+// this converts a typed array to a JSON array of numbers
+//  error print and exit(-1) if the value isn't a typed array
+nlohmann::json fromTypedArray(const nlohmann::json& _typed);
+
+// this reads a sidecar file into a typed array. The elements are read once,
+//  straight into the typed array's buffer, without mapping the file.
+//  throws settings::Error upon failure
+void readSidecar(const std::string& _file, nlohmann::json* _typed);
+
+// this writes a typed array to a sidecar file
+//  throws settings::Error upon failure
+void writeSidecar(const std::string& _file, const nlohmann::json& _typed);
+
+// this returns true if the settings contain any typed array
+bool hasTypedArrays(const nlohmann::json& _settings);
+
+// this prepares settings for writing to _config_file by writing all typed
+//  arrays, and all arrays of at least _threshold numbers convertible by
+//  toTypedArray(), to sidecar files named "<_config_file>.<N>.arr" and
+//  replacing them with inclusions. A threshold of 0 spills no JSON arrays.
+//  throws settings::Error upon failure
+void spillSidecars(nlohmann::json* _settings, const std::string& _config_file,
+                   u64 _threshold);
+
+// this is used by typedArray() and returns the elements of a typed array
+//  error print and exit(-1) if the value isn't a typed array of the type
+const void* typedArrayData(const nlohmann::json& _value, ElementType _type,
+                           u64* _size);
+const void* typedArrayData(const ImageNode& _node, ElementType _type,
+                           u64* _size);
+
+}  // namespace settings
+
+#include "settings/sidecar.tcc"
+
+#endif  // SETTINGS_SIDECAR_H_
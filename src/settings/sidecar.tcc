@@ -0,0 +1,149 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SETTINGS_SIDECAR_H_
+#error "do not include this file, use the .h instead"
+#else  // SETTINGS_SIDECAR_H_
+
+#include <cassert>
+
+namespace settings {
+
+template <>
+inline ElementType elementType<u8>() {
+  return ElementType::U8;
+}
+
+template <>
+inline ElementType elementType<s8>() {
+  return ElementType::S8;
+}
+
+template <>
+inline ElementType elementType<u16>() {
+  return ElementType::U16;
+}
+
+template <>
+inline ElementType elementType<s16>() {
+  return ElementType::S16;
+}
+
+template <>
+inline ElementType elementType<u32>() {
+  return ElementType::U32;
+}
+
+template <>
+inline ElementType elementType<s32>() {
+  return ElementType::S32;
+}
+
+template <>
+inline ElementType elementType<u64>() {
+  return ElementType::U64;
+}
+
+template <>
+inline ElementType elementType<s64>() {
+  return ElementType::S64;
+}
+
+template <>
+inline ElementType elementType<f32>() {
+  return ElementType::F32;
+}
+
+template <>
+inline ElementType elementType<f64>() {
+  return ElementType::F64;
+}
+
+template <typename T>
+ArrayView<T>::ArrayView(const T* _data, u64 _size)
+    : data_(_data), size_(_size) {}
+
+template <typename T>
+const T* ArrayView<T>::data() const {
+  return data_;
+}
+
+template <typename T>
+u64 ArrayView<T>::size() const {
+  return size_;
+}
+
+template <typename T>
+bool ArrayView<T>::empty() const {
+  return size_ == 0;
+}
+
+template <typename T>
+const T& ArrayView<T>::operator[](u64 _index) const {
+  assert(_index < size_);
+  return data_[_index];
+}
+
+template <typename T>
+const T* ArrayView<T>::begin() const {
+  return data_;
+}
+
+template <typename T>
+const T* ArrayView<T>::end() const {
+  return data_ + size_;
+}
+
+template <typename T>
+ArrayView<T> typedArray(const nlohmann::json& _value) {
+  u64 size;
+  const void* data = typedArrayData(_value, elementType<T>(), &size);
+  return ArrayView<T>(reinterpret_cast<const T*>(data), size);
+}
+
+template <typename T>
+ArrayView<T> typedArray(const ImageNode& _node) {
+  u64 size;
+  const void* data = typedArrayData(_node, elementType<T>(), &size);
+  return ArrayView<T>(reinterpret_cast<const T*>(data), size);
+}
+
+template <typename T>
+nlohmann::json makeTypedArray(const T* _data, u64 _size) {
+  const u8* bytes = reinterpret_cast<const u8*>(_data);
+  return nlohmann::json::binary(
+      nlohmann::json::binary_t::container_type(bytes,
+                                               bytes + _size * sizeof(T)),
+      TYPED_ARRAY_SUBTYPE | static_cast<u8>(elementType<T>()));
+}
+
+}  // namespace settings
+
+#endif  // SETTINGS_SIDECAR_H_
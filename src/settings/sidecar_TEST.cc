@@ -0,0 +1,133 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/sidecar.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+#include "settings/image.h"
+#include "settings/settings.h"
+
+TEST(Sidecar, typedArray) {
+  std::vector<f32> values = {1.5f, -2.0f, 3.25f};
+  nlohmann::json typed = settings::makeTypedArray(values.data(), 3);
+  ASSERT_TRUE(settings::isTypedArray(typed));
+  ASSERT_EQ(settings::typedArrayType(typed), settings::ElementType::F32);
+
+  settings::ArrayView<f32> view = settings::typedArray<f32>(typed);
+  ASSERT_EQ(view.size(), 3u);
+  ASSERT_EQ(view.data(), reinterpret_cast<const f32*>(
+                             typed.get_binary().data()));
+  ASSERT_EQ(std::vector<f32>(view.begin(), view.end()), values);
+  ASSERT_EQ(settings::fromTypedArray(typed), nlohmann::json({1.5, -2, 3.25}));
+  ASSERT_DEATH(settings::typedArray<f64>(typed), "typed array of f64");
+  ASSERT_FALSE(settings::isTypedArray(nlohmann::json::binary({1, 2, 3})));
+
+  // Images hold typed arrays without copying them.
+  settings::Image image(nlohmann::json({{"t", typed}}));
+  settings::ArrayView<f32> iview =
+      settings::typedArray<f32>(image.root()["t"]);
+  ASSERT_EQ(std::vector<f32>(iview.begin(), iview.end()), values);
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(iview.data()) % 8, 0u);
+}
+
+TEST(Sidecar, toTypedArray) {
+  nlohmann::json typed;
+  ASSERT_TRUE(settings::toTypedArray(nlohmann::json({1.5, 2.0}), &typed));
+  ASSERT_EQ(settings::typedArrayType(typed), settings::ElementType::F64);
+  ASSERT_TRUE(settings::toTypedArray(nlohmann::json({1u, 2u}), &typed));
+  ASSERT_EQ(settings::typedArrayType(typed), settings::ElementType::U64);
+  ASSERT_TRUE(settings::toTypedArray(nlohmann::json({1, -2}), &typed));
+  ASSERT_EQ(settings::typedArrayType(typed), settings::ElementType::S64);
+  ASSERT_EQ(settings::typedArray<s64>(typed)[1], -2);
+
+  ASSERT_FALSE(settings::toTypedArray(nlohmann::json({1, 2.5}), &typed));
+  ASSERT_FALSE(settings::toTypedArray(nlohmann::json({1, "a"}), &typed));
+  ASSERT_FALSE(settings::toTypedArray(
+      nlohmann::json({-1, 0xffffffffffffffffull}), &typed));
+  ASSERT_FALSE(settings::toTypedArray(nlohmann::json::array(), &typed));
+}
+
+TEST(Sidecar, loadAndWrite) {
+  std::vector<u16> values(1000);
+  for (u64 idx = 0; idx < values.size(); idx++) {
+    values[idx] = idx * 7;
+  }
+  settings::writeSidecar("TEST_table.arr",
+                         settings::makeTypedArray(values.data(), 1000));
+
+  const char* filename = "TEST_settings.json";
+  FILE* fp = fopen(filename, "w");
+  assert(fp != NULL);
+  fprintf(fp, "%s", "{\"t\": \"$#(TEST_table.arr)#$\", \"r\": \"$&(/t)&$\"}");
+  fclose(fp);
+
+  nlohmann::json settings;
+  settings::Origins origins;
+  settings::initFile(filename, &settings, &origins);
+  ASSERT_EQ(origins.at("/t"), "./TEST_table.arr");
+  settings::ArrayView<u16> view = settings::typedArray<u16>(settings["r"]);
+  ASSERT_EQ(std::vector<u16>(view.begin(), view.end()), values);
+
+  // Typed arrays and large numeric arrays are spilled to sidecars.
+  settings["big"] = nlohmann::json::array();
+  settings["small"] = {1.0, 2.0};
+  for (u64 idx = 0; idx < 100; idx++) {
+    settings["big"].push_back(idx * 0.5);
+  }
+  settings::writeToFile(settings, "TEST_out.json", 0, 1, 10);
+  nlohmann::json written;
+  settings::initString("{\"w\": \"$$(TEST_out.json)$$\"}", &written);
+  ASSERT_EQ(written["w"]["t"], settings["t"]);
+  ASSERT_EQ(written["w"]["r"], settings["r"]);
+  ASSERT_EQ(settings::fromTypedArray(written["w"]["big"]), settings["big"]);
+  ASSERT_EQ(written["w"]["small"], settings["small"]);
+
+  ASSERT_EQ(settings::typedArrayType(written["w"]["big"]),
+            settings::ElementType::F64);
+
+  // Invalid sidecars are errors.
+  fp = fopen("TEST_table.arr", "w");
+  assert(fp != NULL);
+  fprintf(fp, "%s", "SETARR01 this isn't a sidecar");
+  fclose(fp);
+  ASSERT_THROW(settings::load(filename, {}, &settings), settings::Error);
+
+  assert(remove(filename) == 0);
+  assert(remove("TEST_table.arr") == 0);
+  assert(remove("TEST_out.json") == 0);
+  for (u32 idx = 0; idx < 3; idx++) {
+    std::string sidecar = "TEST_out.json." + std::to_string(idx) + ".arr";
+    assert(remove(sidecar.c_str()) == 0);
+  }
+}
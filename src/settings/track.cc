@@ -0,0 +1,652 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/track.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <istream>
+#include <iterator>
+#include <map>
+#include <queue>
+#include <utility>
+
+#include "fio/InFile.h"
+#include "settings/compress.h"
+#include "settings/sidecar.h"
+
+namespace settings {
+
+namespace {
+
+struct Result {
+  bool read;  // the node or a descendant was read
+  u64 bytes;
+  u64 nodes;
+};
+
+struct HotEntry {
+  u64 reads;
+  u64 id;
+  Usage::Path path;
+
+  bool operator>(const HotEntry& _other) const {
+    return reads > _other.reads ||
+           (reads == _other.reads && id < _other.id);
+  }
+};
+
+struct UnusedEntry {
+  u64 bytes;
+  u64 id;
+  Usage::Path path;
+
+  bool operator>(const UnusedEntry& _other) const {
+    return bytes > _other.bytes ||
+           (bytes == _other.bytes && id < _other.id);
+  }
+};
+
+template <typename T>
+using TopQueue = std::priority_queue<T, std::vector<T>, std::greater<T>>;
+
+// This finds the line of a JSON pointer within JSON text without parsing the
+// values that aren't on the path.
+class LineScanner {
+ public:
+  explicit LineScanner(const std::string& _text)
+      : text_(_text), pos_(0), line_(1) {}
+
+  // Returns the line of the value at the tokens, or of its deepest ancestor in
+  // the text. Returns 0 if the text isn't valid JSON.
+  u64 find(const std::vector<std::string>& _tokens) {
+    skipSpace();
+    u64 line = line_;
+    for (const std::string& token : _tokens) {
+      if (peek() == '{') {
+        pos_++;
+        bool found = false;
+        skipSpace();
+        while (peek() != '}') {
+          std::string key;
+          if (!readString(&key)) {
+            return 0;
+          }
+          skipSpace();
+          if (peek() != ':') {
+            return 0;
+          }
+          pos_++;
+          skipSpace();
+          if (key == token) {
+            found = true;
+            break;
+          }
+          if (!skipValue()) {
+            return 0;
+          }
+          skipSpace();
+          if (peek() != ',') {
+            break;
+          }
+          pos_++;
+          skipSpace();
+        }
+        if (!found) {
+          return line;
+        }
+      } else if (peek() == '[') {
+        pos_++;
+        char* end;
+        u64 index = strtoull(token.c_str(), &end, 10);
+        if (token.empty() || *end != '\0') {
+          return line;
+        }
+        skipSpace();
+        for (u64 idx = 0; idx < index; idx++) {
+          if (peek() == ']' || !skipValue()) {
+            return line;
+          }
+          skipSpace();
+          if (peek() != ',') {
+            return line;
+          }
+          pos_++;
+          skipSpace();
+        }
+        if (peek() == ']') {
+          return line;
+        }
+      } else {
+        return line;
+      }
+      line = line_;
+    }
+    return line;
+  }
+
+ private:
+  char peek() const {
+    return pos_ < text_.size() ? text_[pos_] : '\0';
+  }
+
+  void skipSpace() {
+    while (pos_ < text_.size()) {
+      char c = text_[pos_];
+      if (c == '\n') {
+        line_++;
+      } else if (c != ' ' && c != '\t' && c != '\r') {
+        return;
+      }
+      pos_++;
+    }
+  }
+
+  // Reads a string, decoding the simple escapes. Other escapes are kept as is
+  // and won't match a key.
+  bool readString(std::string* _str) {
+    if (peek() != '"') {
+      return false;
+    }
+    pos_++;
+    while (pos_ < text_.size()) {
+      char c = text_[pos_++];
+      if (c == '"') {
+        return true;
+      } else if (c == '\\') {
+        if (pos_ == text_.size()) {
+          return false;
+        }
+        char e = text_[pos_++];
+        switch (e) {
+          case '"':
+          case '\\':
+          case '/':
+            _str->push_back(e);
+            break;
+          case 'b':
+            _str->push_back('\b');
+            break;
+          case 'f':
+            _str->push_back('\f');
+            break;
+          case 'n':
+            _str->push_back('\n');
+            break;
+          case 'r':
+            _str->push_back('\r');
+            break;
+          case 't':
+            _str->push_back('\t');
+            break;
+          default:
+            _str->push_back('\\');
+            _str->push_back(e);
+            break;
+        }
+      } else {
+        _str->push_back(c);
+      }
+    }
+    return false;
+  }
+
+  bool skipValue() {
+    char c = peek();
+    if (c == '"') {
+      std::string str;
+      return readString(&str);
+    } else if (c == '{' || c == '[') {
+      u64 depth = 0;
+      while (pos_ < text_.size()) {
+        c = text_[pos_];
+        if (c == '"') {
+          std::string str;
+          if (!readString(&str)) {
+            return false;
+          }
+          continue;
+        } else if (c == '{' || c == '[') {
+          depth++;
+        } else if (c == '}' || c == ']') {
+          depth--;
+        } else if (c == '\n') {
+          line_++;
+        }
+        pos_++;
+        if (depth == 0) {
+          return true;
+        }
+      }
+      return false;
+    } else {
+      size_t start = pos_;
+      while (pos_ < text_.size() &&
+             std::string(",}] \t\r\n").find(text_[pos_]) == std::string::npos) {
+        pos_++;
+      }
+      return pos_ > start;
+    }
+  }
+
+  const std::string& text_;
+  size_t pos_;
+  u64 line_;
+};
+
+// This holds the state of a usage traversal.
+class Reporter {
+ public:
+  Reporter(const std::atomic<u64>* _reads, u32 _top, Usage* _usage)
+      : reads_(_reads), top_(_top), usage_(_usage), id_(0) {}
+
+  Result visit(const nlohmann::json& _node, std::string* _path,
+               bool _ancestor_read) {
+    u64 id = id_++;
+    u64 reads = reads_[id].load(std::memory_order_relaxed);
+    bool used = _ancestor_read || reads > 0;
+    Result res = {reads > 0, heapBytes(_node, false), 1};
+
+    // Visits the children, remembering the unread ones.
+    struct Unread {
+      nlohmann::json::const_iterator it;
+      u64 index;
+      u64 id;
+      Result res;
+    };
+    std::vector<Unread> unread;
+    if (_node.is_object() || _node.is_array()) {
+      u64 idx = 0;
+      for (auto it = _node.cbegin(); it != _node.cend(); ++it, idx++) {
+        u64 size = _path->size();
+        appendToken(_node.is_object() ? it.key() : std::to_string(idx),
+                    _path);
+        u64 child_id = id_;
+        Result child = visit(*it, _path, used);
+        res.read |= child.read;
+        res.bytes += child.bytes;
+        res.nodes += child.nodes;
+        if (!used && !child.read) {
+          unread.push_back({it, idx, child_id, child});
+        }
+        _path->resize(size);
+      }
+    }
+
+    // Unread children of partially read nodes are the largest unused
+    // subtrees, as is the root if nothing was read.
+    if (res.read) {
+      for (const Unread& child : unread) {
+        if (!wouldReport(child.id, child.res)) {
+          continue;
+        }
+        u64 size = _path->size();
+        appendToken(
+            _node.is_object() ? child.it.key() : std::to_string(child.index),
+            _path);
+        pushUnused(child.id, *_path, child.res);
+        _path->resize(size);
+      }
+    } else if (id == 0 && wouldReport(id, res)) {
+      pushUnused(id, *_path, res);
+    }
+
+    usage_->nodes++;
+    usage_->reads += reads;
+    if (reads > 0) {
+      usage_->read_nodes++;
+      if (hot_.size() < top_ ||
+          (top_ > 0 && HotEntry({reads, id, Usage::Path()}) > hot_.top())) {
+        hot_.push({reads, id, {*_path, "", 0, reads, res.bytes, res.nodes}});
+        if (hot_.size() > top_) {
+          hot_.pop();
+        }
+      }
+    }
+    if (used || res.read) {
+      usage_->used_nodes++;
+    }
+    return res;
+  }
+
+  void finish() {
+    while (!hot_.empty()) {
+      usage_->hot.push_back(hot_.top().path);
+      hot_.pop();
+    }
+    std::reverse(usage_->hot.begin(), usage_->hot.end());
+    while (!unused_.empty()) {
+      usage_->unused.push_back(unused_.top().path);
+      unused_.pop();
+    }
+    std::reverse(usage_->unused.begin(), usage_->unused.end());
+  }
+
+ private:
+  static void appendToken(const std::string& _token, std::string* _path) {
+    _path->push_back('/');
+    for (char c : _token) {
+      if (c == '~') {
+        _path->append("~0");
+      } else if (c == '/') {
+        _path->append("~1");
+      } else {
+        _path->push_back(c);
+      }
+    }
+  }
+
+  // Paths are only built for subtrees that would be reported.
+  bool wouldReport(u64 _id, const Result& _res) const {
+    if (unused_.size() < top_) {
+      return true;
+    }
+    return top_ > 0 &&
+           UnusedEntry({_res.bytes, _id, Usage::Path()}) > unused_.top();
+  }
+
+  void pushUnused(u64 _id, const std::string& _path, const Result& _res) {
+    unused_.push({_res.bytes, _id, {_path, "", 0, 0, _res.bytes, _res.nodes}});
+    if (unused_.size() > top_) {
+      unused_.pop();
+    }
+  }
+
+  const std::atomic<u64>* reads_;
+  u32 top_;
+  Usage* usage_;
+  u64 id_;
+  TopQueue<HotEntry> hot_;
+  TopQueue<UnusedEntry> unused_;
+};
+
+}  // namespace
+
+// Assigns preorder ids to all nodes.
+static void assignIds(const nlohmann::json& _node,
+                      std::unordered_map<const nlohmann::json*, u64>* _ids);
+
+// Returns the node at the pointer or nullptr if it doesn't exist.
+static const nlohmann::json* find(const nlohmann::json& _settings,
+                                  const std::string& _pointer);
+
+// Splits a JSON pointer into its unescaped reference tokens.
+static std::vector<std::string> pointerTokens(const std::string& _pointer);
+
+// Reads a (possibly compressed) file. Returns false upon failure.
+static bool readText(const std::string& _file, std::string* _text);
+
+/*** public functions below here ***/
+
+std::string Usage::report() const {
+  std::string out;
+  char buf[512];
+  snprintf(buf, sizeof(buf),
+           "total: %" PRIu64 " nodes, %" PRIu64 " read, %" PRIu64
+           " used, %" PRIu64 " reads\n",
+           nodes, read_nodes, used_nodes, reads);
+  out += buf;
+
+  auto location = [](const Path& _path) {
+    std::string loc = _path.source.empty() ? "(unknown)" : _path.source;
+    if (_path.line > 0) {
+      loc += ':' + std::to_string(_path.line);
+    }
+    return loc;
+  };
+
+  out += "\nhot paths:\n";
+  for (const Path& path : hot) {
+    snprintf(buf, sizeof(buf), "  %16" PRIu64 " reads  ", path.reads);
+    out += buf + (path.path.empty() ? "(root)" : path.path) + "  " +
+           location(path) + '\n';
+  }
+
+  out += "\nunused subtrees:\n";
+  for (const Path& path : unused) {
+    snprintf(buf, sizeof(buf), "  %16" PRIu64 " bytes %14" PRIu64 " nodes  ",
+             path.bytes, path.nodes);
+    out += buf + (path.path.empty() ? "(root)" : path.path) + "  " +
+           location(path) + '\n';
+  }
+  return out;
+}
+
+Tracker::Tracker(const nlohmann::json& _settings, const Origins* _origins,
+                 const std::string& _config_file)
+    : settings_(_settings), config_file_(_config_file) {
+  if (_origins != nullptr) {
+    origins_ = *_origins;
+  }
+  assignIds(settings_, &ids_);
+  reads_.reset(new std::atomic<u64>[ids_.size()]);
+  reset();
+}
+
+Tracker::~Tracker() {}
+
+TrackedNode Tracker::root() const {
+  return TrackedNode(this, &settings_);
+}
+
+u64 Tracker::reads(const std::string& _pointer) const {
+  const nlohmann::json* node = find(settings_, _pointer);
+  if (node == nullptr) {
+    fprintf(stderr, "Settings error: pointer \"%s\" doesn't exist\n",
+            _pointer.c_str());
+    exit(-1);
+  }
+  return reads_[ids_.at(node)].load(std::memory_order_relaxed);
+}
+
+void Tracker::reset() {
+  for (u64 id = 0; id < ids_.size(); id++) {
+    reads_[id].store(0, std::memory_order_relaxed);
+  }
+}
+
+void Tracker::usage(u32 _top, Usage* _usage) const {
+  *_usage = Usage();
+  Reporter reporter(reads_.get(), _top, _usage);
+  std::string path;
+  reporter.visit(settings_, &path, false);
+  reporter.finish();
+
+  // Finds the nearest origin of each reported path and its line in the origin
+  // file. Files are read once.
+  std::map<std::string, std::string> texts;
+  auto locate = [&](Usage::Path* _path) {
+    std::string base = _path->path;
+    auto origin = origins_.find(base);
+    while (origin == origins_.end() && !base.empty()) {
+      base.resize(base.find_last_of('/'));
+      origin = origins_.find(base);
+    }
+    _path->source = origin != origins_.end() ? origin->second : config_file_;
+
+    // References and sidecars don't have lines.
+    const nlohmann::json* node = find(settings_, base);
+    if (_path->source.empty() || _path->source.compare(0, 3, "$&(") == 0 ||
+        node == nullptr || isTypedArray(*node)) {
+      return;
+    }
+    std::string file = _path->source.substr(0, _path->source.find('?'));
+    auto text = texts.find(file);
+    if (text == texts.end()) {
+      text = texts.insert({file, ""}).first;
+      if (!readText(file, &text->second)) {
+        text->second.clear();
+      }
+    }
+    if (!text->second.empty()) {
+      LineScanner scanner(text->second);
+      _path->line =
+          scanner.find(pointerTokens(_path->path.substr(base.size())));
+    }
+  };
+  for (Usage::Path& hot : _usage->hot) {
+    locate(&hot);
+  }
+  for (Usage::Path& unused : _usage->unused) {
+    locate(&unused);
+  }
+}
+
+void Tracker::count(const nlohmann::json* _node) const {
+  reads_[ids_.at(_node)].fetch_add(1, std::memory_order_relaxed);
+}
+
+nlohmann::json::value_t TrackedNode::type() const {
+  return node_->type();
+}
+
+bool TrackedNode::isNull() const {
+  return node_->is_null();
+}
+
+bool TrackedNode::isBool() const {
+  return node_->is_boolean();
+}
+
+bool TrackedNode::isNumber() const {
+  return node_->is_number();
+}
+
+bool TrackedNode::isString() const {
+  return node_->is_string();
+}
+
+bool TrackedNode::isArray() const {
+  return node_->is_array();
+}
+
+bool TrackedNode::isObject() const {
+  return node_->is_object();
+}
+
+u64 TrackedNode::size() const {
+  tracker_->count(node_);
+  return node_->size();
+}
+
+bool TrackedNode::contains(const std::string& _key) const {
+  tracker_->count(node_);
+  return node_->is_object() && node_->find(_key) != node_->end();
+}
+
+TrackedNode TrackedNode::operator[](const std::string& _key) const {
+  if (node_->is_object()) {
+    auto it = node_->find(_key);
+    if (it != node_->end()) {
+      return TrackedNode(tracker_, &*it);
+    }
+  }
+  fprintf(stderr, "Settings error: key \"%s\" doesn't exist\n", _key.c_str());
+  exit(-1);
+}
+
+TrackedNode TrackedNode::operator[](u64 _index) const {
+  if (!node_->is_array() || _index >= node_->size()) {
+    fprintf(stderr, "Settings error: index %" PRIu64 " doesn't exist\n",
+            _index);
+    exit(-1);
+  }
+  return TrackedNode(tracker_, &(*node_)[_index]);
+}
+
+TrackedNode TrackedNode::at(const std::string& _pointer) const {
+  const nlohmann::json* node = find(*node_, _pointer);
+  if (node == nullptr) {
+    fprintf(stderr, "Settings error: pointer \"%s\" doesn't exist\n",
+            _pointer.c_str());
+    exit(-1);
+  }
+  return TrackedNode(tracker_, node);
+}
+
+const nlohmann::json& TrackedNode::json() const {
+  tracker_->count(node_);
+  return *node_;
+}
+
+TrackedNode::TrackedNode(const Tracker* _tracker, const nlohmann::json* _node)
+    : tracker_(_tracker), node_(_node) {}
+
+/*** static functions below here ***/
+
+static void assignIds(const nlohmann::json& _node,
+                      std::unordered_map<const nlohmann::json*, u64>* _ids) {
+  u64 id = _ids->size();
+  (*_ids)[&_node] = id;
+  if (_node.is_object() || _node.is_array()) {
+    for (auto it = _node.cbegin(); it != _node.cend(); ++it) {
+      assignIds(*it, _ids);
+    }
+  }
+}
+
+static const nlohmann::json* find(const nlohmann::json& _settings,
+                                  const std::string& _pointer) {
+  try {
+    return &_settings.at(nlohmann::json::json_pointer(_pointer));
+  } catch (nlohmann::json::exception& e) {
+    return nullptr;
+  }
+}
+
+static std::vector<std::string> pointerTokens(const std::string& _pointer) {
+  nlohmann::json::json_pointer ptr(_pointer);
+  std::vector<std::string> tokens;
+  for (; !ptr.empty(); ptr.pop_back()) {
+    tokens.push_back(ptr.back());
+  }
+  return std::vector<std::string>(tokens.rbegin(), tokens.rend());
+}
+
+static bool readText(const std::string& _file, std::string* _text) {
+  try {
+    Compression compression = fileCompression(_file);
+    if (compression == Compression::NONE) {
+      return fio::InFile::readFile(_file, _text) == fio::InFile::Status::OK;
+    }
+    std::unique_ptr<std::istream> stream =
+        openDecompressed(_file, compression);
+    _text->assign(std::istreambuf_iterator<char>(*stream),
+                  std::istreambuf_iterator<char>());
+    return true;
+  } catch (Error& e) {
+    return false;
+  }
+}
+
+}  // namespace settings
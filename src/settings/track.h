@@ -0,0 +1,162 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SETTINGS_TRACK_H_
+#define SETTINGS_TRACK_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "prim/prim.h"
+#include "settings/settings.h"
+
+namespace settings {
+
+class TrackedNode;
+
+// This is a report of which settings were read through a Tracker.
+struct Usage {
+  struct Path {
+    std::string path;    // JSON pointer (RFC 6901)
+    std::string source;  // include file or reference, "" if unknown
+    u64 line;            // line within the source file, 0 if unknown
+    u64 reads;           // reads of the node itself
+    u64 bytes;           // estimated heap bytes including descendants
+    u64 nodes;           // including itself
+  };
+
+  u64 nodes;
+  u64 read_nodes;  // nodes read at least once
+  u64 used_nodes;  // nodes read, or with a read ancestor or descendant
+  u64 reads;
+
+  std::vector<Path> hot;     // descending by reads (caching candidates)
+  std::vector<Path> unused;  // descending by bytes (pruning candidates)
+
+  // this returns a human readable report
+  std::string report() const;
+};
+
+// This counts the reads of resolved settings per JSON node. Settings are
+// navigated through TrackedNode cursors and each value access is a read of the
+// accessed node. Navigation itself isn't a read. Reads are counted with
+// relaxed atomic increments, so trackers may be shared by reading threads.
+class Tracker {
+ public:
+  // this tracks the settings, which must not be modified and must outlive this
+  //  object. The origins and the top-level settings file are optional and are
+  //  only used to report sources and lines (see settings::load()).
+  explicit Tracker(const nlohmann::json& _settings,
+                   const Origins* _origins = nullptr,
+                   const std::string& _config_file = "");
+  ~Tracker();
+  Tracker(const Tracker&) = delete;
+  Tracker& operator=(const Tracker&) = delete;
+
+  // this returns the root of the settings
+  TrackedNode root() const;
+
+  // this returns the reads of the node at the pointer
+  //  error print and exit(-1) if the pointer doesn't exist
+  u64 reads(const std::string& _pointer) const;
+
+  // this clears all read counts
+  void reset();
+
+  // this reports the _top most read nodes and the _top largest subtrees that
+  //  weren't used. A subtree is unused if no node in it or above it was read.
+  //  Sources and lines are read from the files of the origins.
+  void usage(u32 _top, Usage* _usage) const;
+
+ private:
+  friend class TrackedNode;
+  void count(const nlohmann::json* _node) const;
+
+  const nlohmann::json& settings_;
+  Origins origins_;
+  std::string config_file_;
+  std::unordered_map<const nlohmann::json*, u64> ids_;  // preorder
+  std::unique_ptr<std::atomic<u64>[]> reads_;
+};
+
+// This is a read-only cursor into tracked settings. It is cheap to copy and is
+// valid as long as the Tracker is.
+class TrackedNode {
+ public:
+  // these don't read the node
+  nlohmann::json::value_t type() const;
+  bool isNull() const;
+  bool isBool() const;
+  bool isNumber() const;
+  bool isString() const;
+  bool isArray() const;
+  bool isObject() const;
+
+  // these read the node
+  u64 size() const;
+  bool contains(const std::string& _key) const;
+
+  // object access. Accessing a missing key error prints and exit(-1).
+  TrackedNode operator[](const std::string& _key) const;
+
+  // array access
+  //  error print and exit(-1) if the index is out of range
+  TrackedNode operator[](u64 _index) const;
+
+  // this accesses a descendant by JSON pointer (RFC 6901)
+  //  error print and exit(-1) if the pointer doesn't exist
+  TrackedNode at(const std::string& _pointer) const;
+
+  // value access reads the node (see nlohmann::json::get())
+  template <typename T>
+  T get() const {
+    tracker_->count(node_);
+    return node_->get<T>();
+  }
+
+  // this reads the node and returns its settings (e.g., to pass a subtree to
+  //  untracked code). Its descendants are considered used.
+  const nlohmann::json& json() const;
+
+ private:
+  friend class Tracker;
+  TrackedNode(const Tracker* _tracker, const nlohmann::json* _node);
+
+  const Tracker* tracker_;
+  const nlohmann::json* node_;
+};
+
+}  // namespace settings
+
+#endif  // SETTINGS_TRACK_H_
@@ -0,0 +1,173 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "settings/track.h"
+
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+#include "settings/settings.h"
+
+TEST(Track, reads) {
+  nlohmann::json settings;
+  settings::initString(
+      "{\"a\": {\"b\": [1, 2, 3], \"c\": \"x\"}, \"d\": true,"
+      " \"e\": {\"f\": 1.5}}",
+      &settings);
+  settings::Tracker tracker(settings);
+
+  settings::TrackedNode root = tracker.root();
+  ASSERT_TRUE(root.isObject());
+  ASSERT_EQ(root["a"]["b"][1].get<u64>(), 2u);
+  ASSERT_EQ(root.at("/a/b/1").get<s64>(), 2);
+  ASSERT_EQ(root["a"]["c"].get<std::string>(), "x");
+  ASSERT_TRUE(root["a"].contains("b"));
+  ASSERT_FALSE(root["a"].contains("z"));
+  ASSERT_EQ(root["e"].json(), nlohmann::json::parse("{\"f\": 1.5}"));
+
+  // Navigation isn't a read.
+  ASSERT_EQ(tracker.reads(""), 0u);
+  ASSERT_EQ(tracker.reads("/a"), 2u);
+  ASSERT_EQ(tracker.reads("/a/b"), 0u);
+  ASSERT_EQ(tracker.reads("/a/b/1"), 2u);
+  ASSERT_EQ(tracker.reads("/a/c"), 1u);
+  ASSERT_EQ(tracker.reads("/d"), 0u);
+  ASSERT_EQ(tracker.reads("/e/f"), 0u);
+
+  tracker.reset();
+  ASSERT_EQ(tracker.reads("/a/b/1"), 0u);
+
+  // Concurrent reads are all counted.
+  std::vector<std::thread> threads;
+  for (u32 t = 0; t < 4; t++) {
+    threads.emplace_back([&]() {
+      for (u32 r = 0; r < 1000; r++) {
+        root["d"].get<bool>();
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(tracker.reads("/d"), 4000u);
+}
+
+TEST(Track, usage) {
+  const char* afilename = "TEST_asettings.json";
+  FILE* afp = fopen(afilename, "w");
+  assert(afp != NULL);
+  fprintf(afp, "%s",
+          "{\n"
+          "  \"network\": \"$$(TEST_bsettings.json)$$\",\n"
+          "  \"seed\": 12,\n"
+          "  \"unused\": {\n"
+          "    \"list\": [1, 2, 3, 4, 5, 6, 7, 8, 9, 10]\n"
+          "  }\n"
+          "}\n");
+  fclose(afp);
+
+  const char* bfilename = "TEST_bsettings.json";
+  FILE* bfp = fopen(bfilename, "w");
+  assert(bfp != NULL);
+  fprintf(bfp, "%s",
+          "{\"name\": \"a network name that isn't stored inline\",\n"
+          " \"routers\": [\n"
+          "   {\"radix\": 16},\n"
+          "   {\"radix\": 32}\n"
+          " ]\n"
+          "}\n");
+  fclose(bfp);
+
+  nlohmann::json settings;
+  settings::Origins origins;
+  settings::load(afilename, {}, &settings, &origins);
+  settings::Tracker tracker(settings, &origins, afilename);
+
+  settings::TrackedNode root = tracker.root();
+  for (u32 r = 0; r < 10; r++) {
+    root["network"]["routers"][1]["radix"].get<u32>();
+  }
+  root["seed"].get<u32>();
+
+  settings::Usage usage;
+  tracker.usage(10, &usage);
+  ASSERT_EQ(usage.nodes, 21u);
+  ASSERT_EQ(usage.read_nodes, 2u);
+  ASSERT_EQ(usage.reads, 11u);
+  ASSERT_EQ(usage.used_nodes, 6u);
+
+  ASSERT_EQ(usage.hot.size(), 2u);
+  ASSERT_EQ(usage.hot.at(0).path, "/network/routers/1/radix");
+  ASSERT_EQ(usage.hot.at(0).reads, 10u);
+  ASSERT_EQ(usage.hot.at(0).source, "./TEST_bsettings.json");
+  ASSERT_EQ(usage.hot.at(0).line, 4u);
+  ASSERT_EQ(usage.hot.at(1).path, "/seed");
+  ASSERT_EQ(usage.hot.at(1).source, afilename);
+  ASSERT_EQ(usage.hot.at(1).line, 3u);
+
+  // Unused subtrees are maximal and descending by bytes.
+  ASSERT_EQ(usage.unused.size(), 3u);
+  ASSERT_EQ(usage.unused.at(0).path, "/unused");
+  ASSERT_EQ(usage.unused.at(0).nodes, 12u);
+  ASSERT_EQ(usage.unused.at(0).line, 4u);
+  ASSERT_GE(usage.unused.at(1).bytes, usage.unused.at(2).bytes);
+  for (u32 idx = 1; idx < 3; idx++) {
+    const settings::Usage::Path& path = usage.unused.at(idx);
+    if (path.path == "/network/name") {
+      ASSERT_EQ(path.line, 1u);
+    } else {
+      ASSERT_EQ(path.path, "/network/routers/0");
+      ASSERT_EQ(path.line, 3u);
+    }
+    ASSERT_EQ(path.source, "./TEST_bsettings.json");
+  }
+
+  tracker.usage(1, &usage);
+  ASSERT_EQ(usage.hot.size(), 1u);
+  ASSERT_EQ(usage.unused.size(), 1u);
+  ASSERT_EQ(usage.unused.at(0).path, "/unused");
+  ASSERT_FALSE(usage.report().empty());
+
+  // Nothing read leaves the whole settings unused.
+  tracker.reset();
+  tracker.usage(10, &usage);
+  ASSERT_EQ(usage.used_nodes, 0u);
+  ASSERT_EQ(usage.unused.size(), 1u);
+  ASSERT_EQ(usage.unused.at(0).path, "");
+  ASSERT_EQ(usage.unused.at(0).line, 1u);
+
+  assert(remove(afilename) == 0);
+  assert(remove(bfilename) == 0);
+}
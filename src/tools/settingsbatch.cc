@@ -0,0 +1,91 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "prim/prim.h"
+#include "settings/batch.h"
+
+// This loads every entry of a JSON Lines manifest concurrently and prints the
+// status of each entry as JSON Lines.
+s32 main(s32 _argc, char** _argv) {
+  u32 threads = 0;
+  std::string manifest;
+  for (s32 arg = 1; arg < _argc; arg++) {
+    if (strncmp(_argv[arg], "--threads=", 10) == 0) {
+      threads = std::stoul(_argv[arg] + 10);
+    } else if (_argv[arg][0] == '-' || !manifest.empty()) {
+      printf(
+          "usage:\n"
+          "  %s [--threads=N] <manifest>\n"
+          "\n"
+          "  manifest  : JSON Lines file, one object per line:\n"
+          "              {\"config\": <file>,\n"
+          "               \"overrides\": [<override>, ...],  (optional)\n"
+          "               \"output\": <file>}                (optional)\n"
+          "              overrides are the same as for settings files\n",
+          _argv[0]);
+      return strcmp(_argv[arg], "-h") == 0 ? 0 : -1;
+    } else {
+      manifest = _argv[arg];
+    }
+  }
+  if (manifest.empty()) {
+    fprintf(stderr, "Settings error: please specify a manifest\n");
+    return -1;
+  }
+
+  std::vector<settings::BatchEntry> entries;
+  settings::readManifest(manifest, &entries);
+  std::vector<settings::BatchResult> results;
+  settings::loadBatch(entries, threads, false, &results);
+
+  u64 failures = 0;
+  for (u64 idx = 0; idx < entries.size(); idx++) {
+    nlohmann::json status;
+    status["index"] = idx;
+    status["config"] = entries[idx].config;
+    status["ok"] = results[idx].ok;
+    if (!results[idx].ok) {
+      status["error"] = results[idx].error;
+      failures++;
+    }
+    if (!entries[idx].output.empty()) {
+      status["output"] = entries[idx].output;
+    }
+    status["seconds"] = results[idx].seconds;
+    printf("%s\n", status.dump().c_str());
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "fio/OutFile.h"
+#include "nlohmann/json.hpp"
+#include "prim/prim.h"
+#include "settings/embed.h"
+#include "settings/settings.h"
+
+// This loads settings like settings::commandLine() then generates C++ code
+// that embeds them (see settings::embed()). Use "--symbol=NAME" to set the
+// accessor function, and "--source=FILE" and "--header=FILE" to set the
+// generated files.
+s32 main(s32 _argc, char** _argv) {
+  std::string symbol;
+  std::string source_file;
+  std::string header_file;
+  for (s32 arg = 1; arg < _argc && _argv[arg][0] == '-'; arg++) {
+    if (strncmp(_argv[arg], "--symbol=", 9) == 0) {
+      symbol = _argv[arg] + 9;
+    } else if (strncmp(_argv[arg], "--source=", 9) == 0) {
+      source_file = _argv[arg] + 9;
+    } else if (strncmp(_argv[arg], "--header=", 9) == 0) {
+      header_file = _argv[arg] + 9;
+    }
+  }
+  if (symbol.empty() || source_file.empty() || header_file.empty()) {
+    fprintf(stderr,
+            "Settings error: --symbol, --source, and --header are required\n");
+    return -1;
+  }
+
+  nlohmann::json settings;
+  settings::commandLine(_argc, _argv, &settings);
+
+  std::string source;
+  std::string header;
+  settings::embed(settings, symbol, &source, &header);
+  if (fio::OutFile::writeFile(source_file, source) !=
+          fio::OutFile::Status::OK ||
+      fio::OutFile::writeFile(header_file, header) !=
+          fio::OutFile::Status::OK) {
+    fprintf(stderr, "Settings error: couldn't write generated files\n");
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <sys/stat.h>
+
+#include <chrono>  // NOLINT
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "nlohmann/json.hpp"
+#include "prim/prim.h"
+#include "settings/settings.h"
+
+// This times settings::writeToFile() and settings::initFile() for text JSON
+// and each binary format using synthetic settings, and reports file sizes.
+s32 main(s32 _argc, char** _argv) {
+  u32 entries = 100000;
+  u32 repeats = 3;
+  std::string file = "settingsformatbench";
+  for (s32 arg = 1; arg < _argc; arg++) {
+    if (strncmp(_argv[arg], "--entries=", 10) == 0) {
+      entries = std::stoul(_argv[arg] + 10);
+    } else if (strncmp(_argv[arg], "--repeats=", 10) == 0) {
+      repeats = std::stoul(_argv[arg] + 10);
+    } else if (strncmp(_argv[arg], "--file=", 7) == 0) {
+      file = _argv[arg] + 7;
+    } else {
+      printf(
+          "usage:\n"
+          "  %s [--entries=N] [--repeats=N] [--file=PREFIX]\n"
+          "\n"
+          "  entries : number of synthetic entries (default 100000)\n"
+          "  repeats : runs per format, the fastest is reported\n"
+          "  file    : prefix of the written files (removed afterward)\n",
+          _argv[0]);
+      return strcmp(_argv[arg], "-h") == 0 ? 0 : -1;
+    }
+  }
+
+  // Builds entries like those of a simulator configuration.
+  nlohmann::json settings;
+  for (u32 idx = 0; idx < entries; idx++) {
+    nlohmann::json& entry = settings["entries"][idx];
+    entry["name"] = "entry_" + std::to_string(idx);
+    entry["enabled"] = (idx % 3) != 0;
+    entry["latency"] = idx % 1000;
+    entry["rate"] = 1.0 / (idx + 1);
+    entry["ports"] = {idx % 64, (idx + 1) % 64, (idx + 2) % 64};
+  }
+
+  printf("%-12s %12s %8s %12s %12s\n", "format", "bytes", "ratio",
+         "write (s)", "load (s)");
+  u64 text_bytes = 0;
+  for (const char* ext : {".json", ".cbor", ".msgpack", ".bson"}) {
+    std::string path = file + ext;
+    f64 write_best = 0.0;
+    f64 load_best = 0.0;
+    for (u32 run = 0; run < repeats; run++) {
+      auto start = std::chrono::steady_clock::now();
+      settings::writeToFile(settings, path);
+      std::chrono::duration<f64> elapsed =
+          std::chrono::steady_clock::now() - start;
+      if (run == 0 || elapsed.count() < write_best) {
+        write_best = elapsed.count();
+      }
+
+      nlohmann::json loaded;
+      start = std::chrono::steady_clock::now();
+      settings::initFile(path, &loaded);
+      elapsed = std::chrono::steady_clock::now() - start;
+      if (run == 0 || elapsed.count() < load_best) {
+        load_best = elapsed.count();
+      }
+      if (loaded != settings) {
+        fprintf(stderr, "loaded %s differs\n", path.c_str());
+        return -1;
+      }
+    }
+
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+      fprintf(stderr, "couldn't stat %s\n", path.c_str());
+      return -1;
+    }
+    u64 bytes = st.st_size;
+    if (text_bytes == 0) {
+      text_bytes = bytes;
+    }
+    printf("%-12s %12" PRIu64 " %8.3f %12.4f %12.4f\n", ext + 1, bytes,
+           static_cast<f64>(bytes) / text_bytes, write_best, load_best);
+    remove(path.c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>  // NOLINT
+
+#include "nlohmann/json.hpp"
+#include "prim/prim.h"
+#include "settings/settings.h"
+
+// This times settings::toString() over thread counts using synthetic settings.
+// One thread prints through std::ostringstream.
+s32 main(s32 _argc, char** _argv) {
+  u32 entries = 500000;
+  u32 max_threads = std::max(1u, std::thread::hardware_concurrency());
+  u32 repeats = 3;
+  for (s32 arg = 1; arg < _argc; arg++) {
+    if (strncmp(_argv[arg], "--entries=", 10) == 0) {
+      entries = std::stoul(_argv[arg] + 10);
+    } else if (strncmp(_argv[arg], "--threads=", 10) == 0) {
+      max_threads = std::stoul(_argv[arg] + 10);
+    } else if (strncmp(_argv[arg], "--repeats=", 10) == 0) {
+      repeats = std::stoul(_argv[arg] + 10);
+    } else {
+      printf(
+          "usage:\n"
+          "  %s [--entries=N] [--threads=N] [--repeats=N]\n"
+          "\n"
+          "  entries : number of synthetic entries (default 500000)\n"
+          "  threads : maximum thread count (default hardware threads)\n"
+          "  repeats : runs per thread count, the fastest is reported\n",
+          _argv[0]);
+      return strcmp(_argv[arg], "-h") == 0 ? 0 : -1;
+    }
+  }
+
+  // Builds unevenly sized groups of entries.
+  nlohmann::json settings;
+  for (u32 idx = 0; idx < entries; idx++) {
+    nlohmann::json& entry =
+        settings["groups"]["group" + std::to_string(idx % 7 == 0 ? 0 : idx % 5)]
+                [idx];
+    entry["name"] = "entry_" + std::to_string(idx);
+    entry["latency"] = idx % 1000;
+    entry["rate"] = 1.0 / (idx + 1);
+    entry["ports"] = {idx % 64, (idx + 1) % 64, (idx + 2) % 64};
+  }
+
+  printf("%8s %12s %12s %8s\n", "threads", "bytes", "seconds", "speedup");
+  std::string serial;
+  f64 base = 0.0;
+  for (u32 threads = 1; threads <= max_threads;
+       threads = threads < max_threads ? std::min(threads * 2, max_threads)
+                                       : threads + 1) {
+    f64 best = 0.0;
+    for (u32 run = 0; run < repeats; run++) {
+      auto start = std::chrono::steady_clock::now();
+      std::string text = settings::toString(settings, threads);
+      std::chrono::duration<f64> elapsed =
+          std::chrono::steady_clock::now() - start;
+      if (run == 0 || elapsed.count() < best) {
+        best = elapsed.count();
+      }
+      if (threads == 1) {
+        serial = std::move(text);
+      } else if (text != serial) {
+        fprintf(stderr, "parallel text differs with %u threads\n", threads);
+        return -1;
+      }
+    }
+    if (threads == 1) {
+      base = best;
+    }
+    printf("%8u %12zu %12.4f %8.2f\n", threads, serial.size(), best,
+           base / best);
+  }
+  return 0;
+}
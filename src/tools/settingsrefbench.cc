@@ -0,0 +1,119 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>  // NOLINT
+
+#include "nlohmann/json.hpp"
+#include "prim/prim.h"
+#include "settings/settings.h"
+
+// This times settings::resolveReferences() over thread counts using synthetic
+// settings with many large references, half of which depend on the others.
+s32 main(s32 _argc, char** _argv) {
+  u32 refs = 20000;
+  u32 size = 1000;
+  u32 max_threads = std::max(1u, std::thread::hardware_concurrency());
+  u32 repeats = 3;
+  for (s32 arg = 1; arg < _argc; arg++) {
+    if (strncmp(_argv[arg], "--refs=", 7) == 0) {
+      refs = std::stoul(_argv[arg] + 7);
+    } else if (strncmp(_argv[arg], "--size=", 7) == 0) {
+      size = std::stoul(_argv[arg] + 7);
+    } else if (strncmp(_argv[arg], "--threads=", 10) == 0) {
+      max_threads = std::stoul(_argv[arg] + 10);
+    } else if (strncmp(_argv[arg], "--repeats=", 10) == 0) {
+      repeats = std::stoul(_argv[arg] + 10);
+    } else {
+      printf(
+          "usage:\n"
+          "  %s [--refs=N] [--size=N] [--threads=N] [--repeats=N]\n"
+          "\n"
+          "  refs    : number of references (default 20000)\n"
+          "  size    : elements of each referenced table (default 1000)\n"
+          "  threads : maximum thread count (default hardware threads)\n"
+          "  repeats : runs per thread count, the fastest is reported\n",
+          _argv[0]);
+      return strcmp(_argv[arg], "-h") == 0 ? 0 : -1;
+    }
+  }
+
+  // Builds 64 tables, references to the tables, and references to those.
+  nlohmann::json settings;
+  for (u32 table = 0; table < 64; table++) {
+    nlohmann::json& elements = settings["tables"][table];
+    for (u32 idx = 0; idx < size; idx++) {
+      elements.push_back(table * size + idx);
+    }
+  }
+  for (u32 ref = 0; ref < refs; ref++) {
+    if (ref < refs / 2) {
+      settings["direct"][ref] =
+          "$&(/tables/" + std::to_string(ref % 64) + ")&$";
+    } else {
+      settings["chained"][ref - refs / 2] =
+          "$&(/direct/" + std::to_string(ref % (refs / 2)) + ")&$";
+    }
+  }
+
+  printf("%8s %12s %8s\n", "threads", "seconds", "speedup");
+  nlohmann::json serial;
+  f64 base = 0.0;
+  for (u32 threads = 1; threads <= max_threads;
+       threads = threads < max_threads ? std::min(threads * 2, max_threads)
+                                       : threads + 1) {
+    f64 best = 0.0;
+    for (u32 run = 0; run < repeats; run++) {
+      nlohmann::json resolved = settings;
+      auto start = std::chrono::steady_clock::now();
+      settings::resolveReferences(&resolved, nullptr, threads);
+      std::chrono::duration<f64> elapsed =
+          std::chrono::steady_clock::now() - start;
+      if (run == 0 || elapsed.count() < best) {
+        best = elapsed.count();
+      }
+      if (threads == 1) {
+        serial = std::move(resolved);
+      } else if (resolved != serial) {
+        fprintf(stderr, "parallel result differs with %u threads\n", threads);
+        return -1;
+      }
+    }
+    if (threads == 1) {
+      base = best;
+    }
+    printf("%8u %12.4f %8.2f\n", threads, best, base / best);
+  }
+  return 0;
+}